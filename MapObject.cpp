@@ -1,14 +1,29 @@
 #include "MapObject.h"
 
+#include <QDateTime>
+
 MapObject::MapObject(double lat, double lon, int rad_km, std::string obj_name, std::string save_dir)
     : latitude_center(lat), longitude_center(lon), radius_km(rad_km), name(std::move(obj_name)), save_directory(std::move(save_dir)) {}
 
 QString MapObject::getDisplayText() const
 {
-    return QString("Имя: %1, Центр: (%2, %3), Радиус: %4 км, Путь: %5")
-        .arg(QString::fromStdString(name))
-        .arg(latitude_center)
-        .arg(longitude_center)
-        .arg(radius_km)
-        .arg(QString::fromStdString(save_directory));
+    QString text = QString("Имя: %1, Центр: (%2, %3), Радиус: %4 км, Путь: %5")
+                       .arg(QString::fromStdString(name))
+                       .arg(latitude_center)
+                       .arg(longitude_center)
+                       .arg(radius_km)
+                       .arg(QString::fromStdString(save_directory));
+    if (burst_capture)
+        text += ", залп";
+    if (archive_captures)
+        text += ", архив";
+    if (lazy_composite)
+        text += ", композит по запросу";
+    if (last_capture_ms > 0)
+    {
+        text += ", снят " + QDateTime::fromMSecsSinceEpoch(last_capture_ms).toString("dd.MM.yyyy hh:mm");
+        if (last_missing_tiles > 0)
+            text += QString(" (без %1 плиток)").arg(last_missing_tiles);
+    }
+    return text;
 }
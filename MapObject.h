@@ -1,6 +1,7 @@
 #ifndef MAPOBJECT_H
 #define MAPOBJECT_H
 
+#include <cstdint>
 #include <string>
 #include <QString> // Для getDisplayText
 
@@ -13,6 +14,27 @@ public:
     std::string name;           // Уникальное имя объекта для файлов и логов
     std::string save_directory; // Каталог для сохранения снимков этого объекта
 
+    // Собственное расписание объекта; 0 и пустые строки — взять общие настройки
+    int capture_interval_sec = 0;
+    std::string start_time; // hh:mm
+    std::string end_time;   // hh:mm
+
+    // Приоритет при нехватке времени: объекты с отрицательным приоритетом откладываются первыми
+    int priority = 0;
+
+    // Залповый захват: вся сетка запрашивается одновременно для минимального разброса во времени
+    bool burst_capture = false;
+
+    // Архив: композиты дописываются в дневные сегменты <save_directory>/archive/<имя> вместо отдельных файлов
+    bool archive_captures = false;
+
+    // Отложенный композит: плитки сохраняются пакетом, композит собирается только по запросу
+    bool lazy_composite = false;
+
+    // Состояние последнего захвата (сохраняется в проекте, projectstore.h)
+    int64_t last_capture_ms = 0;       // Unix-время, мс; 0 — захвата еще не было
+    uint32_t last_missing_tiles = 0;   // Сколько плиток не удалось получить
+
     MapObject(double lat, double lon, int rad_km, std::string obj_name, std::string save_dir);
 
     QString getDisplayText() const;
@@ -73,12 +73,17 @@ QMAKE_LFLAGS += -static-libstdc++
 SOURCES += \
     main.cpp \
     mainwindow.cpp \
-    MapObject.cpp \
     snapshotapp.cpp \
-    capturethread.cpp   
+    objectimport.cpp \
+    mapobjectmodel.cpp \
+    projectstore.cpp \
+    objectprogressdelegate.cpp
 HEADERS += \
     mainwindow.h \
-    MapObject.h \
     snapshotapp.h \
-    capturethread.h
+    objectimport.h \
+    mapobjectmodel.h \
+    projectstore.h \
+    objectprogressdelegate.h
+include(screencapture.pri)
 FORMS += mainwindow.ui    
@@ -0,0 +1,390 @@
+#include "asynclog.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    const size_t kLogRingSize = 4096; // Степень двойки
+    const size_t kLogTextSize = 256;  // Длиннее — обрезается
+    const size_t kRateSlots = 256;
+    const auto kFlushPeriod = std::chrono::milliseconds(50);
+
+    struct LogRecord
+    {
+        std::atomic<size_t> sequence;
+        int64_t time_ms;
+        LogLevel level;
+        uint32_t suppressed;
+        char text[kLogTextSize];
+    };
+
+    // Ограничение повторов по адресу строки события; гонки между потоками дают
+    // лишь приблизительный счет, что для журнала допустимо
+    struct RateSlot
+    {
+        std::atomic<const char *> event{nullptr};
+        std::atomic<int64_t> window_start_ms{0};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> suppressed{0};
+    };
+
+    int64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    const char *levelName(LogLevel level)
+    {
+        switch (level)
+        {
+        case LogLevel::Debug:
+            return "DEBUG";
+        case LogLevel::Info:
+            return "INFO ";
+        case LogLevel::Warning:
+            return "WARN ";
+        case LogLevel::Error:
+            return "ERROR";
+        }
+        return "?    ";
+    }
+
+    class AsyncLogger
+    {
+    public:
+        AsyncLogger()
+            : m_records(new LogRecord[kLogRingSize]), m_rate(new RateSlot[kRateSlots])
+        {
+            for (size_t i = 0; i < kLogRingSize; ++i)
+                m_records[i].sequence.store(i, std::memory_order_relaxed);
+            m_flusher = std::thread(&AsyncLogger::flusherLoop, this);
+        }
+
+        ~AsyncLogger()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_one();
+            m_flusher.join();
+            if (m_file)
+                std::fclose(m_file);
+        }
+
+        void configure(LogLevel min_level, const std::string &file_path)
+        {
+            m_min_level.store(static_cast<int>(min_level), std::memory_order_relaxed);
+            if (file_path.empty())
+                return;
+            std::lock_guard<std::mutex> lock(m_output_mutex);
+            FILE *file = std::fopen(file_path.c_str(), "a");
+            if (!file)
+            {
+                std::fprintf(stderr, "Не удалось открыть файл журнала: %s\n", file_path.c_str());
+                return;
+            }
+            if (m_file)
+                std::fclose(m_file);
+            m_file = file;
+        }
+
+        bool enabled(LogLevel level) const
+        {
+            return static_cast<int>(level) >= m_min_level.load(std::memory_order_relaxed);
+        }
+
+        void write(LogLevel level, const char *event, const char *format, va_list args)
+        {
+            if (!enabled(level))
+                return;
+            const int64_t time_ms = nowMs();
+            uint32_t suppressed = 0;
+            if (level >= LogLevel::Warning && !admit(event, time_ms, suppressed))
+                return;
+
+            size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            LogRecord *record = nullptr;
+            for (;;)
+            {
+                LogRecord &cell = m_records[pos & (kLogRingSize - 1)];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        record = &cell;
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                else
+                {
+                    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            record->time_ms = time_ms;
+            record->level = level;
+            record->suppressed = suppressed;
+            int length = std::snprintf(record->text, kLogTextSize, "%s ", event);
+            if (length < 0)
+                length = 0;
+            if (static_cast<size_t>(length) < kLogTextSize)
+                std::vsnprintf(record->text + length, kLogTextSize - length, format, args);
+            record->sequence.store(pos + 1, std::memory_order_release);
+
+            // Ошибки выводятся сразу, остальное — по периоду фонового потока.
+            // Флаг ставится под мьютексом: иначе пробуждение может прийти между проверкой
+            // условия и ожиданием и потеряться, а без флага условие ожидания его не примет
+            if (level == LogLevel::Error)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_flush_requested = true;
+                }
+                m_cv.notify_one();
+            }
+        }
+
+        void flush()
+        {
+            const size_t target = m_enqueue_pos.load(std::memory_order_acquire);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_flush_requested = true;
+            m_cv.notify_one();
+            m_flushed_cv.wait(lock, [&]()
+                              { return m_flushed_pos >= target || m_stop; });
+        }
+
+    private:
+        bool admit(const char *event, int64_t time_ms, uint32_t &suppressed)
+        {
+            RateSlot &slot = m_rate[(reinterpret_cast<uintptr_t>(event) >> 3) % kRateSlots];
+            if (slot.event.load(std::memory_order_relaxed) != event)
+            {
+                slot.event.store(event, std::memory_order_relaxed);
+                slot.window_start_ms.store(time_ms, std::memory_order_relaxed);
+                slot.count.store(0, std::memory_order_relaxed);
+                slot.suppressed.store(0, std::memory_order_relaxed);
+            }
+            if (time_ms - slot.window_start_ms.load(std::memory_order_relaxed) >= 1000)
+            {
+                slot.window_start_ms.store(time_ms, std::memory_order_relaxed);
+                slot.count.store(0, std::memory_order_relaxed);
+            }
+            if (slot.count.fetch_add(1, std::memory_order_relaxed) >= static_cast<uint32_t>(kLogRepeatsPerSecond))
+            {
+                slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            suppressed = slot.suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        void flusherLoop()
+        {
+            std::string out;
+            std::string err;
+            for (;;)
+            {
+                bool stopping = false;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_cv.wait_for(lock, kFlushPeriod, [&]()
+                                  { return m_stop || m_flush_requested; });
+                    stopping = m_stop;
+                    m_flush_requested = false;
+                }
+
+                out.clear();
+                err.clear();
+                size_t pos = m_dequeue_pos;
+                for (;;)
+                {
+                    LogRecord &cell = m_records[pos & (kLogRingSize - 1)];
+                    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                    if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0)
+                        break;
+                    appendLine(cell.level >= LogLevel::Warning ? err : out, cell.time_ms, cell.level, cell.text, cell.suppressed);
+                    cell.sequence.store(pos + kLogRingSize, std::memory_order_release);
+                    ++pos;
+                }
+                m_dequeue_pos = pos;
+
+                const uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+                if (dropped > 0)
+                {
+                    char text[160];
+                    std::snprintf(text, sizeof(text), "log_dropped Журнал не успевает, записи пропущены count=%llu",
+                                  static_cast<unsigned long long>(dropped));
+                    appendLine(err, nowMs(), LogLevel::Warning, text, 0);
+                }
+                writeOut(out, err);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_flushed_pos = pos;
+                }
+                m_flushed_cv.notify_all();
+                if (stopping)
+                    return;
+            }
+        }
+
+        void appendLine(std::string &buffer, int64_t time_ms, LogLevel level, const char *text, uint32_t suppressed)
+        {
+            const std::time_t seconds = static_cast<std::time_t>(time_ms / 1000);
+            std::tm tm_time{};
+#ifdef _WIN32
+            localtime_s(&tm_time, &seconds);
+#else
+            localtime_r(&seconds, &tm_time);
+#endif
+            char prefix[48];
+            const size_t prefix_length = std::strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &tm_time);
+            std::snprintf(prefix + prefix_length, sizeof(prefix) - prefix_length, ".%03d %s ",
+                          static_cast<int>(time_ms % 1000), levelName(level));
+            buffer += prefix;
+            buffer += text;
+            if (suppressed > 0)
+            {
+                char field[40];
+                std::snprintf(field, sizeof(field), " suppressed=%u", suppressed);
+                buffer += field;
+            }
+            buffer += '\n';
+        }
+
+        void writeOut(const std::string &out, const std::string &err)
+        {
+            std::lock_guard<std::mutex> lock(m_output_mutex);
+            if (m_file)
+            {
+                if (!out.empty())
+                    std::fwrite(out.data(), 1, out.size(), m_file);
+                if (!err.empty())
+                    std::fwrite(err.data(), 1, err.size(), m_file);
+                if (!out.empty() || !err.empty())
+                    std::fflush(m_file);
+                return;
+            }
+            if (!out.empty())
+            {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                std::fflush(stdout);
+            }
+            if (!err.empty())
+            {
+                std::fwrite(err.data(), 1, err.size(), stderr);
+                std::fflush(stderr);
+            }
+        }
+
+        std::unique_ptr<LogRecord[]> m_records;
+        std::unique_ptr<RateSlot[]> m_rate;
+        alignas(64) std::atomic<size_t> m_enqueue_pos{0};
+        alignas(64) std::atomic<uint64_t> m_dropped{0};
+        size_t m_dequeue_pos = 0; // Только фоновый поток
+        std::atomic<int> m_min_level{static_cast<int>(LogLevel::Info)};
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::condition_variable m_flushed_cv;
+        bool m_stop = false;
+        bool m_flush_requested = false;
+        size_t m_flushed_pos = 0;
+        std::thread m_flusher;
+
+        std::mutex m_output_mutex;
+        FILE *m_file = nullptr;
+    };
+
+    AsyncLogger &logger()
+    {
+        static AsyncLogger instance;
+        return instance;
+    }
+}
+
+void configureLogging(LogLevel min_level, const std::string &file_path)
+{
+    logger().configure(min_level, file_path);
+}
+
+bool logEnabled(LogLevel level)
+{
+    return logger().enabled(level);
+}
+
+bool parseLogLevel(const std::string &text, LogLevel &out)
+{
+    if (text == "debug")
+        out = LogLevel::Debug;
+    else if (text == "info")
+        out = LogLevel::Info;
+    else if (text == "warning")
+        out = LogLevel::Warning;
+    else if (text == "error")
+        out = LogLevel::Error;
+    else
+        return false;
+    return true;
+}
+
+void logWriteV(LogLevel level, const char *event, const char *format, va_list args)
+{
+    logger().write(level, event, format, args);
+}
+
+void logDebug(const char *event, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    logWriteV(LogLevel::Debug, event, format, args);
+    va_end(args);
+}
+
+void logInfo(const char *event, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    logWriteV(LogLevel::Info, event, format, args);
+    va_end(args);
+}
+
+void logWarning(const char *event, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    logWriteV(LogLevel::Warning, event, format, args);
+    va_end(args);
+}
+
+void logError(const char *event, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    logWriteV(LogLevel::Error, event, format, args);
+    va_end(args);
+}
+
+void flushLogging()
+{
+    logger().flush();
+}
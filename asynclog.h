@@ -0,0 +1,52 @@
+#ifndef ASYNCLOG_H
+#define ASYNCLOG_H
+
+#include <cstdarg>
+#include <string>
+
+// Асинхронный журнал захвата.
+// Запись форматируется прямо в заранее выделенную ячейку кольцевого буфера
+// (vsnprintf, без выделения памяти и системных вызовов) и выводится фоновым потоком
+// пачками: одна запись в поток вывода и один fflush на пачку вместо std::endl на строку.
+//
+// Строка журнала: <время> <уровень> <событие> <текст с полями key=value>.
+// Событие — строковая константа: по ее адресу повторяющиеся предупреждения и ошибки
+// ограничиваются (не больше kLogRepeatsPerSecond в секунду), число пропущенных
+// выводится полем suppressed= в следующей выведенной записи этого события.
+// При переполнении буфера записи отбрасываются, а их число выводится отдельной строкой.
+
+enum class LogLevel
+{
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+const int kLogRepeatsPerSecond = 5;
+
+#if defined(__GNUC__)
+#define SCREEN_LOG_PRINTF(fmt_index, first_arg) __attribute__((format(printf, fmt_index, first_arg)))
+#else
+#define SCREEN_LOG_PRINTF(fmt_index, first_arg)
+#endif
+
+// Минимальный уровень и файл журнала (пустой путь — Debug/Info в stdout, Warning/Error в stderr).
+// Вызывается при запуске, до начала записи из других потоков.
+void configureLogging(LogLevel min_level, const std::string &file_path = std::string());
+
+bool logEnabled(LogLevel level);
+
+// Уровень по имени: debug, info, warning, error (конфигурация, ключи командной строки)
+bool parseLogLevel(const std::string &text, LogLevel &out);
+
+void logWriteV(LogLevel level, const char *event, const char *format, va_list args);
+void logDebug(const char *event, const char *format, ...) SCREEN_LOG_PRINTF(2, 3);
+void logInfo(const char *event, const char *format, ...) SCREEN_LOG_PRINTF(2, 3);
+void logWarning(const char *event, const char *format, ...) SCREEN_LOG_PRINTF(2, 3);
+void logError(const char *event, const char *format, ...) SCREEN_LOG_PRINTF(2, 3);
+
+// Дожидается вывода всех уже поставленных записей
+void flushLogging();
+
+#endif // ASYNCLOG_H
@@ -0,0 +1,177 @@
+#include "burstfetch.h"
+
+#include "asynclog.h"
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+    struct BurstTransfer
+    {
+        const BurstRequest *request = nullptr;
+        CURL *easy = nullptr;
+        std::string body;
+        TileTiming timing;
+    };
+
+    size_t appendToBody(char *data, size_t size, size_t nmemb, void *userdata)
+    {
+        auto *transfer = static_cast<BurstTransfer *>(userdata);
+        transfer->body.append(data, size * nmemb);
+        return size * nmemb;
+    }
+
+    bool writeBodyToFile(const std::string &path, const std::string &body)
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            logError("tile_open_failed", "Ошибка открытия файла для записи file=%s", path.c_str());
+            return false;
+        }
+        bool ok = fwrite(body.data(), 1, body.size(), file) == body.size();
+        ok = (fclose(file) == 0) && ok;
+        return ok;
+    }
+}
+
+int64_t unixTimeMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void readCurlPhaseTimes(CURL *easy, TileTiming &timing)
+{
+    // Счетчики CURL накопительные от начала запроса: этап — разность соседних отметок
+    curl_off_t name_lookup = 0;
+    curl_off_t connect = 0;
+    curl_off_t app_connect = 0;
+    curl_off_t start_transfer = 0;
+    curl_off_t total = 0;
+    curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME_T, &name_lookup);
+    curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME_T, &app_connect);
+    curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &start_transfer);
+    curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total);
+    const curl_off_t ready = std::max(connect, app_connect);
+    timing.dns_us = static_cast<int32_t>(name_lookup);
+    timing.connect_us = static_cast<int32_t>(connect > name_lookup ? connect - name_lookup : 0);
+    timing.tls_us = static_cast<int32_t>(app_connect > connect ? app_connect - connect : 0);
+    timing.first_byte_us = static_cast<int32_t>(start_transfer > ready ? start_transfer - ready : 0);
+    timing.transfer_us = static_cast<int32_t>(total > start_transfer ? total - start_transfer : 0);
+}
+
+std::vector<TileTiming> burstFetch(const std::vector<BurstRequest> &requests,
+                                   int max_concurrency,
+                                   long long per_transfer_bytes_per_sec,
+                                   const std::atomic_bool &running,
+                                   const BurstBodySink &store)
+{
+    std::vector<TileTiming> timings;
+    CURLM *multi = curl_multi_init();
+    if (!multi)
+    {
+        logError("curl_multi_init_failed", "Ошибка инициализации CURL multi");
+        return timings;
+    }
+
+    // Планирование: все дескрипторы настраиваются до отправки первого запроса
+    std::vector<std::unique_ptr<BurstTransfer>> transfers;
+    transfers.reserve(requests.size());
+    for (const BurstRequest &request : requests)
+    {
+        auto transfer = std::make_unique<BurstTransfer>();
+        transfer->request = &request;
+        transfer->timing.index = request.index;
+        transfer->easy = curl_easy_init();
+        if (!transfer->easy)
+        {
+            logError("curl_init_failed", "Ошибка инициализации CURL");
+            timings.push_back(transfer->timing);
+            continue;
+        }
+        curl_easy_setopt(transfer->easy, CURLOPT_URL, request.url.c_str());
+        curl_easy_setopt(transfer->easy, CURLOPT_WRITEFUNCTION, appendToBody);
+        curl_easy_setopt(transfer->easy, CURLOPT_WRITEDATA, transfer.get());
+        curl_easy_setopt(transfer->easy, CURLOPT_PRIVATE, transfer.get());
+        curl_easy_setopt(transfer->easy, CURLOPT_FAILONERROR, 1L);
+        if (per_transfer_bytes_per_sec > 0)
+            curl_easy_setopt(transfer->easy, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(per_transfer_bytes_per_sec));
+        transfers.push_back(std::move(transfer));
+    }
+
+    const size_t concurrency = static_cast<size_t>(std::max(1, max_concurrency));
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(concurrency));
+
+    size_t next = 0;
+    int active = 0;
+    auto release = [&]()
+    {
+        while (next < transfers.size() && static_cast<size_t>(active) < concurrency && running)
+        {
+            BurstTransfer *transfer = transfers[next++].get();
+            transfer->timing.start_unix_ms = unixTimeMs();
+            curl_multi_add_handle(multi, transfer->easy);
+            ++active;
+        }
+    };
+
+    release();
+    int still_running = 0;
+    do
+    {
+        CURLMcode mc = curl_multi_perform(multi, &still_running);
+        if (mc != CURLM_OK)
+        {
+            logError("curl_multi_failed", "Ошибка CURL multi: %s", curl_multi_strerror(mc));
+            break;
+        }
+
+        int msgs_left = 0;
+        while (CURLMsg *msg = curl_multi_info_read(multi, &msgs_left))
+        {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            BurstTransfer *transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+            transfer->timing.end_unix_ms = unixTimeMs();
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &transfer->timing.http_code);
+            const long http_code = transfer->timing.http_code;
+            readCurlPhaseTimes(msg->easy_handle, transfer->timing);
+            if (msg->data.result == CURLE_OK && http_code >= 200 && http_code < 300 && !transfer->body.empty())
+            {
+                transfer->timing.bytes = static_cast<uint32_t>(transfer->body.size());
+                transfer->timing.ok = store ? store(*transfer->request, transfer->timing, std::move(transfer->body))
+                                            : writeBodyToFile(transfer->request->file_path, transfer->body);
+            }
+            else
+            {
+                logWarning("tile_fetch_failed", "Ошибка CURL code=%d http=%ld url=%s: %s", static_cast<int>(msg->data.result), http_code,
+                           transfer->request->url.c_str(), curl_easy_strerror(msg->data.result));
+            }
+            std::string().swap(transfer->body);
+            curl_multi_remove_handle(multi, msg->easy_handle);
+            --active;
+        }
+
+        release();
+        if (!running || (still_running == 0 && active == 0 && next >= transfers.size()))
+            break;
+        curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+    } while (true);
+
+    for (auto &transfer : transfers)
+    {
+        if (transfer->timing.start_unix_ms != 0 && transfer->timing.end_unix_ms == 0)
+            curl_multi_remove_handle(multi, transfer->easy); // Прервано остановкой
+        curl_easy_cleanup(transfer->easy);
+        timings.push_back(transfer->timing);
+    }
+    curl_multi_cleanup(multi);
+    return timings;
+}
@@ -0,0 +1,57 @@
+#ifndef BURSTFETCH_H
+#define BURSTFETCH_H
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Время запроса одной плитки (мс Unix-времени) для метаданных захвата
+struct TileTiming
+{
+    int index = -1;
+    bool ok = false;
+    long http_code = 0;
+    int64_t start_unix_ms = 0;
+    int64_t end_unix_ms = 0;
+    uint32_t bytes = 0; // Размер полученного тела ответа
+
+    // Этапы запроса по данным CURL, мкс; 0 — этап не выполнялся (соединение переиспользовано)
+    int32_t dns_us = 0;
+    int32_t connect_us = 0;
+    int32_t tls_us = 0;
+    int32_t first_byte_us = 0;
+    int32_t transfer_us = 0;
+};
+
+// Запрос плитки, полностью подготовленный до начала залпа
+struct BurstRequest
+{
+    int index = -1;
+    std::string url;
+    std::string file_path;
+};
+
+// Загружает все плитки одним залпом через curl multi: все easy-дескрипторы создаются
+// заранее, затем отпускаются сразу с максимальной разрешенной параллельностью,
+// чтобы разброс времени между первой и последней плиткой был минимальным.
+// Ответы собираются в память и передаются в store по мере завершения вместе со временем
+// этапов запроса; без store они пишутся в файлы синхронно. store возвращает false,
+// если сохранить не удалось.
+using BurstBodySink = std::function<bool(const BurstRequest &request, const TileTiming &timing, std::string body)>;
+std::vector<TileTiming> burstFetch(const std::vector<BurstRequest> &requests,
+                                   int max_concurrency,
+                                   long long per_transfer_bytes_per_sec,
+                                   const std::atomic_bool &running,
+                                   const BurstBodySink &store = BurstBodySink());
+
+// Текущее Unix-время в миллисекундах
+int64_t unixTimeMs();
+
+// Заполняет этапы запроса в timing из счетчиков времени завершенного easy-дескриптора
+void readCurlPhaseTimes(CURL *easy, TileTiming &timing);
+
+#endif // BURSTFETCH_H
@@ -0,0 +1,317 @@
+#include "capturearchive.h"
+
+#include "asynclog.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QStringList>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+namespace
+{
+    // Заголовок индекса: сигнатура, версия, размер записи. Порядок байт — как у хоста.
+    const char kIndexMagic[8] = {'S', 'C', 'R', 'A', 'R', 'C', 'H', 'I'};
+    const uint32_t kIndexVersion = 1;
+
+    struct IndexHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+    };
+
+    struct IndexRecord
+    {
+        int64_t timestamp_ms;
+        int32_t tile;
+        uint32_t kind;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static_assert(sizeof(IndexHeader) == 16, "Неожиданный размер заголовка индекса");
+    static_assert(sizeof(IndexRecord) == 32, "Неожиданный размер записи индекса");
+
+    bool headerValid(const IndexHeader &header)
+    {
+        return std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+               header.version == kIndexVersion && header.record_size == sizeof(IndexRecord);
+    }
+
+    QString segmentPath(const std::string &directory, const std::string &segment, const char *extension)
+    {
+        return QString::fromStdString(directory + "/" + segment + extension);
+    }
+
+    // Отображенный в память индекс одного сегмента только для чтения
+    class MappedIndex
+    {
+    public:
+        bool open(const QString &path)
+        {
+            m_file.setFileName(path);
+            if (!m_file.open(QIODevice::ReadOnly))
+                return false;
+            const qint64 size = m_file.size();
+            if (size < static_cast<qint64>(sizeof(IndexHeader)))
+                return false;
+            // Неполная запись в хвосте (сбой во время добавления) не отображается
+            m_count = static_cast<size_t>((size - static_cast<qint64>(sizeof(IndexHeader))) / static_cast<qint64>(sizeof(IndexRecord)));
+            const qint64 mapped = static_cast<qint64>(sizeof(IndexHeader) + m_count * sizeof(IndexRecord));
+            uchar *map = m_file.map(0, mapped);
+            if (!map)
+                return false;
+            IndexHeader header;
+            std::memcpy(&header, map, sizeof(header));
+            if (!headerValid(header))
+            {
+                logError("archive_bad_index", "Неверный заголовок индекса архива file=%s", path.toStdString().c_str());
+                return false;
+            }
+            m_records = reinterpret_cast<const IndexRecord *>(map + sizeof(IndexHeader));
+            return true;
+        }
+
+        const IndexRecord *begin() const { return m_records; }
+        const IndexRecord *end() const { return m_records + m_count; }
+
+    private:
+        QFile m_file; // Отображение снимается при закрытии файла
+        const IndexRecord *m_records = nullptr;
+        size_t m_count = 0;
+    };
+
+    bool utcTimeSafe(std::time_t t, std::tm &out)
+    {
+#if defined(_WIN32)
+        return gmtime_s(&out, &t) == 0;
+#else
+        return gmtime_r(&t, &out) != nullptr;
+#endif
+    }
+}
+
+std::string safeObjectName(const std::string &object_name)
+{
+    std::string safe_object_name = object_name;
+    std::replace_if(safe_object_name.begin(), safe_object_name.end(), [](char c)
+                    { return !std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-'; }, '_');
+    return safe_object_name;
+}
+
+bool parseArchiveTime(const char *text, int64_t &out_ms)
+{
+    const QString value = QString::fromLocal8Bit(text);
+    bool ok = false;
+    qlonglong ms = value.toLongLong(&ok);
+    if (ok)
+    {
+        out_ms = ms;
+        return true;
+    }
+    QDateTime date_time = QDateTime::fromString(value, Qt::ISODate);
+    if (!date_time.isValid())
+        return false;
+    out_ms = date_time.toMSecsSinceEpoch();
+    return true;
+}
+
+std::string CaptureArchive::directoryFor(const std::string &save_directory, const std::string &object_name)
+{
+    return save_directory + "/archive/" + safeObjectName(object_name);
+}
+
+CaptureArchive::CaptureArchive(std::string directory) : m_directory(std::move(directory))
+{
+    // Последнее записанное время — из последней записи самого позднего сегмента
+    QDir dir(QString::fromStdString(m_directory));
+    QStringList indexes = dir.entryList(QStringList() << "*.idx", QDir::Files, QDir::Name);
+    if (!indexes.isEmpty())
+    {
+        MappedIndex index;
+        if (index.open(dir.filePath(indexes.last())) && index.begin() != index.end())
+            m_last_timestamp_ms = (index.end() - 1)->timestamp_ms;
+    }
+}
+
+CaptureArchive::~CaptureArchive()
+{
+    closeSegment();
+}
+
+std::string CaptureArchive::segmentNameFor(int64_t timestamp_ms)
+{
+    std::time_t seconds = static_cast<std::time_t>(timestamp_ms >= 0 ? timestamp_ms / 1000 : (timestamp_ms - 999) / 1000);
+    std::tm day_tm{};
+    if (!utcTimeSafe(seconds, day_tm))
+        return timestamp_ms < 0 ? "00000000" : "99999999"; // Вне диапазона календаря — границы для поиска
+    char buffer[16];
+    std::strftime(buffer, sizeof(buffer), "%Y%m%d", &day_tm);
+    return buffer;
+}
+
+bool CaptureArchive::openSegment(const std::string &segment)
+{
+    closeSegment();
+    if (!QDir().mkpath(QString::fromStdString(m_directory)))
+    {
+        logError("archive_mkdir_failed", "Ошибка создания каталога архива dir=%s", m_directory.c_str());
+        return false;
+    }
+
+    m_index.setFileName(segmentPath(m_directory, segment, ".idx"));
+    if (!m_index.open(QIODevice::ReadWrite))
+    {
+        logError("archive_index_open_failed", "Ошибка открытия индекса архива file=%s: %s", m_index.fileName().toStdString().c_str(), m_index.errorString().toStdString().c_str());
+        return false;
+    }
+    const qint64 index_size = m_index.size();
+    if (index_size < static_cast<qint64>(sizeof(IndexHeader)))
+    {
+        IndexHeader header;
+        std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+        header.version = kIndexVersion;
+        header.record_size = sizeof(IndexRecord);
+        if (!m_index.resize(0) || m_index.write(reinterpret_cast<const char *>(&header), sizeof(header)) != static_cast<qint64>(sizeof(header)))
+        {
+            logError("archive_index_write_failed", "Ошибка записи заголовка индекса архива file=%s", m_index.fileName().toStdString().c_str());
+            m_index.close();
+            return false;
+        }
+    }
+    else
+    {
+        IndexHeader header;
+        if (m_index.read(reinterpret_cast<char *>(&header), sizeof(header)) != static_cast<qint64>(sizeof(header)) || !headerValid(header))
+        {
+            logError("archive_bad_index", "Неверный заголовок индекса архива file=%s", m_index.fileName().toStdString().c_str());
+            m_index.close();
+            return false;
+        }
+        const qint64 tail = (index_size - static_cast<qint64>(sizeof(IndexHeader))) % static_cast<qint64>(sizeof(IndexRecord));
+        if (tail != 0)
+        {
+            logWarning("archive_index_truncated", "Индекс архива: отброшена неполная запись file=%s bytes=%lld", m_index.fileName().toStdString().c_str(), static_cast<long long>(tail));
+            m_index.resize(index_size - tail);
+        }
+        m_index.seek(m_index.size());
+    }
+
+    m_data.setFileName(segmentPath(m_directory, segment, ".seg"));
+    if (!m_data.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        logError("archive_segment_open_failed", "Ошибка открытия сегмента архива file=%s: %s", m_data.fileName().toStdString().c_str(), m_data.errorString().toStdString().c_str());
+        m_index.close();
+        return false;
+    }
+    m_segment = segment;
+    return true;
+}
+
+void CaptureArchive::closeSegment()
+{
+    if (m_data.isOpen())
+        m_data.close();
+    if (m_index.isOpen())
+        m_index.close();
+    m_segment.clear();
+}
+
+bool CaptureArchive::append(int64_t timestamp_ms, ArchiveEntryKind kind, int tile, const char *data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (timestamp_ms < m_last_timestamp_ms)
+    {
+        // Индекс должен оставаться упорядоченным для двоичного поиска (например, после перевода часов)
+        timestamp_ms = m_last_timestamp_ms;
+    }
+    const std::string segment = segmentNameFor(timestamp_ms);
+    if (segment != m_segment && !openSegment(segment))
+        return false;
+
+    // Сначала данные, затем запись индекса: запись индекса делает данные видимыми
+    const qint64 offset = m_data.size();
+    if (m_data.write(data, static_cast<qint64>(size)) != static_cast<qint64>(size) || !m_data.flush())
+    {
+        logError("archive_segment_write_failed", "Ошибка записи в сегмент архива file=%s", m_data.fileName().toStdString().c_str());
+        m_data.resize(offset);
+        return false;
+    }
+
+    IndexRecord record;
+    record.timestamp_ms = timestamp_ms;
+    record.tile = tile;
+    record.kind = static_cast<uint32_t>(kind);
+    record.offset = static_cast<uint64_t>(offset);
+    record.size = static_cast<uint64_t>(size);
+    if (m_index.write(reinterpret_cast<const char *>(&record), sizeof(record)) != static_cast<qint64>(sizeof(record)) || !m_index.flush())
+    {
+        logError("archive_index_write_failed", "Ошибка записи индекса архива file=%s", m_index.fileName().toStdString().c_str());
+        closeSegment(); // При следующем открытии неполная запись будет отброшена
+        return false;
+    }
+    m_last_timestamp_ms = timestamp_ms;
+    return true;
+}
+
+std::vector<ArchiveEntry> CaptureArchive::find(int64_t from_ms, int64_t to_ms) const
+{
+    std::vector<ArchiveEntry> entries;
+    if (to_ms < from_ms)
+        return entries;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Имена сегментов сравниваются как числа: для далеких дат год длиннее четырех цифр,
+    // и строковое сравнение отбросило бы все настоящие сегменты
+    const qlonglong first = QString::fromStdString(segmentNameFor(from_ms)).toLongLong();
+    const qlonglong last = QString::fromStdString(segmentNameFor(to_ms)).toLongLong();
+    QDir dir(QString::fromStdString(m_directory));
+    const QStringList indexes = dir.entryList(QStringList() << "*.idx", QDir::Files, QDir::Name);
+    for (const QString &file_name : indexes)
+    {
+        const QString segment = file_name.left(file_name.size() - 4);
+        bool ok = false;
+        const qlonglong day = segment.toLongLong(&ok);
+        if (!ok || day < first || day > last)
+            continue;
+
+        MappedIndex index;
+        if (!index.open(dir.filePath(file_name)))
+            continue;
+        const IndexRecord *it = std::lower_bound(index.begin(), index.end(), from_ms,
+                                                 [](const IndexRecord &record, int64_t value)
+                                                 { return record.timestamp_ms < value; });
+        for (; it != index.end() && it->timestamp_ms <= to_ms; ++it)
+        {
+            ArchiveEntry entry;
+            entry.timestamp_ms = it->timestamp_ms;
+            entry.kind = static_cast<ArchiveEntryKind>(it->kind);
+            entry.tile = it->tile;
+            entry.segment = segment.toStdString();
+            entry.offset = it->offset;
+            entry.size = it->size;
+            entries.push_back(std::move(entry));
+        }
+    }
+    return entries;
+}
+
+bool CaptureArchive::read(const ArchiveEntry &entry, QByteArray &out) const
+{
+    QFile file(segmentPath(m_directory, entry.segment, ".seg"));
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(static_cast<qint64>(entry.offset)))
+    {
+        logError("archive_segment_open_failed", "Ошибка открытия сегмента архива file=%s", file.fileName().toStdString().c_str());
+        return false;
+    }
+    out = file.read(static_cast<qint64>(entry.size));
+    if (static_cast<uint64_t>(out.size()) != entry.size)
+    {
+        logError("archive_entry_truncated", "Запись архива обрезана file=%s offset=%llu", file.fileName().toStdString().c_str(), static_cast<unsigned long long>(entry.offset));
+        return false;
+    }
+    return true;
+}
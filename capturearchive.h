@@ -0,0 +1,85 @@
+#ifndef CAPTUREARCHIVE_H
+#define CAPTUREARCHIVE_H
+
+#include <QByteArray>
+#include <QFile>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Имя объекта, пригодное для имен файлов и каталогов
+std::string safeObjectName(const std::string &object_name);
+
+// Время из командной строки утилит архива: Unix-время в мс или локальная дата ISO (2024-05-01T12:00:00)
+bool parseArchiveTime(const char *text, int64_t &out_ms);
+
+// Что хранится в записи архива
+enum class ArchiveEntryKind : uint32_t
+{
+    Composite = 0, // Композит целиком (BMP)
+    Tile = 1,      // Отдельная плитка (PNG), tile — индекс ячейки; зарезервировано, захват плитки не архивирует
+    Metadata = 2   // Метаданные захвата (JSON)
+};
+
+// Найденная запись архива
+struct ArchiveEntry
+{
+    int64_t timestamp_ms = 0; // Unix-время захвата, мс
+    ArchiveEntryKind kind = ArchiveEntryKind::Composite;
+    int tile = -1;            // Индекс плитки, -1 — не плитка
+    std::string segment;      // Имя дневного сегмента (YYYYMMDD)
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+// Архив захватов одного объекта: вместо тысяч отдельных файлов данные дописываются
+// в сегменты по суткам (UTC) — <каталог>/YYYYMMDD.seg, а рядом лежит индекс
+// YYYYMMDD.idx из записей фиксированного размера, упорядоченных по времени.
+// Добавление — O(1): дописать данные и одну запись индекса.
+// Поиск по времени — выбор сегмента по имени и двоичный поиск по отображенному в память индексу.
+// После сбоя хвост индекса с неполной записью отбрасывается; данные без записи индекса не видны.
+class CaptureArchive
+{
+public:
+    explicit CaptureArchive(std::string directory);
+    ~CaptureArchive();
+
+    CaptureArchive(const CaptureArchive &) = delete;
+    CaptureArchive &operator=(const CaptureArchive &) = delete;
+
+    const std::string &directory() const { return m_directory; }
+
+    // Дописывает запись. Время не должно убывать: более раннее время поднимается до последнего записанного.
+    bool append(int64_t timestamp_ms, ArchiveEntryKind kind, int tile, const char *data, size_t size);
+    bool append(int64_t timestamp_ms, ArchiveEntryKind kind, int tile, const QByteArray &data)
+    {
+        return append(timestamp_ms, kind, tile, data.constData(), static_cast<size_t>(data.size()));
+    }
+
+    // Записи с временем в [from_ms, to_ms] в порядке времени
+    std::vector<ArchiveEntry> find(int64_t from_ms, int64_t to_ms) const;
+
+    // Читает данные записи
+    bool read(const ArchiveEntry &entry, QByteArray &out) const;
+
+    // Имя дневного сегмента для времени
+    static std::string segmentNameFor(int64_t timestamp_ms);
+
+    // Каталог архива объекта: <save_directory>/archive/<имя>
+    static std::string directoryFor(const std::string &save_directory, const std::string &object_name);
+
+private:
+    bool openSegment(const std::string &segment);
+    void closeSegment();
+
+    std::string m_directory;
+    mutable std::mutex m_mutex;
+    std::string m_segment; // Открытый на запись сегмент
+    QFile m_data;
+    QFile m_index;
+    int64_t m_last_timestamp_ms = 0;
+};
+
+#endif // CAPTUREARCHIVE_H
@@ -0,0 +1,108 @@
+#include "captureclock.h"
+
+bool localTimeSafe(std::time_t t, std::tm &out)
+{
+#ifdef _WIN32
+    return localtime_s(&out, &t) == 0;
+#else
+    return localtime_r(&t, &out) != nullptr;
+#endif
+}
+
+namespace
+{
+    class SystemCaptureClock : public CaptureClock
+    {
+    public:
+        time_point now() const override
+        {
+            return std::chrono::steady_clock::now();
+        }
+
+        int64_t unixMs() const override
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        bool waitUntil(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+                       time_point deadline, const std::function<bool()> &pred) override
+        {
+            if (deadline == time_point::max())
+            {
+                cv.wait(lock, pred);
+                return true;
+            }
+            return cv.wait_until(lock, deadline, pred);
+        }
+    };
+}
+
+std::shared_ptr<CaptureClock> systemCaptureClock()
+{
+    static const std::shared_ptr<CaptureClock> clock = std::make_shared<SystemCaptureClock>();
+    return clock;
+}
+
+SimulatedClock::SimulatedClock(int64_t start_unix_ms)
+    : m_start_unix_ms(start_unix_ms) {}
+
+CaptureClock::time_point SimulatedClock::now() const
+{
+    return epoch() + std::chrono::nanoseconds(m_elapsed_ns.load());
+}
+
+int64_t SimulatedClock::unixMs() const
+{
+    return m_start_unix_ms + m_elapsed_ns.load() / 1000000;
+}
+
+void SimulatedClock::advanceTo(time_point t)
+{
+    const int64_t target = std::chrono::duration_cast<std::chrono::nanoseconds>(t - epoch()).count();
+    int64_t current = m_elapsed_ns.load();
+    while (current < target && !m_elapsed_ns.compare_exchange_weak(current, target))
+    {
+    }
+}
+
+void SimulatedClock::setHorizon(std::chrono::milliseconds from_start)
+{
+    m_horizon_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(from_start).count();
+}
+
+bool SimulatedClock::waitUntil(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+                               time_point deadline, const std::function<bool()> &pred)
+{
+    if (pred())
+        return true;
+
+    const int64_t horizon_ns = m_horizon_ns.load();
+    const time_point horizon = horizon_ns > 0 ? epoch() + std::chrono::nanoseconds(horizon_ns) : time_point::max();
+    if (deadline < horizon)
+    {
+        advanceTo(deadline);
+        return pred();
+    }
+
+    // Срок за горизонтом (или его нет): время дальше не идет, ждать можно только условия
+    if (horizon != time_point::max())
+        advanceTo(horizon);
+    {
+        std::lock_guard<std::mutex> horizon_lock(m_horizon_mutex);
+        m_at_horizon = true;
+    }
+    m_horizon_cv.notify_all();
+    cv.wait(lock, pred);
+    {
+        std::lock_guard<std::mutex> horizon_lock(m_horizon_mutex);
+        m_at_horizon = false;
+    }
+    return true;
+}
+
+bool SimulatedClock::waitForHorizon(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_horizon_mutex);
+    return m_horizon_cv.wait_for(lock, timeout, [this]
+                                 { return m_at_horizon; });
+}
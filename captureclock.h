@@ -0,0 +1,82 @@
+#ifndef CAPTURECLOCK_H
+#define CAPTURECLOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// std::localtime возвращает общий буфер и небезопасна при вызове из нескольких потоков
+bool localTimeSafe(std::time_t t, std::tm &out);
+
+// Источник времени для расписания захвата: монотонные часы для сроков, календарное
+// время для окна съемки и имен файлов, ожидание до срока. Через него CaptureThread
+// и CaptureScheduler получают все время, поэтому расписание можно прогнать
+// на SimulatedClock без реального ожидания.
+// Время сетевых запросов (TileTiming, FetchPool) по-прежнему меряется по настоящим часам.
+class CaptureClock
+{
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    virtual ~CaptureClock() = default;
+
+    virtual time_point now() const = 0;
+    virtual int64_t unixMs() const = 0;
+
+    std::time_t unixTime() const { return static_cast<std::time_t>(unixMs() / 1000); }
+    // Местное время текущего момента; false, если преобразование не удалось
+    bool localTime(std::tm &out) const { return localTimeSafe(unixTime(), out); }
+
+    // Ждет на cv до deadline или выполнения pred (time_point::max() — без срока).
+    // lock захвачен вызывающим и защищает состояние, от которого зависит pred.
+    // Возвращает значение pred на момент выхода.
+    virtual bool waitUntil(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+                           time_point deadline, const std::function<bool()> &pred) = 0;
+};
+
+// Настоящие часы: steady_clock, system_clock и ожидание на условной переменной
+std::shared_ptr<CaptureClock> systemCaptureClock();
+
+// Виртуальные часы: время стоит, пока кто-нибудь не ждет. Ожидание до срока не длится —
+// часы сразу переводятся на срок, так что сутки расписания проходят за доли секунды.
+// Сроки за горизонтом (setHorizon) не наступают: ожидающий блокируется до выполнения
+// своего условия (остановка потока), а waitForHorizon сообщает, что расписание дошло до конца.
+class SimulatedClock : public CaptureClock
+{
+public:
+    // start_unix_ms — календарное время начала прогона (местное время берется из него)
+    explicit SimulatedClock(int64_t start_unix_ms);
+
+    time_point now() const override;
+    int64_t unixMs() const override;
+    bool waitUntil(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+                   time_point deadline, const std::function<bool()> &pred) override;
+
+    // Переводит часы вперед; назад время не идет
+    void advanceTo(time_point t);
+    void advance(std::chrono::milliseconds delta) { advanceTo(now() + delta); }
+
+    // Горизонт прогона в мс от начала; 0 — без горизонта
+    void setHorizon(std::chrono::milliseconds from_start);
+    // Ждет (по настоящему времени не дольше timeout), пока ожидающий не упрется в горизонт
+    bool waitForHorizon(std::chrono::milliseconds timeout);
+
+private:
+    // Условная точка отсчета монотонного времени; сравнения сроков от нее не зависят
+    time_point epoch() const { return time_point() + std::chrono::hours(24); }
+
+    const int64_t m_start_unix_ms;
+    std::atomic<int64_t> m_elapsed_ns{0};
+    std::atomic<int64_t> m_horizon_ns{0};
+
+    std::mutex m_horizon_mutex;
+    std::condition_variable m_horizon_cv;
+    bool m_at_horizon = false;
+};
+
+#endif // CAPTURECLOCK_H
@@ -0,0 +1,228 @@
+#include "captureconfig.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <unordered_set>
+
+bool isValidClockTime(const std::string &text)
+{
+    int hour = -1;
+    int minute = -1;
+    char tail = 0;
+    if (std::sscanf(text.c_str(), "%d:%d%c", &hour, &minute, &tail) != 2)
+        return false;
+    return hour >= 0 && hour <= 23 && minute >= 0 && minute <= 59;
+}
+
+namespace
+{
+
+bool readTime(const QJsonObject &json, const char *key, std::string &out, const std::string &where)
+{
+    if (!json.contains(key))
+        return true;
+    const std::string value = json.value(key).toString().toStdString();
+    if (value.empty())
+    {
+        out.clear();
+        return true;
+    }
+    if (!isValidClockTime(value))
+    {
+        std::cerr << "Конфигурация: " << where << ": неверное время '" << value << "' в поле " << key << " (нужно hh:mm)." << std::endl;
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+} // namespace
+
+bool intervalMinutesToSec(double minutes, int &out_sec)
+{
+    if (!(minutes >= 0.0 && minutes <= INT_MAX / 60) || std::floor(minutes) != minutes)
+        return false;
+    out_sec = static_cast<int>(minutes) * 60;
+    return true;
+}
+
+bool validateMapObject(const MapObject &obj, std::string &reason)
+{
+    if (obj.name.empty())
+        reason = "имя объекта не может быть пустым";
+    else if (obj.radius_km <= 0)
+        reason = "неверный радиус";
+    else if (!(obj.latitude_center >= -90.0 && obj.latitude_center <= 90.0))
+        reason = "широта вне диапазона [-90, 90]";
+    else if (!(obj.longitude_center >= -180.0 && obj.longitude_center <= 180.0))
+        reason = "долгота вне диапазона [-180, 180]";
+    else if (obj.capture_interval_sec != 0 && obj.capture_interval_sec < 60)
+        reason = "неверное значение интервала съемки (минимум 1 минута)";
+    else if (!obj.start_time.empty() && !isValidClockTime(obj.start_time))
+        reason = "неверное время '" + obj.start_time + "' в поле start_time (нужно hh:mm)";
+    else if (!obj.end_time.empty() && !isValidClockTime(obj.end_time))
+        reason = "неверное время '" + obj.end_time + "' в поле end_time (нужно hh:mm)";
+    else
+        return true;
+    return false;
+}
+
+bool mapObjectFromJson(const QJsonObject &item,
+                       const std::string &base_directory,
+                       std::vector<MapObject> &out,
+                       std::string &reason)
+{
+    const std::string name = item.value("name").toString().trimmed().toStdString();
+    if (!item.value("lat").isDouble() || !item.value("lon").isDouble())
+    {
+        reason = "неверные широта или долгота";
+        return false;
+    }
+    std::string save_directory = item.value("save_directory").toString().trimmed().toStdString();
+    if (save_directory.empty())
+        save_directory = base_directory + "/" + name;
+
+    MapObject obj(item.value("lat").toDouble(), item.value("lon").toDouble(), item.value("radius_km").toInt(), name, save_directory);
+    if (item.contains("interval_min") &&
+        (!item.value("interval_min").isDouble() || !intervalMinutesToSec(item.value("interval_min").toDouble(), obj.capture_interval_sec)))
+    {
+        reason = "неверный интервал съемки";
+        return false;
+    }
+    obj.start_time = item.value("start_time").toString().toStdString();
+    obj.end_time = item.value("end_time").toString().toStdString();
+    obj.priority = item.value("priority").toInt();
+    obj.burst_capture = item.value("burst").toBool();
+    obj.archive_captures = item.value("archive").toBool();
+    obj.lazy_composite = item.value("lazy_composite").toBool();
+    if (!validateMapObject(obj, reason))
+        return false;
+    out.push_back(std::move(obj));
+    return true;
+}
+
+bool appendMapObjectFromJson(const QJsonObject &item,
+                             const std::string &base_directory,
+                             const std::string &where,
+                             std::vector<MapObject> &out)
+{
+    std::string reason;
+    if (mapObjectFromJson(item, base_directory, out, reason))
+        return true;
+    const QString name = item.value("name").toString().trimmed();
+    std::cerr << "Конфигурация: " << (name.isEmpty() ? where : name.toStdString()) << ": " << reason << "." << std::endl;
+    return false;
+}
+
+void ensureDirectory(const std::string &path)
+{
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec))
+    {
+        std::filesystem::create_directories(path, ec);
+        if (ec)
+            std::cerr << "Предупреждение: Не удалось создать базовый каталог для скриншотов '" << path << "': " << ec.message() << std::endl;
+    }
+}
+
+bool loadCaptureConfig(const std::string &path, CaptureConfig &out)
+{
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        std::cerr << "Не удалось открыть файл конфигурации: " << path << std::endl;
+        return false;
+    }
+    QJsonParseError parse_error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parse_error);
+    if (parse_error.error != QJsonParseError::NoError || !document.isObject())
+    {
+        std::cerr << "Ошибка разбора конфигурации " << path << ": " << parse_error.errorString().toStdString()
+                  << " (смещение " << parse_error.offset << ")" << std::endl;
+        return false;
+    }
+    const QJsonObject root = document.object();
+
+    CaptureConfig config;
+    if (!readTime(root, "start_time", config.start_time, "общие настройки") ||
+        !readTime(root, "end_time", config.end_time, "общие настройки"))
+        return false;
+    if (config.start_time.empty() || config.end_time.empty())
+    {
+        std::cerr << "Конфигурация: общее окно съемки start_time/end_time не может быть пустым." << std::endl;
+        return false;
+    }
+    if (root.contains("interval_min") &&
+        (!root.value("interval_min").isDouble() || !intervalMinutesToSec(root.value("interval_min").toDouble(), config.capture_interval_sec)))
+    {
+        std::cerr << "Конфигурация: общие настройки: неверный интервал съемки." << std::endl;
+        return false;
+    }
+    if (config.capture_interval_sec < 60)
+    {
+        std::cerr << "Конфигурация: неверное значение интервала съемки (минимум 1 минута)." << std::endl;
+        return false;
+    }
+    if (root.contains("max_concurrent_fetches"))
+        config.fetch_budget.max_concurrent_fetches = root.value("max_concurrent_fetches").toInt();
+    if (config.fetch_budget.max_concurrent_fetches < 1)
+    {
+        std::cerr << "Конфигурация: неверное число одновременных загрузок (минимум 1)." << std::endl;
+        return false;
+    }
+    config.fetch_budget.max_bytes_per_sec = static_cast<long long>(root.value("max_bytes_per_sec").toDouble(0.0));
+    if (root.contains("base_directory"))
+        config.base_directory = root.value("base_directory").toString().toStdString();
+    if (root.contains("log_level"))
+    {
+        const std::string level = root.value("log_level").toString().toStdString();
+        if (!parseLogLevel(level, config.log_level))
+        {
+            std::cerr << "Конфигурация: неизвестный уровень журнала " << level << " (debug, info, warning, error)." << std::endl;
+            return false;
+        }
+    }
+    config.log_file = root.value("log_file").toString().toStdString();
+    config.metrics_file = root.value("metrics_file").toString().toStdString();
+    config.tile_server_url = root.value("tile_server_url").toString().toStdString();
+    config.record_session = root.value("record_session").toString().toStdString();
+    if (root.contains("metrics_interval_sec"))
+        config.metrics_interval_sec = root.value("metrics_interval_sec").toInt();
+    if (config.metrics_interval_sec < 1)
+    {
+        std::cerr << "Конфигурация: неверный период записи метрик (минимум 1 с)." << std::endl;
+        return false;
+    }
+
+    const QJsonArray objects = root.value("objects").toArray();
+    if (objects.isEmpty())
+    {
+        std::cerr << "Конфигурация: список объектов для съемки пуст." << std::endl;
+        return false;
+    }
+    std::unordered_set<std::string> names;
+    config.objects.reserve(objects.size());
+    for (int i = 0; i < objects.size(); ++i)
+    {
+        const QJsonObject item = objects.at(i).toObject();
+        if (!appendMapObjectFromJson(item, config.base_directory, "объект #" + std::to_string(i + 1), config.objects))
+            return false;
+        if (!names.insert(config.objects.back().name).second)
+        {
+            std::cerr << "Конфигурация: объект с именем " << config.objects.back().name << " уже существует." << std::endl;
+            return false;
+        }
+    }
+
+    out = std::move(config);
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef CAPTURECONFIG_H
+#define CAPTURECONFIG_H
+
+#include <QJsonObject>
+
+#include <string>
+#include <vector>
+
+#include "MapObject.h"
+#include "asynclog.h"
+#include "fetchpool.h"
+
+// Объекты и расписание захвата для запуска без окна (screend).
+// Файл — JSON:
+// {
+//   "start_time": "08:00", "end_time": "20:00", "interval_min": 10,
+//   "max_concurrent_fetches": 8, "max_bytes_per_sec": 0,
+//   "base_directory": "./screenshots_output",
+//   "log_level": "info",                 // debug | info | warning | error
+//   "log_file": "",                      // пустой — stdout/stderr
+//   "metrics_file": "",                  // метрики в формате Prometheus, пустой — не писать
+//   "metrics_interval_sec": 15,
+//   "tile_server_url": "",               // пустой — сервис по умолчанию
+//   "record_session": "",                // запись запросов плиток для воспроизведения (tilesession.h)
+//   "objects": [
+//     { "name": "Объект1", "lat": 45.07, "lon": 39.0, "radius_km": 5,
+//       "save_directory": "...",            // по умолчанию <base_directory>/<name>
+//       "interval_min": 0, "start_time": "", "end_time": "", "priority": 0,
+//       "burst": false, "archive": false, "lazy_composite": false }
+//   ]
+// }
+// Поля объекта, кроме name/lat/lon/radius_km, необязательны.
+struct CaptureConfig
+{
+    std::string start_time = "00:00";
+    std::string end_time = "23:59";
+    int capture_interval_sec = 600;
+    FetchBudget fetch_budget;
+    std::string base_directory = "./screenshots_output";
+    LogLevel log_level = LogLevel::Info;
+    std::string log_file;
+    std::string metrics_file;
+    int metrics_interval_sec = 15;
+    std::string tile_server_url; // Пустой — адрес по умолчанию (CaptureThread::setTileServerUrl)
+    std::string record_session;  // Пустой — сеанс не записывается
+    std::vector<MapObject> objects;
+};
+
+// Время суток hh:mm, как в полях времени окна программы
+bool isValidClockTime(const std::string &text);
+
+// Интервал съемки в минутах (поле interval_min) в секундах: целое от 0 до INT_MAX / 60,
+// иначе false. Общее правило для конфигурации и импорта списков.
+bool intervalMinutesToSec(double minutes, int &out_sec);
+
+// Проверяет параметры объекта: имя, радиус, диапазоны широты и долготы, интервал и окно.
+// Общие правила для конфигурации и импорта списков; при ошибке причина — в reason.
+bool validateMapObject(const MapObject &obj, std::string &reason);
+
+// Разбирает описание одного объекта (формат элемента "objects") и добавляет его в out.
+// Уникальность имени не проверяется — это дело вызывающего. Сообщений не пишет: причина — в reason.
+bool mapObjectFromJson(const QJsonObject &item,
+                       const std::string &base_directory,
+                       std::vector<MapObject> &out,
+                       std::string &reason);
+
+// То же с сообщением об ошибке в std::cerr; where — для сообщений об объекте без имени.
+bool appendMapObjectFromJson(const QJsonObject &item,
+                             const std::string &base_directory,
+                             const std::string &where,
+                             std::vector<MapObject> &out);
+
+// Создает базовый каталог снимков, если его нет; ошибка — только предупреждение в std::cerr
+void ensureDirectory(const std::string &path);
+
+// Читает и проверяет конфигурацию по тем же правилам, что и окно программы.
+// При ошибке пишет причину в std::cerr и возвращает false, out не меняется.
+bool loadCaptureConfig(const std::string &path, CaptureConfig &out);
+
+#endif // CAPTURECONFIG_H
@@ -0,0 +1,67 @@
+#include "capturescheduler.h"
+
+void CaptureScheduler::schedule(size_t object_index, Clock::time_point deadline)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push({deadline, object_index});
+        m_woken = true;
+    }
+    m_cv.notify_all();
+}
+
+std::vector<std::pair<size_t, CaptureScheduler::Clock::time_point>> CaptureScheduler::popDue(Clock::time_point now)
+{
+    std::vector<std::pair<size_t, Clock::time_point>> due;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_queue.empty() && m_queue.top().deadline <= now)
+    {
+        due.emplace_back(m_queue.top().object_index, m_queue.top().deadline);
+        m_queue.pop();
+    }
+    return due;
+}
+
+bool CaptureScheduler::empty() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.empty();
+}
+
+CaptureScheduler::Clock::time_point CaptureScheduler::nextDeadline() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.empty() ? Clock::time_point::max() : m_queue.top().deadline;
+}
+
+bool CaptureScheduler::waitUntil(Clock::time_point deadline, const std::atomic_bool &running)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_woken = false;
+    m_clock->waitUntil(lock, m_cv, deadline, [&]
+                       { return m_woken || !running; });
+    return running;
+}
+
+void CaptureScheduler::wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_woken = true;
+    }
+    m_cv.notify_all();
+}
+
+CaptureScheduler::Clock::time_point CaptureScheduler::nextSlot(Clock::time_point deadline, std::chrono::seconds interval, Clock::time_point now)
+{
+    if (interval.count() <= 0)
+        interval = std::chrono::seconds(60);
+    Clock::time_point next = deadline + interval;
+    if (next <= now)
+    {
+        // Пропущенные из-за долгого захвата слоты не догоняются пачкой
+        auto missed = (now - deadline) / interval;
+        next = deadline + interval * (missed + 1);
+    }
+    return next;
+}
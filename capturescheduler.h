@@ -0,0 +1,60 @@
+#ifndef CAPTURESCHEDULER_H
+#define CAPTURESCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "captureclock.h"
+
+// Очередь сроков захвата объектов на монотонных часах.
+// У каждого объекта свой следующий срок; поток захвата спит до ближайшего срока
+// на условной переменной и просыпается сразу по wake() (остановка, новые сроки).
+class CaptureScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Часы для ожидания сроков (по умолчанию настоящие). Задается до первого waitUntil.
+    void setClock(std::shared_ptr<CaptureClock> clock) { m_clock = std::move(clock); }
+
+    void schedule(size_t object_index, Clock::time_point deadline);
+
+    // Извлекает все объекты со сроком не позже now вместе с их сроками
+    std::vector<std::pair<size_t, Clock::time_point>> popDue(Clock::time_point now);
+
+    bool empty() const;
+    Clock::time_point nextDeadline() const;
+
+    // Ждет до deadline, вызова wake() или сброса running. Возвращает running.
+    bool waitUntil(Clock::time_point deadline, const std::atomic_bool &running);
+    void wake();
+
+    // Следующий срок после deadline с шагом interval, без накопления дрейфа:
+    // пропущенные слоты отбрасываются, фаза расписания сохраняется
+    static Clock::time_point nextSlot(Clock::time_point deadline, std::chrono::seconds interval, Clock::time_point now);
+
+private:
+    struct Entry
+    {
+        Clock::time_point deadline;
+        size_t object_index;
+    };
+    struct Later
+    {
+        bool operator()(const Entry &a, const Entry &b) const { return a.deadline > b.deadline; }
+    };
+
+    std::shared_ptr<CaptureClock> m_clock = systemCaptureClock();
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::priority_queue<Entry, std::vector<Entry>, Later> m_queue;
+    bool m_woken = false;
+};
+
+#endif // CAPTURESCHEDULER_H
@@ -1,152 +1,462 @@
 #include "capturethread.h"
-#include "snapshotapp.h" // Если SnapshotApp содержит MapObject или другие необходимые определения
 #include "MapObject.h"   // Включите, если MapObject вынесен в отдельный файл
 
 // Вспомогательная функция для объединения изображений (реализация)
+#include <QDateTime>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QFileInfoList>
 #include <QStringList>
 #include <QImage>
+#include <QImageReader>
 #include <QPainter>
 
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include "asynclog.h"
+#include "compositewriter.h"
+#include "metrics.h"
+#include "tilebundle.h"
+#include "tracing.h"
+
+// Шаг сетки плиток и охват одной плитки в градусах
+const double kGridStepLatDeg = 0.0137;
+const double kGridStepLonDeg = 0.0193;
+const double kTileSpanDeg = 0.01;
+
+const char *const kDefaultTileServerUrl = "https://static-maps.yandex.ru/1.x/";
+
+// Обработчик CURL: тело ответа накапливается в std::string
+size_t appendToString(char *data, size_t size, size_t nmemb, void *userdata)
+{
+    static_cast<std::string *>(userdata)->append(data, size * nmemb);
+    return size * nmemb;
+}
+
+// Метаданные композита пишутся рядом с ним в <файл>.json
+bool writeCompositeMetadata(const std::string &output_file_name, const QJsonObject &metadata)
+{
+    QSaveFile file(QString::fromStdString(output_file_name + ".json"));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        logError("composite_metadata_failed", "Ошибка записи метаданных композита file=%s.json", output_file_name.c_str());
+        return false;
+    }
+    file.write(QJsonDocument(metadata).toJson(QJsonDocument::Indented));
+    return file.commit();
+}
+
+// Индекс плитки в сетке хранится в имени файла после последнего '_'
+int tileIndexFromFileName(const QString &base_name)
+{
+    int last_underscore = base_name.lastIndexOf('_');
+    if (last_underscore == -1)
+        return -1;
+    bool ok = false;
+    int index = base_name.mid(last_underscore + 1).toInt(&ok);
+    return ok ? index : -1;
+}
+
+std::vector<int> collectMissingTiles(const std::string &temp_dir_path, int total_tiles)
+{
+    std::vector<char> present(static_cast<size_t>(std::max(0, total_tiles)), 0);
+    QDir tempDir(QString::fromStdString(temp_dir_path));
+    QStringList filters;
+    filters << "*.png";
+    const QFileInfoList fileList = tempDir.entryInfoList(filters, QDir::Files, QDir::NoSort);
+    for (const QFileInfo &info : fileList)
+    {
+        int index = tileIndexFromFileName(info.baseName());
+        if (index >= 0 && index < total_tiles && info.size() > 0)
+            present[index] = 1;
+    }
+    std::vector<int> missing;
+    for (int i = 0; i < total_tiles; ++i)
+    {
+        if (!present[i])
+            missing.push_back(i);
+    }
+    return missing;
+}
+
+// Путь сохранения берется из объекта, переданного потоку.
+// Уникальное имя файла включает имя объекта и время захвата (без расширения).
+std::string compositeBasePath(const std::string &output_dir_path, const std::string &object_name_identifier, const std::tm *current_time)
+{
+    char time_str_buffer[80];
+    std::strftime(time_str_buffer, sizeof(time_str_buffer), "%Y-%m-%d_%H-%M-%S", current_time);
+
+    return output_dir_path + "/" + safeObjectName(object_name_identifier) + "_" + time_str_buffer;
+}
+
+// Файл плитки для каждой ячейки сетки по индексу из имени; пустая строка — плитки нет
+std::vector<QString> mapTileFiles(const QFileInfoList &fileList, int grid_dim)
+{
+    const int total_cells = grid_dim * grid_dim;
+    std::vector<QString> cell_files(static_cast<size_t>(std::max(0, total_cells)));
+    for (const QFileInfo &info : fileList)
+    {
+        int index = tileIndexFromFileName(info.baseName());
+        if (index < 0 || index >= total_cells)
+        {
+            logWarning("tile_outside_grid", "Файл вне сетки пропущен grid=%d file=%s", grid_dim, info.absoluteFilePath().toStdString().c_str());
+            continue;
+        }
+        cell_files[index] = info.absoluteFilePath();
+    }
+    return cell_files;
+}
+
+std::vector<int> spiralTileOrder(int grid_dim)
+{
+    std::vector<int> order;
+    if (grid_dim <= 0)
+        return order;
+    const int total = grid_dim * grid_dim;
+    order.reserve(static_cast<size_t>(total));
+    // Квадратная спираль от центральной ячейки: шаги 1,1,2,2,3,3... вправо, вверх, влево, вниз.
+    // Первые (2k+1)^2 ячеек спирали — ровно кольца 0..k вокруг центра.
+    int row = (grid_dim - 1) / 2;
+    int col = (grid_dim - 1) / 2;
+    const int d_row[4] = {0, 1, 0, -1};
+    const int d_col[4] = {1, 0, -1, 0};
+    order.push_back(row * grid_dim + col);
+    for (int step = 1, dir = 0; static_cast<int>(order.size()) < total; ++step)
+    {
+        for (int turn = 0; turn < 2 && static_cast<int>(order.size()) < total; ++turn, dir = (dir + 1) % 4)
+        {
+            for (int k = 0; k < step && static_cast<int>(order.size()) < total; ++k)
+            {
+                row += d_row[dir];
+                col += d_col[dir];
+                if (row >= 0 && row < grid_dim && col >= 0 && col < grid_dim)
+                    order.push_back(row * grid_dim + col);
+            }
+        }
+    }
+    return order;
+}
+
+bool writeProgressiveComposite(const std::string &temp_dir_path,
+                               const std::string &output_dir_path,
+                               const std::tm *current_time,
+                               const std::string &object_name_identifier,
+                               int grid_dim,
+                               int core_dim,
+                               int scale_divisor)
+{
+    if (core_dim <= 0 || core_dim > grid_dim || scale_divisor <= 0)
+        return false;
+    TRACE_SPAN_DETAIL("core_preview", object_name_identifier.c_str());
+
+    QDir tempDir(QString::fromStdString(temp_dir_path));
+    QStringList filters;
+    filters << "*.png";
+    std::vector<QString> cell_files = mapTileFiles(tempDir.entryInfoList(filters, QDir::Files, QDir::NoSort), grid_dim);
+
+    const int offset = (grid_dim - core_dim) / 2;
+    QImage preview;
+    int cell_w = 0;
+    int cell_h = 0;
+    for (int r = 0; r < core_dim; ++r)
+    {
+        for (int c = 0; c < core_dim; ++c)
+        {
+            const int index = (offset + r) * grid_dim + (offset + c);
+            if (cell_files[index].isEmpty())
+                continue;
+            QImageReader reader(cell_files[index]);
+            if (!reader.size().isValid())
+                continue;
+            if (preview.isNull())
+            {
+                cell_w = std::max(1, reader.size().width() / scale_divisor);
+                cell_h = std::max(1, reader.size().height() / scale_divisor);
+                preview = QImage(core_dim * cell_w, core_dim * cell_h, QImage::Format_RGB32);
+                preview.fill(kUnfilledCellColor);
+            }
+            // Декодер сразу уменьшает плитку, полное разрешение не нужно
+            reader.setScaledSize(QSize(cell_w, cell_h));
+            QImage tile = reader.read();
+            if (tile.isNull())
+                continue;
+            QPainter painter(&preview);
+            painter.drawImage(c * cell_w, (core_dim - 1 - r) * cell_h, tile);
+        }
+    }
+    if (preview.isNull())
+        return false;
+
+    std::string preview_file_name = compositeBasePath(output_dir_path, object_name_identifier, current_time) + "_core.png";
+    const int64_t encode_started_us = monotonicUs();
+    const bool preview_saved = preview.save(QString::fromStdString(preview_file_name), "PNG");
+    objectMetrics(object_name_identifier).record(MetricStage::Encode, monotonicUs() - encode_started_us);
+    if (!preview_saved)
+    {
+        logError("preview_save_failed", "Ошибка сохранения предварительного композита file=%s", preview_file_name.c_str());
+        return false;
+    }
+    logInfo("preview_saved", "Предварительный композит центра сохранен object=%s file=%s", object_name_identifier.c_str(), preview_file_name.c_str());
+    return true;
+}
+
+std::string buildTileUrl(const std::string &server_url, std::pair<double, double> bottom_left_coord, int tile_px)
+{
+    double lat_bottom = bottom_left_coord.first;
+    double lon_left = bottom_left_coord.second;
+    double lon_right = lon_left + kTileSpanDeg;
+    double lat_top = lat_bottom + kTileSpanDeg;
+    std::ostringstream oss_api_url;
+    oss_api_url.imbue(std::locale("C"));
+    oss_api_url << server_url << "?bbox="
+                << lon_left << "," << lat_bottom << "~" << lon_right << "," << lat_top
+                << "&size=" << tile_px << "," << tile_px << "&l=map,trf";
+    return oss_api_url.str();
+}
+
+std::string tileFileName(const std::string &directory, const std::string &format, int index, const std::tm *current_time_tm)
+{
+    char filename_time_buffer[80];
+    std::strftime(filename_time_buffer, sizeof(filename_time_buffer), format.c_str(), current_time_tm);
+    return directory + "/" + filename_time_buffer + "_" + std::to_string(index) + ".png";
+}
+
+// Размер плитки читается из заголовка первого читаемого файла без полного декодирования
+QSize firstTileSize(const std::vector<QString> &cell_files)
+{
+    for (const QString &path : cell_files)
+    {
+        if (path.isEmpty())
+            continue;
+        QSize tile_size = QImageReader(path).size();
+        if (tile_size.isValid())
+            return tile_size;
+    }
+    return QSize();
+}
+
+// Метаданные захвата, общие для композита и пакета плиток
+QJsonObject compositeMetadata(const QJsonObject &capture_metadata,
+                              const std::string &object_name_identifier,
+                              int grid_dim,
+                              QSize tile_size,
+                              const std::vector<int> &missing_cells)
+{
+    QJsonObject metadata = capture_metadata;
+    metadata["object"] = QString::fromStdString(object_name_identifier);
+    metadata["grid_dim"] = grid_dim;
+    metadata["tile_width"] = tile_size.width();
+    metadata["tile_height"] = tile_size.height();
+    QJsonArray unfilled;
+    for (int index : missing_cells)
+    {
+        QJsonObject cell;
+        cell["index"] = index;
+        cell["row"] = index / grid_dim;
+        cell["col"] = index % grid_dim;
+        unfilled.append(cell);
+    }
+    metadata["unfilled_cells"] = unfilled;
+    return metadata;
+}
+
+void cleanupTempDirectory(const std::string &temp_dir_path, IoStage *io)
+{
+    if (io)
+    {
+        // Очистка не задерживает следующий захват; порядок с его операциями сохраняет очередь
+        io->removeAll(temp_dir_path);
+        return;
+    }
+    std::error_code ec_cleanup;
+    std::filesystem::remove_all(temp_dir_path, ec_cleanup);
+    if (ec_cleanup)
+    {
+        logError("temp_cleanup_failed", "Ошибка при очистке временного каталога dir=%s: %s", temp_dir_path.c_str(), ec_cleanup.message().c_str());
+    }
+    else
+    {
+        logDebug("temp_cleaned", "Временный каталог очищен dir=%s", temp_dir_path.c_str());
+    }
+}
+
+bool bundleAndCleanupScreenshots(const std::string &temp_dir_path,
+                                 const std::string &output_dir_path,
+                                 std::tm *current_time,
+                                 const std::string &object_name_identifier,
+                                 int grid_dim,
+                                 const QJsonObject &capture_metadata,
+                                 IoStage *io)
+{
+    TRACE_SPAN_DETAIL("bundle", object_name_identifier.c_str());
+    QDir tempDir(QString::fromStdString(temp_dir_path));
+    const QFileInfoList fileList = tempDir.entryInfoList(QStringList() << "*.png", QDir::Files, QDir::NoSort);
+    const std::vector<QString> cell_files = mapTileFiles(fileList, grid_dim);
+    const QSize tile_size = firstTileSize(cell_files);
+    if (grid_dim <= 0 || !tile_size.isValid())
+    {
+        logError("bundle_no_tiles", "Нет читаемых плиток, пакет не создан object=%s dir=%s", object_name_identifier.c_str(), temp_dir_path.c_str());
+        cleanupTempDirectory(temp_dir_path, io);
+        return false;
+    }
+
+    std::error_code ec_dir;
+    std::filesystem::create_directories(output_dir_path, ec_dir);
+    const std::string bundle_file_name = compositeBasePath(output_dir_path, object_name_identifier, current_time) + ".tiles";
+    std::vector<int> missing_cells;
+    // Плитки переносятся как есть: ни декодирования, ни сборки композита в цикле захвата
+    const bool saved = !ec_dir && writeTileBundle(bundle_file_name, grid_dim, tile_size, cell_files, &missing_cells);
+    if (saved)
+    {
+        writeCompositeMetadata(bundle_file_name, compositeMetadata(capture_metadata, object_name_identifier, grid_dim, tile_size, missing_cells));
+        logInfo("bundle_saved", "Пакет плиток сохранен object=%s file=%s", object_name_identifier.c_str(), bundle_file_name.c_str());
+    }
+    else
+    {
+        logError("bundle_save_failed", "Ошибка сохранения пакета плиток object=%s file=%s", object_name_identifier.c_str(), bundle_file_name.c_str());
+    }
+    cleanupTempDirectory(temp_dir_path, io);
+    return saved;
+}
+
 bool combineAndCleanupScreenshots(const std::string &temp_dir_path,
                                   const std::string &output_dir_path, // Это базовый путь для объекта
                                   std::tm *current_time,
-                                  const std::string &object_name_identifier)
+                                  const std::string &object_name_identifier,
+                                  int grid_dim,
+                                  std::vector<int> *unfilled_cells,
+                                  const QJsonObject &capture_metadata,
+                                  IoStage *io)
 {
+    TRACE_SPAN_DETAIL("combine", object_name_identifier.c_str());
+    if (unfilled_cells)
+        unfilled_cells->clear();
+
     QDir tempDir(QString::fromStdString(temp_dir_path));
     if (!tempDir.exists())
     {
-        std::cerr << "Временный каталог для объединения не существует: " << temp_dir_path << std::endl;
+        logError("combine_no_temp_dir", "Временный каталог для объединения не существует dir=%s", temp_dir_path.c_str());
         std::error_code ec;
         std::filesystem::remove_all(temp_dir_path, ec); // Попытка очистки
         if (ec)
         {
-            std::cerr << "Ошибка при очистке несуществующего временного каталога (filesystem): " << ec.message() << std::endl;
+            logError("temp_cleanup_failed", "Ошибка при очистке несуществующего временного каталога dir=%s: %s", temp_dir_path.c_str(), ec.message().c_str());
         }
         return false;
     }
 
     QStringList filters;
     filters << "*.png";
-    QFileInfoList fileList = tempDir.entryInfoList(filters, QDir::Files, QDir::Name);
+    QFileInfoList fileList = tempDir.entryInfoList(filters, QDir::Files, QDir::NoSort);
 
-    if (fileList.isEmpty())
+    if (fileList.isEmpty() || grid_dim <= 0)
     {
-        std::cerr << "Временные скриншоты в каталоге " << temp_dir_path << " не найдены. Объединение пропущено для объекта " << object_name_identifier << "." << std::endl;
+        logError("combine_no_tiles", "Временные скриншоты не найдены, объединение пропущено object=%s dir=%s", object_name_identifier.c_str(), temp_dir_path.c_str());
         std::error_code ec;
         std::filesystem::remove_all(temp_dir_path, ec);
         if (ec)
         {
-            std::cerr << "Ошибка при очистке пустого временного каталога (filesystem): " << ec.message() << std::endl;
+            logError("temp_cleanup_failed", "Ошибка при очистке пустого временного каталога dir=%s: %s", temp_dir_path.c_str(), ec.message().c_str());
         }
         return false;
     }
 
-    std::sort(fileList.begin(), fileList.end(), [](const QFileInfo &a, const QFileInfo &b)
-              {
-                  QString name_a = a.baseName();
-                  QString name_b = b.baseName();
-                  int last_underscore_a = name_a.lastIndexOf('_');
-                  int last_underscore_b = name_b.lastIndexOf('_');
-                  int index_a = (last_underscore_a != -1) ? name_a.mid(last_underscore_a + 1).toInt() : -1;
-                  int index_b = (last_underscore_b != -1) ? name_b.mid(last_underscore_b + 1).toInt() : -1;
-                  return index_a < index_b; });
+    // Плитки размещаются по индексу ячейки из имени файла, а не по порядку в каталоге:
+    // отсутствующие плитки не сдвигают остальные и не делают сетку невалидной
+    const int total_cells = grid_dim * grid_dim;
+    std::vector<QString> cell_files = mapTileFiles(fileList, grid_dim);
 
-    int total_images = fileList.size();
-    int N_grid_dim = static_cast<int>(std::sqrt(static_cast<double>(total_images)));
-
-    if (N_grid_dim * N_grid_dim != total_images)
-    {
-        std::cerr << "Ошибка для объекта " << object_name_identifier << ": Общее количество скриншотов (" << total_images
-                  << ") не является полным квадратом. Невозможно сформировать сетку " << N_grid_dim << "x" << N_grid_dim
-                  << ". Временные файлы сохранены в " << temp_dir_path << std::endl;
-        return false; // НЕ очищать временные файлы в этом случае
-    }
-
-    QImage firstImage(fileList.first().absoluteFilePath());
-    if (firstImage.isNull())
+    const QSize tile_size = firstTileSize(cell_files);
+    if (!tile_size.isValid())
     {
-        std::cerr << "Ошибка загрузки первого изображения для объекта " << object_name_identifier << ": "
-                  << fileList.first().absoluteFilePath().toStdString() << std::endl;
+        logError("combine_unreadable_tiles", "Ни одна плитка не читается object=%s dir=%s", object_name_identifier.c_str(), temp_dir_path.c_str());
         std::error_code ec;
         std::filesystem::remove_all(temp_dir_path, ec);
         if (ec)
         {
-            std::cerr << "Ошибка при очистке filesystem после сбоя загрузки первого изображения: " << ec.message() << std::endl;
+            logError("temp_cleanup_failed", "Ошибка при очистке после сбоя загрузки плиток dir=%s: %s", temp_dir_path.c_str(), ec.message().c_str());
         }
         return false;
     }
 
-    int img_width = firstImage.width();
-    int img_height = firstImage.height();
+    int N_grid_dim = grid_dim;
+    int img_width = tile_size.width();
+    int img_height = tile_size.height();
     int composite_width = N_grid_dim * img_width;
     int composite_height = N_grid_dim * img_height;
 
-    QImage compositeImage(composite_width, composite_height, QImage::Format_RGB32);
-    compositeImage.fill(Qt::white);
-    QPainter painter(&compositeImage);
-
-    for (int i = 0; i < total_images; ++i)
-    {
-        QImage img(fileList.at(i).absoluteFilePath());
-        if (img.isNull())
-        {
-            std::cerr << "Ошибка загрузки изображения: " << fileList.at(i).absoluteFilePath().toStdString() << ". Пропуск." << std::endl;
-            continue;
-        }
-        int row = i / N_grid_dim;
-        int col = i % N_grid_dim;
-        int composite_row = (N_grid_dim - 1) - row;
-        painter.drawImage(col * img_width, composite_row * img_height, img);
-    }
-    painter.end();
-
-    char time_str_buffer[80];
-    std::strftime(time_str_buffer, sizeof(time_str_buffer), "%Y-%m-%d_%H-%M-%S", current_time);
-
-    // Путь сохранения теперь берется из объекта, переданного потоку
-    // Уникальное имя файла включает имя объекта
-    std::string safe_object_name = object_name_identifier;
-    std::replace_if(safe_object_name.begin(), safe_object_name.end(), [](char c)
-                    { return !std::isalnum(c) && c != '_' && c != '-'; }, '_');
-
-    std::string output_file_name = output_dir_path + "/" + safe_object_name + "_" + time_str_buffer + ".bmp";
+    std::string output_file_name = compositeBasePath(output_dir_path, object_name_identifier, current_time) + ".bmp";
 
     // Убедиться, что выходной каталог объекта существует перед сохранением
     std::error_code ec_dir;
     std::filesystem::create_directories(output_dir_path, ec_dir);
     if (ec_dir)
     {
-        std::cerr << "Ошибка создания выходного каталога для объекта " << object_name_identifier << ": " << output_dir_path << " - " << ec_dir.message() << std::endl;
+        logError("output_dir_failed", "Ошибка создания выходного каталога object=%s dir=%s: %s", object_name_identifier.c_str(), output_dir_path.c_str(), ec_dir.message().c_str());
         // Продолжить очистку временной папки, даже если не удалось сохранить
     }
 
+    // Плитки декодируются прямо в отображенный в память выходной файл
     bool save_success = false;
-    if (!ec_dir)
-    { // Только если удалось создать выходной каталог
-        save_success = compositeImage.save(QString::fromStdString(output_file_name), "BMP");
-    }
-
-    std::error_code ec_cleanup;
-    std::filesystem::remove_all(temp_dir_path, ec_cleanup);
-    if (ec_cleanup)
+    std::vector<int> missing_cells;
+    MappedBmpWriter writer;
+    StageMetrics &metrics = objectMetrics(object_name_identifier);
+    writer.setMetrics(&metrics);
+    if (!ec_dir && writer.open(output_file_name, composite_width, composite_height))
     {
-        std::cerr << "Ошибка при очистке временного каталога '" << temp_dir_path << "' (filesystem): " << ec_cleanup.message() << std::endl;
+        for (int i = 0; i < total_cells; ++i)
+        {
+            int row = i / N_grid_dim;
+            int col = i % N_grid_dim;
+            int composite_row = (N_grid_dim - 1) - row;
+            bool filled = false;
+            if (!cell_files[i].isEmpty())
+            {
+                filled = writer.decodeTileInto(cell_files[i], col * img_width, composite_row * img_height);
+                if (!filled)
+                {
+                    logWarning("tile_decode_failed", "Ошибка загрузки изображения, пропуск file=%s", cell_files[i].toStdString().c_str());
+                }
+            }
+            if (!filled)
+            {
+                writer.fillRect(col * img_width, composite_row * img_height, img_width, img_height, kUnfilledCellColor);
+                missing_cells.push_back(i);
+            }
+        }
+        const int64_t close_started_us = monotonicUs();
+        save_success = writer.close();
+        metrics.record(MetricStage::Write, monotonicUs() - close_started_us);
+        if (!save_success)
+            writer.discard();
     }
-    else
+
+    if (save_success)
     {
-        std::cout << "Временный каталог '" << temp_dir_path << "' очищен." << std::endl;
+        if (!missing_cells.empty())
+        {
+            logWarning("composite_unfilled", "Ячейки не заполнены и помечены object=%s missing=%zu total=%d file=%s",
+                       object_name_identifier.c_str(), missing_cells.size(), total_cells, output_file_name.c_str());
+        }
+        writeCompositeMetadata(output_file_name, compositeMetadata(capture_metadata, object_name_identifier, N_grid_dim, tile_size, missing_cells));
     }
+    if (unfilled_cells)
+        *unfilled_cells = missing_cells;
+
+    cleanupTempDirectory(temp_dir_path, io);
 
     if (save_success)
     {
-        std::cout << "Композитный скриншот для объекта " << object_name_identifier << " сохранен: " << output_file_name << std::endl;
+        logInfo("composite_saved", "Композитный скриншот сохранен object=%s file=%s", object_name_identifier.c_str(), output_file_name.c_str());
         return true;
     }
     else
     {
-        std::cerr << "Ошибка сохранения композитного скриншота для объекта " << object_name_identifier << ": " << output_file_name << std::endl;
+        logError("composite_save_failed", "Ошибка сохранения композитного скриншота object=%s file=%s", object_name_identifier.c_str(), output_file_name.c_str());
         return false;
     }
 }
@@ -154,170 +464,910 @@ bool combineAndCleanupScreenshots(const std::string &temp_dir_path,
 // В capturethread.cpp, перед функцией combineAndCleanupScreenshots или в начале файла
 const std::string screen_temp_directory_name_base = "screen_temp";
 
+// Число проходов повторного запроса недостающих плиток
+const int kMaxRefetchPasses = 2;
+
+// Сторона плитки при деградации по разрешению
+const int kMinDegradedTilePx = 225;
+
+// Во сколько раз уменьшены плитки предварительного композита центра
+const int kProgressiveScaleDivisor = 4;
+
+// Шаблон имени файла плитки во временном каталоге (к нему добавляется _<индекс>.png)
+const std::string kTileFileFormat = "Скриншот_%Y-%m-%d_%H-%M-%S";
+
 // ... (определение функции combineAndCleanupScreenshots) ...
 
 CaptureThread::CaptureThread(std::vector<MapObject> objects,
                              int interval,
                              std::string st_time,
                              std::string en_time,
+                             FetchBudget budget,
                              QObject *parent)
     : QThread(parent),
       m_mapObjects(std::move(objects)),
       m_capture_interval_sec(interval),
       m_start_time_str(std::move(st_time)),
       m_end_time_str(std::move(en_time)),
+      m_fetch_budget(budget),
       running(false) {}
 
 void CaptureThread::stop()
 {
     running = false;
+    m_scheduler.wake();
 }
 
 void CaptureThread::run()
 {
     running = true;
-    std::cout << "Поток захвата запущен." << std::endl;
+    TRACE_THREAD_NAME("capture");
+    logInfo("capture_started", "Поток захвата запущен objects=%zu", m_mapObjects.size());
 
-    while (running)
+    using Clock = CaptureScheduler::Clock;
+    m_scheduler.setClock(m_clock);
+
+    // Пул живет все время работы потока: объекты со своими сроками попадают в него независимо
+    FetchPool pool(m_fetch_budget);
+    m_io = std::make_unique<IoStage>();
+    m_archives.clear();
+    for (const MapObject &obj : m_mapObjects)
+    {
+        std::unique_ptr<CaptureArchive> archive;
+        if (obj.archive_captures && obj.lazy_composite)
+            logWarning("archive_disabled", "При отложенном композите архив не ведется, плитки хранятся пакетами object=%s", obj.name.c_str());
+        else if (obj.archive_captures)
+            archive = std::make_unique<CaptureArchive>(CaptureArchive::directoryFor(obj.save_directory, obj.name));
+        m_archives.push_back(std::move(archive));
+    }
     {
-        std::time_t now_t = std::time(nullptr);
-        std::tm *current_time_tm = std::localtime(&now_t);
+        std::lock_guard<std::mutex> lock(m_in_flight_mutex);
+        m_in_flight.assign(m_mapObjects.size(), 0);
+    }
+    if (!m_schedule_only)
+        expireStaleCaptures();
 
-        if (!current_time_tm)
+    if (m_one_shot)
+    {
+        runOnce(pool);
+        m_io.reset();
+        TRACE_CYCLE_END("once");
+        return;
+    }
+
+    std::tm start_tm{};
+    m_clock->localTime(start_tm);
+    const Clock::time_point start = m_clock->now();
+    const int64_t start_ms = m_clock->unixMs();
+    for (size_t i = 0; i < m_mapObjects.size(); ++i)
+    {
+        const MapObject &obj = m_mapObjects[i];
+        auto last = m_last_capture_ms.find(obj.name);
+        if (last == m_last_capture_ms.end())
         {
-            std::cerr << "Ошибка получения текущего времени. Пропускаем цикл захвата." << std::endl;
-            sleepAndCheckRunning(10);
+            m_scheduler.schedule(i, start + std::chrono::seconds(firstCaptureDelaySec(obj, start_tm)));
             continue;
         }
+        // Объект уже снимался: его расписание продолжается с прежнего захвата
+        const int64_t due_ms = last->second + static_cast<int64_t>(intervalFor(obj)) * 1000;
+        m_scheduler.schedule(i, start + std::chrono::milliseconds(std::max<int64_t>(0, due_ms - start_ms)));
+    }
 
-        if (!isWithinCaptureTimeWindow(current_time_tm))
+    while (running)
+    {
+#ifdef SCREEN_TRACING
+        if (m_trace_cycle_done.exchange(false))
+            TRACE_CYCLE_END("cycle");
+#endif
+        const Clock::time_point now = m_clock->now();
+        auto due = m_scheduler.popDue(now);
+        if (!due.empty())
         {
-            sleepAndCheckRunning(300);
+            TRACE_SPAN("schedule_due");
+            std::tm current_time_tm{};
+            if (!m_clock->localTime(current_time_tm))
+            {
+                logError("local_time_failed", "Ошибка получения текущего времени, цикл захвата пропущен");
+                for (const auto &item : due)
+                    m_scheduler.schedule(item.first, now + std::chrono::seconds(10));
+                continue;
+            }
+
+            for (const auto &item : due)
+            {
+                const size_t index = item.first;
+                const MapObject &mapObject = m_mapObjects[index];
+
+                if (!isWithinCaptureTimeWindow(&current_time_tm, startTimeFor(mapObject), endTimeFor(mapObject)))
+                {
+                    // Вне окна следующий срок переносится на открытие окна
+                    int wait_sec = secondsUntilWindowStart(&current_time_tm, startTimeFor(mapObject));
+                    m_scheduler.schedule(index, now + std::chrono::seconds(wait_sec > 0 ? wait_sec : 300));
+                    continue;
+                }
+
+                // Следующий срок считается от запланированного, а не от фактического времени
+                const Clock::time_point next_deadline =
+                    CaptureScheduler::nextSlot(item.second, std::chrono::seconds(intervalFor(mapObject)), now);
+                m_scheduler.schedule(index, next_deadline);
+                if (m_slot_observer)
+                    m_slot_observer(index, m_clock->unixMs());
+                if (m_schedule_only)
+                    continue;
+
+                {
+                    std::lock_guard<std::mutex> lock(m_in_flight_mutex);
+                    if (m_in_flight[index])
+                    {
+                        logWarning("slot_skipped", "Предыдущий захват еще не завершен, слот пропущен object=%s", mapObject.name.c_str());
+                        continue;
+                    }
+                }
+
+                std::shared_ptr<ObjectCapture> capture = prepareObjectCapture(mapObject);
+                if (!capture)
+                    continue;
+                capture->object_index = index;
+                // Плитки объекта должны быть получены до его следующего срока
+                capture->deadline = next_deadline;
+
+                const double available_sec = std::chrono::duration<double>(next_deadline - now).count();
+                if (!planDegradation(*capture, pool, available_sec))
+                    continue;
+                startObjectCapture(pool, capture);
+            }
+        }
+
+        m_scheduler.waitUntil(m_scheduler.nextDeadline(), running);
+    }
+
+    // Незавершенные задания быстро выходят: createSnapshot не начинает загрузку после остановки
+    pool.waitIdle();
+    m_io.reset(); // Дожидается записи и очистки, поставленных в очередь
+    TRACE_CYCLE_END("stop");
+}
+
+// Разовый проход по всем объектам с максимальной пропускной способностью:
+// окно времени и интервалы не учитываются, захват не упрощается.
+void CaptureThread::runOnce(FetchPool &pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_stats_mutex);
+        m_stats = CaptureRunStats();
+        m_stats.objects = m_mapObjects.size();
+    }
+    m_fetched_bytes = 0;
+    const auto started = std::chrono::steady_clock::now();
+    logInfo("one_shot_started", "Разовый проход objects=%zu", m_mapObjects.size());
+
+    size_t index = 0;
+    for (; index < m_mapObjects.size() && running; ++index)
+    {
+        const MapObject &mapObject = m_mapObjects[index];
+        std::shared_ptr<ObjectCapture> capture = prepareObjectCapture(mapObject);
+        if (!capture)
+        {
+            recordObjectResult(false, 0);
             continue;
         }
+        capture->object_index = index;
+        // Срока нет: недостающие плитки запрашиваются повторно независимо от времени
+        capture->deadline = std::chrono::steady_clock::time_point::max();
+        startObjectCapture(pool, capture);
+    }
+    // После остановки не начатые объекты тоже не захвачены: иначе прерванный проход выглядит успешным
+    if (index < m_mapObjects.size())
+    {
+        logWarning("one_shot_stopped", "Разовый проход остановлен, не начато объектов: %zu", m_mapObjects.size() - index);
+        for (; index < m_mapObjects.size(); ++index)
+            recordObjectResult(false, 0);
+    }
+
+    pool.waitIdle();
+    m_io->flush(); // Время прохода включает запись на диск
+
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    m_stats.elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
 
-        std::cout << "Внутри времени захвата. Запуск обработки объектов (" << m_mapObjects.size() << " шт.)." << std::endl;
+CaptureRunStats CaptureThread::runStats() const
+{
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    CaptureRunStats stats = m_stats;
+    stats.bytes = m_fetched_bytes.load();
+    return stats;
+}
+
+void CaptureThread::recordTileRequest(const TileTiming &timing)
+{
+    if (!m_one_shot || timing.start_unix_ms == 0)
+        return;
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    if (timing.ok)
+        ++m_stats.tile_requests_ok;
+    else
+        ++m_stats.tile_requests_failed;
+    m_stats.tile_latency_ms.push_back(timing.end_unix_ms - timing.start_unix_ms);
+}
+
+void CaptureThread::recordObjectResult(bool complete, size_t missing_tiles)
+{
+    if (!m_one_shot)
+        return;
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    if (!complete)
+        ++m_stats.objects_incomplete;
+    m_stats.tiles_missing += missing_tiles;
+}
+
+// Если по текущей задержке плиток захват не успевает до следующего срока,
+// он упрощается по шагам: откладываются объекты с низким приоритетом,
+// затем снижается разрешение плиток, затем отбрасываются внешние кольца сетки.
+// Возвращает false, если захват объекта в этом слоте отложен.
+bool CaptureThread::planDegradation(ObjectCapture &capture, const FetchPool &pool, double available_sec)
+{
+    const MapObject &mapObject = *capture.object;
+    if (pool.tileLatencyEwmaSec() <= 0.0 || available_sec <= 0.0)
+        return true; // Замеров еще нет — прогнозировать не по чему
 
-        for (size_t i = 0; i < m_mapObjects.size() && running; ++i)
+    // Доля стоимости плитки относительно полного разрешения (по площади, но не меньше половины:
+    // задержка сети от размера почти не зависит)
+    auto tileCostFactor = [](int tile_px)
+    {
+        double area = static_cast<double>(tile_px) * tile_px / (450.0 * 450.0);
+        return std::max(0.5, area);
+    };
+    const double queued_sec = pool.predictSeconds(0);
+    auto predict = [&]()
+    {
+        double own_sec = (pool.predictSeconds(capture.coords.size()) - queued_sec) * tileCostFactor(capture.tile_px);
+        return queued_sec + own_sec;
+    };
+
+    double predicted = predict();
+    if (predicted <= available_sec)
+        return true;
+
+    std::ostringstream reason;
+    reason << "прогноз " << static_cast<int>(predicted) << " с при доступных " << static_cast<int>(available_sec) << " с";
+
+    if (mapObject.priority < 0)
+    {
+        logWarning("object_deferred", "Объект отложен object=%s priority=%d: %s", mapObject.name.c_str(), mapObject.priority, reason.str().c_str());
+        return false;
+    }
+
+    if (capture.tile_px > kMinDegradedTilePx)
+    {
+        capture.tile_px = kMinDegradedTilePx;
+        capture.degradations.push_back("resolution:" + std::to_string(capture.tile_px));
+        predicted = predict();
+    }
+
+    while (predicted > available_sec && capture.grid_dim > 1)
+    {
+        const int n = capture.grid_dim;
+        std::vector<std::pair<double, double>> inner;
+        inner.reserve(static_cast<size_t>(n - 2) * (n - 2));
+        for (int row = 1; row < n - 1; ++row)
         {
-            const auto &mapObject = m_mapObjects[i];
-            std::cout << "Обработка объекта: " << mapObject.name << std::endl;
-            std::vector<std::pair<double, double>> current_object_coords;
-            generateCoordinatesForObject(mapObject, current_object_coords);
+            for (int col = 1; col < n - 1; ++col)
+                inner.push_back(capture.coords[static_cast<size_t>(row) * n + col]);
+        }
+        capture.coords.swap(inner);
+        capture.grid_dim = n - 2;
+        ++capture.skipped_rings;
+        predicted = predict();
+    }
+    if (capture.skipped_rings > 0)
+        capture.degradations.push_back("outer_rings:" + std::to_string(capture.skipped_rings));
 
-            if (current_object_coords.empty())
-            {
-                std::cerr << "Нет координат для объекта " << mapObject.name << ". Пропуск." << std::endl;
-                continue;
-            }
+    logWarning("object_degraded", "Объект упрощен object=%s tile_px=%d grid=%d: %s", mapObject.name.c_str(), capture.tile_px, capture.grid_dim, reason.str().c_str());
+    return true;
+}
 
-            std::string object_temp_dir_name = screen_temp_directory_name_base + "_" + mapObject.name;
-            std::string object_temp_full_path = mapObject.save_directory + "/" + object_temp_dir_name;
+// Объект отмечается как захватываемый, и его плитки отправляются в пул
+void CaptureThread::startObjectCapture(FetchPool &pool, std::shared_ptr<ObjectCapture> capture)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_in_flight_mutex);
+        m_in_flight[capture->object_index] = 1;
+    }
+    openTileJournal(*capture);
+    prepareTileOrder(*capture);
+    // Плитки из журнала уже на диске: они считаются полученными и повторно не запрашиваются
+    for (size_t u = 0; u < capture->resumed.size(); ++u)
+    {
+        if (!capture->resumed[u])
+            continue;
+        capture->tile_timings[u].index = static_cast<int>(u);
+        capture->tile_timings[u].ok = true;
+        if (capture->spiral_rank[u] < capture->core_dim * capture->core_dim)
+            --capture->core_remaining; // Центр, полученный целиком до сбоя, заново не публикуется
+    }
 
-            std::error_code ec;
-            std::filesystem::remove_all(object_temp_full_path, ec);
-            if (ec)
-            {
-                std::cerr << "Ошибка при очистке временного каталога объекта " << mapObject.name << ": " << ec.message() << std::endl;
-            }
+    ProgressEvent started;
+    started.kind = ProgressEvent::ObjectStarted;
+    started.object_index = static_cast<uint32_t>(capture->object_index);
+    // Плитки из журнала не приходят событиями TileDone, поэтому в итог не входят
+    started.value = static_cast<uint32_t>(capture->coords.size() - capture->resumed_tiles);
+    reportProgress(started);
 
-            std::filesystem::create_directories(object_temp_full_path, ec);
-            if (ec)
-            {
-                std::cerr << "Ошибка создания временного каталога для объекта " << mapObject.name << ": " << object_temp_full_path << " - " << ec.message() << std::endl;
-                continue;
-            }
+    if (capture->object->burst_capture)
+    {
+        submitBurstCapture(pool, capture);
+        return;
+    }
+    std::vector<int> tiles;
+    tiles.reserve(capture->coords.size());
+    for (size_t u = 0; u < capture->coords.size(); ++u)
+    {
+        if (!capture->resumed[u])
+            tiles.push_back(static_cast<int>(u));
+    }
+    if (tiles.empty())
+    {
+        // Все плитки получены до сбоя — остается собрать композит
+        finishObjectCapture(pool, capture, {});
+        return;
+    }
+    submitObjectTiles(pool, capture, std::move(tiles));
+}
 
-            bool capture_loop_completed_for_object = true;
-            for (size_t u = 0; u < current_object_coords.size() && running; ++u)
-            {
-                std::time_t snap_time_t = std::time(nullptr);
-                std::tm *snap_time_tm = std::localtime(&snap_time_t);
-                createSnapshot(current_object_coords[u], object_temp_full_path, "Скриншот_%Y-%m-%d_%H-%M-%S", static_cast<int>(u), snap_time_tm);
-            }
+// Временный каталог и журнал захвата. Если после сбоя или перезапуска остался журнал
+// того же захвата (объект, разрешение, сетка) и срок его годности не истек, полученные
+// плитки остаются на месте; иначе каталог пересоздается и журнал начинается заново.
+void CaptureThread::openTileJournal(ObjectCapture &capture)
+{
+    const MapObject &mapObject = *capture.object;
+    const std::string journal_path = TileJournal::pathFor(capture.temp_dir);
+    const uint64_t fingerprint = TileJournal::fingerprint(mapObject.name, capture.tile_px, capture.coords);
+    const int64_t now_ms = m_clock->unixMs();
+    capture.resumed.assign(capture.coords.size(), 0);
+    capture.resumed_tiles = 0;
+    capture.journal = std::make_shared<TileJournal>();
 
-            if (!running)
+    TileJournalInfo info;
+    if (TileJournal::load(journal_path, info) && info.fingerprint == fingerprint &&
+        info.tile_count == capture.coords.size() && now_ms < info.valid_until_unix_ms)
+    {
+        // Плитка засчитывается, только если ее файл на месте и того же размера
+        std::vector<std::string> kept;
+        for (const JournaledTile &tile : info.tiles)
+        {
+            if (capture.resumed[tile.index] || tile.size == 0)
+                continue;
+            const QFileInfo file(QString::fromStdString(capture.temp_dir + "/" + tile.file_name));
+            if (file.exists() && file.size() == static_cast<qint64>(tile.size))
             {
-                capture_loop_completed_for_object = false;
-                std::cout << "Запрошена остановка во время захвата для объекта " << mapObject.name << std::endl;
+                capture.resumed[tile.index] = 1;
+                ++capture.resumed_tiles;
+                kept.push_back(tile.file_name);
             }
-
-            if (capture_loop_completed_for_object)
+        }
+        if (capture.journal->reopen(journal_path, info))
+        {
+            // Файлы без записи в журнале (сбой между записью плитки и журнала) удаляются,
+            // чтобы у ячейки не оказалось двух плиток
+            QDir tempDir(QString::fromStdString(capture.temp_dir));
+            const QFileInfoList fileList = tempDir.entryInfoList(QStringList() << "*.png", QDir::Files, QDir::NoSort);
+            for (const QFileInfo &file : fileList)
             {
-                now_t = std::time(nullptr);
-                current_time_tm = std::localtime(&now_t);
-                combineAndCleanupScreenshots(object_temp_full_path, mapObject.save_directory, current_time_tm, mapObject.name);
+                if (std::find(kept.begin(), kept.end(), file.fileName().toStdString()) == kept.end())
+                    m_io->removeAll(file.filePath().toStdString());
             }
-            else
+            capture.noteIo(m_io->createDirectories(capture.temp_dir));
+            logInfo("capture_resumed", "Захват продолжен по журналу object=%s tiles=%zu total=%zu",
+                    mapObject.name.c_str(), capture.resumed_tiles, capture.coords.size());
+            return;
+        }
+        capture.resumed.assign(capture.coords.size(), 0);
+        capture.resumed_tiles = 0;
+    }
+
+    // Каталог пересоздается в очереди IoStage: записи плиток встанут после него,
+    // а ошибка создания проявится как недостающие плитки
+    m_io->removeAll(capture.temp_dir);
+    capture.noteIo(m_io->createDirectories(capture.temp_dir));
+
+    // Журнал годен до срока захвата; у разового прохода срока нет — берется интервал объекта
+    int64_t valid_until_ms = now_ms + static_cast<int64_t>(std::max(60, intervalFor(mapObject))) * 1000;
+    if (capture.deadline != CaptureClock::time_point::max())
+        valid_until_ms = now_ms + std::chrono::duration_cast<std::chrono::milliseconds>(capture.deadline - m_clock->now()).count();
+    if (!capture.journal->create(journal_path, fingerprint, static_cast<uint32_t>(capture.coords.size()), now_ms, valid_until_ms))
+        capture.journal.reset();
+}
+
+// Журналы и временные каталоги прерванных захватов, которые уже не продолжатся: срок
+// журнала истек. Просматриваются только каталоги сохранения объектов этого потока.
+// Каталог без журнала и нечитаемый журнал удаляются, только если давно не менялись:
+// каталог сохранения может быть общим с объектом другого процесса захвата (screenshard),
+// у которого журнал еще создается.
+void CaptureThread::expireStaleCaptures()
+{
+    const int64_t now_ms = m_clock->unixMs();
+    const int64_t kOrphanAgeMs = 24 * 3600 * 1000LL;
+    const QStringList temp_filter = QStringList() << QString::fromStdString(screen_temp_directory_name_base + "_*");
+
+    std::vector<QString> directories;
+    for (const MapObject &obj : m_mapObjects)
+    {
+        const QString path = QDir(QString::fromStdString(obj.save_directory)).absolutePath();
+        if (std::find(directories.begin(), directories.end(), path) == directories.end())
+            directories.push_back(path);
+    }
+
+    size_t expired = 0;
+    for (const QString &directory : directories)
+    {
+        const QFileInfoList entries = QDir(directory).entryInfoList(temp_filter, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::NoSort);
+        for (const QFileInfo &entry : entries)
+        {
+            const bool old = now_ms - entry.lastModified().toMSecsSinceEpoch() > kOrphanAgeMs;
+            const std::string path = entry.absoluteFilePath().toStdString();
+            if (entry.isDir())
             {
-                std::cerr << "Захват для объекта " << mapObject.name << " прерван. Очистка временных файлов." << std::endl;
-                std::filesystem::remove_all(object_temp_full_path, ec);
-                if (ec)
+                // Каталог с журналом решается по журналу
+                if (!QFileInfo::exists(QString::fromStdString(TileJournal::pathFor(path))) && old)
                 {
-                    std::cerr << "Ошибка при очистке частичного временного каталога объекта " << mapObject.name << ": " << ec.message() << std::endl;
+                    m_io->removeAll(path);
+                    ++expired;
                 }
+                continue;
             }
+            if (entry.suffix() != "journal")
+                continue;
+            TileJournalInfo info;
+            const bool stale = TileJournal::load(path, info) ? info.valid_until_unix_ms <= now_ms : old;
+            if (!stale)
+                continue;
+            m_io->removeAll(path.substr(0, path.size() - 8)); // Без ".journal" — временный каталог
+            m_io->removeAll(path);
+            ++expired;
+        }
+    }
+    if (expired > 0)
+        logInfo("stale_captures_removed", "Удалены незавершенные захваты, которые уже не продолжатся: %zu", expired);
+}
+
+// Плитка пишется в фоне; в журнал она попадает только после того, как файл записан
+uint64_t CaptureThread::writeTileFile(const std::shared_ptr<TileJournal> &journal, int index, std::string path, std::string body)
+{
+    if (!journal)
+        return m_io->writeFile(std::move(path), std::move(body));
+    const uint32_t size = static_cast<uint32_t>(body.size());
+    const size_t slash = path.find_last_of("/\\");
+    std::string file_name = slash == std::string::npos ? path : path.substr(slash + 1);
+    return m_io->writeFile(std::move(path), std::move(body), false, [journal, index, size, file_name](bool ok)
+                           {
+                               if (ok)
+                                   journal->append(index, file_name, size); });
+}
+
+void CaptureThread::reportProgress(const ProgressEvent &event)
+{
+    if (m_progress)
+        m_progress->push(event);
+}
+
+void CaptureThread::reportTile(const ObjectCapture &capture, const TileTiming &timing)
+{
+    recordTileRequest(timing);
+    if (capture.metrics && timing.start_unix_ms != 0)
+    {
+        StageMetrics &metrics = *capture.metrics;
+        (timing.ok ? metrics.tiles_ok : metrics.tiles_failed).fetch_add(1, std::memory_order_relaxed);
+        metrics.bytes.fetch_add(timing.bytes, std::memory_order_relaxed);
+        // Этапы установки соединения есть только у новых соединений
+        if (timing.dns_us > 0)
+            metrics.record(MetricStage::Dns, timing.dns_us);
+        if (timing.connect_us > 0)
+            metrics.record(MetricStage::Connect, timing.connect_us);
+        if (timing.tls_us > 0)
+            metrics.record(MetricStage::Tls, timing.tls_us);
+        if (timing.ok)
+        {
+            metrics.record(MetricStage::FirstByte, timing.first_byte_us);
+            metrics.record(MetricStage::Transfer, timing.transfer_us);
+        }
+    }
+    if (!m_progress || timing.start_unix_ms == 0)
+        return;
+    ProgressEvent event;
+    event.kind = ProgressEvent::TileDone;
+    event.object_index = static_cast<uint32_t>(capture.object_index);
+    event.tile = timing.index;
+    event.ok = timing.ok;
+    event.bytes = timing.bytes;
+    event.latency_ms = static_cast<int32_t>(timing.end_unix_ms - timing.start_unix_ms);
+    m_progress->push(event);
+}
+
+void CaptureThread::prepareTileOrder(ObjectCapture &capture)
+{
+    const std::vector<int> order = spiralTileOrder(capture.grid_dim);
+    capture.spiral_rank.assign(order.size(), 0);
+    for (size_t rank = 0; rank < order.size(); ++rank)
+        capture.spiral_rank[order[rank]] = static_cast<int>(rank);
+
+    // Центральная область — примерно треть стороны сетки, нечетного размера.
+    // Для маленьких сеток предварительный композит не нужен: полный будет почти сразу.
+    capture.core_dim = 0;
+    if (capture.grid_dim >= 5)
+    {
+        capture.core_dim = std::max(1, capture.grid_dim / 3);
+        if (capture.core_dim % 2 == 0)
+            ++capture.core_dim;
+    }
+    capture.core_remaining = capture.core_dim * capture.core_dim;
+    capture.tile_timings.assign(capture.coords.size(), TileTiming());
+}
+
+int CaptureThread::intervalFor(const MapObject &obj) const
+{
+    return obj.capture_interval_sec > 0 ? obj.capture_interval_sec : m_capture_interval_sec;
+}
+
+const std::string &CaptureThread::startTimeFor(const MapObject &obj) const
+{
+    return obj.start_time.empty() ? m_start_time_str : obj.start_time;
+}
+
+const std::string &CaptureThread::endTimeFor(const MapObject &obj) const
+{
+    return obj.end_time.empty() ? m_end_time_str : obj.end_time;
+}
+
+int CaptureThread::firstCaptureDelaySec(const MapObject &obj, const std::tm &now_tm) const
+{
+    // Часовые интервалы выравниваются на начало часа (hh:01), как и раньше
+    const int interval = intervalFor(obj);
+    if (interval > 0 && interval % 3600 == 0 && now_tm.tm_min > 1)
+    {
+        return (60 - now_tm.tm_min) * 60 - now_tm.tm_sec + 60;
+    }
+    return 0;
+}
+
+std::shared_ptr<ObjectCapture> CaptureThread::prepareObjectCapture(const MapObject &mapObject)
+{
+    TRACE_SPAN_DETAIL("prepare_object", mapObject.name.c_str());
+    logInfo("object_capture", "Обработка объекта object=%s", mapObject.name.c_str());
+    auto capture = std::make_shared<ObjectCapture>();
+    capture->object = &mapObject;
+    capture->metrics = &objectMetrics(mapObject.name);
+    generateCoordinatesForObject(mapObject, capture->coords);
+
+    if (capture->coords.empty())
+    {
+        logError("object_no_coords", "Нет координат, объект пропущен object=%s", mapObject.name.c_str());
+        return nullptr;
+    }
+
+    std::string object_temp_dir_name = screen_temp_directory_name_base + "_" + mapObject.name;
+    capture->temp_dir = mapObject.save_directory + "/" + object_temp_dir_name;
+
+    capture->deadline = m_clock->now() + std::chrono::seconds(std::max(60, intervalFor(mapObject)));
+    capture->grid_dim = static_cast<int>(std::lround(std::sqrt(static_cast<double>(capture->coords.size()))));
+    return capture;
+}
 
-            if (!running)
-                break;
+void CaptureThread::submitObjectTiles(FetchPool &pool, std::shared_ptr<ObjectCapture> capture, std::vector<int> tiles)
+{
+    // Плитки запрашиваются по спирали от центра объекта
+    std::sort(tiles.begin(), tiles.end(), [&capture](int a, int b)
+              { return capture->spiral_rank[a] < capture->spiral_rank[b]; });
+
+    auto fetch = [this, &pool, capture](int u)
+    {
+        TRACE_SPAN_DETAIL("fetch_tile", capture->object->name.c_str());
+        // После срока объекта периферия отбрасывается, центр к этому времени уже получен
+        if (m_clock->now() >= capture->deadline)
+            return false;
+        std::tm snap_time_tm{};
+        if (!m_clock->localTime(snap_time_tm))
+            return false;
+        TileTiming &timing = capture->tile_timings[u];
+        timing.index = u;
+        timing.start_unix_ms = unixTimeMs();
+        uint64_t io_seq = 0;
+        bool ok = createSnapshot(capture->coords[u], capture->temp_dir, kTileFileFormat, u, &snap_time_tm, capture->tile_px, &io_seq, &timing, capture->journal);
+        timing.end_unix_ms = unixTimeMs();
+        timing.ok = ok;
+        reportTile(*capture, timing);
+        capture->noteIo(io_seq);
+        if (ok && capture->spiral_rank[u] < capture->core_dim * capture->core_dim && capture->core_remaining.fetch_sub(1) == 1)
+        {
+            // Центральная область готова — публикуется уменьшенный композит, не дожидаясь периферии.
+            // Плитки центра должны быть уже на диске; ждет и кодирует поток завершения, не загрузки.
+            const uint64_t core_io_seq = capture->last_io_seq.load();
+            pool.post([this, capture, snap_time_tm, core_io_seq]()
+                      {
+                          TRACE_SPAN_DETAIL("progressive_composite", capture->object->name.c_str());
+                          m_io->waitFor(core_io_seq);
+                          writeProgressiveComposite(capture->temp_dir, capture->object->save_directory, &snap_time_tm,
+                                                    capture->object->name, capture->grid_dim, capture->core_dim, kProgressiveScaleDivisor); });
+        }
+        return ok;
+    };
+    auto done = [this, &pool, capture](std::vector<int> failed_tiles)
+    {
+        finishObjectCapture(pool, capture, std::move(failed_tiles));
+    };
+    pool.submit(capture->object->name, std::move(tiles), fetch, done);
+}
+
+void CaptureThread::submitBurstCapture(FetchPool &pool, std::shared_ptr<ObjectCapture> capture)
+{
+    // Весь залп выполняется одной задачей пула: сетка планируется целиком,
+    // затем все запросы отпускаются сразу на всех местах бюджета (пул отдает залпу весь бюджет)
+    auto fetch = [this, capture, &pool](int connections)
+    {
+        TRACE_SPAN_DETAIL("burst_fetch", capture->object->name.c_str());
+        std::tm snap_time_tm{};
+        if (!m_clock->localTime(snap_time_tm))
+            return false;
+
+        std::vector<int> order = spiralTileOrder(capture->grid_dim);
+        std::vector<BurstRequest> requests;
+        requests.reserve(order.size());
+        for (int u : order)
+        {
+            if (capture->resumed[u])
+                continue;
+            BurstRequest request;
+            request.index = u;
+            request.url = buildTileUrl(m_tile_server_url, capture->coords[u], capture->tile_px);
+            request.file_path = tileFileName(capture->temp_dir, kTileFileFormat, u, &snap_time_tm);
+            requests.push_back(std::move(request));
         }
 
-        if (running)
+        logInfo("burst_started", "Залп запросов object=%s requests=%zu", capture->object->name.c_str(), requests.size());
+        // Ответы уходят в очередь записи сразу по получении, не задерживая залп
+        auto store = [this, capture](const BurstRequest &request, const TileTiming &timing, std::string body)
+        {
+            if (m_recorder)
+                m_recorder->record(request.url, timing, body);
+            m_fetched_bytes += body.size();
+            capture->noteIo(writeTileFile(capture->journal, request.index, request.file_path, std::move(body)));
+            return true;
+        };
+        std::vector<TileTiming> timings = burstFetch(requests, connections,
+                                                     pool.budget().perFetchBytesPerSec(), running, store);
+        for (const TileTiming &timing : timings)
+        {
+            if (timing.index >= 0 && timing.index < static_cast<int>(capture->tile_timings.size()))
+                capture->tile_timings[timing.index] = timing;
+            // Успешные ответы записаны в store; неудачные — здесь, без тела
+            if (m_recorder && !timing.ok && timing.bytes == 0 && timing.end_unix_ms != 0 && timing.index >= 0)
+                m_recorder->record(buildTileUrl(m_tile_server_url, capture->coords[timing.index], capture->tile_px), timing, std::string());
+            reportTile(*capture, timing);
+        }
+        return true;
+    };
+    auto done = [this, &pool, capture](std::vector<int>)
+    {
+        std::vector<int> failed_tiles;
+        for (size_t u = 0; u < capture->tile_timings.size(); ++u)
         {
-            auto now = std::chrono::system_clock::now();
-            std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-            std::tm *local_tm = std::localtime(&now_c);
+            if (!capture->tile_timings[u].ok)
+                failed_tiles.push_back(static_cast<int>(u));
+        }
+        finishObjectCapture(pool, capture, std::move(failed_tiles));
+    };
+    pool.submitBurst(capture->object->name, fetch, done);
+}
 
-            if (m_capture_interval_sec > 0)
-            {
-                int seconds_to_wait = m_capture_interval_sec;
-                if (m_capture_interval_sec % 3600 == 0 && local_tm && local_tm->tm_min > 1)
-                {
-                    int minutes_to_next_hour = 60 - local_tm->tm_min;
-                    seconds_to_wait = minutes_to_next_hour * 60 + 60;
-                }
-                sleepAndCheckRunning(seconds_to_wait);
-            }
-            else
+void CaptureThread::finishObjectCapture(FetchPool &pool, std::shared_ptr<ObjectCapture> capture, std::vector<int> failed_tiles)
+{
+    if (!completeObjectCapture(pool, capture, std::move(failed_tiles)))
+        return;
+
+    std::unique_lock<std::mutex> lock(m_in_flight_mutex);
+    if (capture->object_index < m_in_flight.size())
+        m_in_flight[capture->object_index] = 0;
+#ifdef SCREEN_TRACING
+    // Цикл — от запуска захватов до завершения последнего из них: тогда видно их наложение.
+    // Файл пишет поток захвата перед следующим слотом, а не поток загрузки
+    if (!m_one_shot && std::find(m_in_flight.begin(), m_in_flight.end(), 1) == m_in_flight.end())
+        m_trace_cycle_done = true;
+#endif
+}
+
+bool CaptureThread::completeObjectCapture(FetchPool &pool, const std::shared_ptr<ObjectCapture> &capture, std::vector<int> failed_tiles)
+{
+    const MapObject &mapObject = *capture->object;
+    TRACE_SPAN_DETAIL("finish_object", mapObject.name.c_str());
+
+    // Каталог сверяется только после того, как все записи плиток дошли до диска
+    {
+        TRACE_SPAN("wait_io");
+        m_io->waitFor(capture->last_io_seq);
+    }
+
+    // Повторно запрашиваются только недостающие плитки, пока не истек срок объекта
+    if (running && capture->refetch_pass < kMaxRefetchPasses)
+    {
+        if (m_clock->now() >= capture->deadline)
+        {
+            if (!failed_tiles.empty())
+                logWarning("refetch_deadline", "Срок захвата истек, плитки не будут запрошены повторно object=%s tiles=%zu", mapObject.name.c_str(), failed_tiles.size());
+        }
+        else
+        {
+            // Сверка с каталогом: плитка могла не сохраниться и без ошибки CURL (в том числе при фоновой записи)
+            std::vector<int> missing = collectMissingTiles(capture->temp_dir, static_cast<int>(capture->coords.size()));
+            if (!missing.empty())
             {
-                sleepAndCheckRunning(60);
+                ++capture->refetch_pass;
+                capture->metrics->retries.fetch_add(missing.size(), std::memory_order_relaxed);
+                logInfo("refetch", "Повторный запрос плиток object=%s tiles=%zu pass=%d", mapObject.name.c_str(), missing.size(), capture->refetch_pass);
+                submitObjectTiles(pool, capture, std::move(missing));
+                return false;
             }
         }
-    } // <-- Закрывающая скобка для CaptureThread::run()
-    // Здесь должен быть конец CaptureThread::run(),
-    // а остальные методы должны быть ниже, вне этой функции.
+    }
+
+    if (running)
+    {
+        const int64_t capture_ms = m_clock->unixMs();
+        std::tm current_time_tm{};
+        localTimeSafe(static_cast<std::time_t>(capture_ms / 1000), current_time_tm);
+        QJsonObject capture_metadata;
+        capture_metadata["tile_px"] = capture->tile_px;
+        // Географическая раскладка сетки: по ней выделяется область интереса без декодирования композита
+        capture_metadata["grid_origin_lat"] = capture->coords.front().first;
+        capture_metadata["grid_origin_lon"] = capture->coords.front().second;
+        capture_metadata["grid_step_lat_deg"] = kGridStepLatDeg;
+        capture_metadata["grid_step_lon_deg"] = kGridStepLonDeg;
+        capture_metadata["tile_span_deg"] = kTileSpanDeg;
+        capture_metadata["skipped_rings"] = capture->skipped_rings;
+        capture_metadata["resumed_tiles"] = static_cast<qint64>(capture->resumed_tiles);
+        QJsonArray degradations;
+        for (const std::string &d : capture->degradations)
+            degradations.append(QString::fromStdString(d));
+        capture_metadata["degradations"] = degradations;
+
+        // Время каждой плитки и разброс по захвату: для сравнения загруженности
+        // важно, насколько плитки одного снимка разнесены во времени
+        QJsonArray tiles;
+        int64_t first_start = 0;
+        int64_t last_start = 0;
+        int64_t last_end = 0;
+        for (const TileTiming &timing : capture->tile_timings)
+        {
+            if (timing.start_unix_ms == 0)
+                continue;
+            QJsonObject tile;
+            tile["index"] = timing.index;
+            tile["start_ms"] = static_cast<qint64>(timing.start_unix_ms);
+            tile["end_ms"] = static_cast<qint64>(timing.end_unix_ms);
+            tile["ok"] = timing.ok;
+            tiles.append(tile);
+            if (first_start == 0 || timing.start_unix_ms < first_start)
+                first_start = timing.start_unix_ms;
+            last_start = std::max(last_start, timing.start_unix_ms);
+            last_end = std::max(last_end, timing.end_unix_ms);
+        }
+        capture_metadata["burst"] = mapObject.burst_capture;
+        capture_metadata["tiles"] = tiles;
+        capture_metadata["start_skew_ms"] = static_cast<qint64>(last_start - first_start);
+        capture_metadata["span_ms"] = static_cast<qint64>(last_end - first_start);
+        const std::vector<int> missing = collectMissingTiles(capture->temp_dir, static_cast<int>(capture->coords.size()));
+        bool combined = false;
+        bool saved = false;
+        // Дальше захват только завершается: после сбоя во время сборки он начнется заново,
+        // а не соберет повторный композит из тех же плиток
+        if (capture->journal)
+            capture->journal->discard();
+        if (mapObject.lazy_composite)
+        {
+            // Композит будет собран из пакета, только если его запросят
+            saved = bundleAndCleanupScreenshots(capture->temp_dir, mapObject.save_directory, &current_time_tm, mapObject.name, capture->grid_dim, capture_metadata, m_io.get());
+        }
+        else
+        {
+            combined = combineAndCleanupScreenshots(capture->temp_dir, mapObject.save_directory, &current_time_tm, mapObject.name, capture->grid_dim, nullptr, capture_metadata, m_io.get());
+            saved = combined;
+        }
+        recordObjectResult(saved && missing.empty(), missing.size());
+        if (m_observer)
+            m_observer(capture->object_index, capture_ms, missing.size(), saved);
+        ProgressEvent done;
+        done.kind = ProgressEvent::ObjectDone;
+        done.object_index = static_cast<uint32_t>(capture->object_index);
+        done.value = static_cast<uint32_t>(missing.size());
+        done.ok = saved;
+        reportProgress(done);
+        if (combined && capture->object_index < m_archives.size() && m_archives[capture->object_index])
+        {
+            archiveComposite(*m_archives[capture->object_index], compositeBasePath(mapObject.save_directory, mapObject.name, &current_time_tm), capture_ms);
+        }
+    }
+    else
+    {
+        if (capture->journal)
+        {
+            // Плитки и журнал остаются: при следующем запуске захват продолжится, пока не истек его срок
+            logWarning("capture_interrupted", "Захват прерван остановкой, плитки сохранены для продолжения object=%s", mapObject.name.c_str());
+        }
+        else
+        {
+            logWarning("capture_interrupted", "Захват прерван остановкой, временные файлы удаляются object=%s", mapObject.name.c_str());
+            m_io->removeAll(capture->temp_dir);
+        }
+        recordObjectResult(false, 0);
+        ProgressEvent done;
+        done.kind = ProgressEvent::ObjectDone;
+        done.object_index = static_cast<uint32_t>(capture->object_index);
+        done.value = static_cast<uint32_t>(capture->coords.size());
+        reportProgress(done);
+    }
+    return true;
 }
 
-// Реализации методов класса CaptureThread должны идти здесь:
-void CaptureThread::sleepAndCheckRunning(int seconds) // Убедитесь, что здесь есть "CaptureThread::"
+// Композит и его метаданные переносятся из отдельных файлов в архив объекта.
+// Файлы удаляются только после успешного добавления обеих записей.
+void CaptureThread::archiveComposite(CaptureArchive &archive, const std::string &composite_base_path, int64_t timestamp_ms)
 {
-    for (int i = 0; i < seconds * 10 && running; ++i)
+    TRACE_SPAN("archive");
+    const std::string composite_path = composite_base_path + ".bmp";
+    const std::string metadata_path = composite_path + ".json";
+
+    QFile composite(QString::fromStdString(composite_path));
+    if (!composite.open(QIODevice::ReadOnly))
+    {
+        logError("archive_open_failed", "Ошибка открытия композита для архива file=%s", composite_path.c_str());
+        return;
+    }
+    // Композит копируется в сегмент из отображения файла, без промежуточного буфера
+    const qint64 composite_size = composite.size();
+    uchar *composite_data = composite_size > 0 ? composite.map(0, composite_size) : nullptr;
+    if (!composite_data ||
+        !archive.append(timestamp_ms, ArchiveEntryKind::Composite, -1, reinterpret_cast<const char *>(composite_data), static_cast<size_t>(composite_size)))
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        logError("archive_append_failed", "Ошибка добавления композита в архив dir=%s", archive.directory().c_str());
+        return;
+    }
+    composite.close();
+
+    QFile metadata(QString::fromStdString(metadata_path));
+    if (metadata.open(QIODevice::ReadOnly))
+    {
+        if (!archive.append(timestamp_ms, ArchiveEntryKind::Metadata, -1, metadata.readAll()))
+        {
+            logError("archive_append_failed", "Ошибка добавления метаданных в архив dir=%s", archive.directory().c_str());
+            return;
+        }
+        metadata.close();
+        m_io->removeAll(metadata_path);
     }
+    m_io->removeAll(composite_path);
+    logInfo("archive_appended", "Композит добавлен в архив dir=%s time_ms=%lld", archive.directory().c_str(), static_cast<long long>(timestamp_ms));
 }
 
-bool CaptureThread::isWithinCaptureTimeWindow(const std::tm *current_time_tm) // Убедитесь, что здесь есть "CaptureThread::"
+// Реализации методов класса CaptureThread должны идти здесь:
+bool CaptureThread::isWithinCaptureTimeWindow(const std::tm *current_time_tm, const std::string &start_time_str, const std::string &end_time_str) // Убедитесь, что здесь есть "CaptureThread::"
 {
     if (!current_time_tm)
         return false;
-    size_t start_colon = m_start_time_str.find(':');
-    size_t end_colon = m_end_time_str.find(':');
-    if (start_colon == std::string::npos || end_colon == std::string::npos || m_start_time_str.length() < 4 || m_end_time_str.length() < 4)
+    size_t start_colon = start_time_str.find(':');
+    size_t end_colon = end_time_str.find(':');
+    if (start_colon == std::string::npos || end_colon == std::string::npos || start_time_str.length() < 4 || end_time_str.length() < 4)
     {
-        std::cerr << "Неверный формат времени в настройках. Используйте hh:mm." << std::endl;
+        logError("time_window_format", "Неверный формат времени в настройках, нужен hh:mm start=%s end=%s", start_time_str.c_str(), end_time_str.c_str());
         return false;
     }
     try
     {
-        int start_hour = std::stoi(m_start_time_str.substr(0, start_colon));
-        int start_minute = std::stoi(m_start_time_str.substr(start_colon + 1));
-        int end_hour = std::stoi(m_end_time_str.substr(0, end_colon));
-        int end_minute = std::stoi(m_end_time_str.substr(end_colon + 1));
+        int start_hour = std::stoi(start_time_str.substr(0, start_colon));
+        int start_minute = std::stoi(start_time_str.substr(start_colon + 1));
+        int end_hour = std::stoi(end_time_str.substr(0, end_colon));
+        int end_minute = std::stoi(end_time_str.substr(end_colon + 1));
         if (start_hour < 0 || start_hour > 23 || start_minute < 0 || start_minute > 59 ||
             end_hour < 0 || end_hour > 23 || end_minute < 0 || end_minute > 59)
         {
-            std::cerr << "Неверное значение часа или минуты в диапазоне времени." << std::endl;
+            logError("time_window_range", "Неверное значение часа или минуты start=%s end=%s", start_time_str.c_str(), end_time_str.c_str());
             return false;
         }
         int current_total_minutes = current_time_tm->tm_hour * 60 + current_time_tm->tm_min;
@@ -334,12 +1384,38 @@ bool CaptureThread::isWithinCaptureTimeWindow(const std::tm *current_time_tm) //
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Ошибка парсинга времени: " << e.what() << std::endl;
+        logError("time_window_parse", "Ошибка парсинга времени: %s", e.what());
         return false;
     }
     return false;
 }
 
+int CaptureThread::secondsUntilWindowStart(const std::tm *current_time_tm, const std::string &start_time_str)
+{
+    if (!current_time_tm)
+        return -1;
+    size_t start_colon = start_time_str.find(':');
+    if (start_colon == std::string::npos)
+        return -1;
+    try
+    {
+        int start_hour = std::stoi(start_time_str.substr(0, start_colon));
+        int start_minute = std::stoi(start_time_str.substr(start_colon + 1));
+        if (start_hour < 0 || start_hour > 23 || start_minute < 0 || start_minute > 59)
+            return -1;
+        int current_sec = current_time_tm->tm_hour * 3600 + current_time_tm->tm_min * 60 + current_time_tm->tm_sec;
+        int start_sec = start_hour * 3600 + start_minute * 60;
+        int wait_sec = start_sec - current_sec;
+        if (wait_sec <= 0)
+            wait_sec += 24 * 3600;
+        return wait_sec;
+    }
+    catch (const std::exception &)
+    {
+        return -1;
+    }
+}
+
 void CaptureThread::generateCoordinatesForObject(const MapObject &obj, std::vector<std::pair<double, double>> &out_coords) // Убедитесь, что здесь есть "CaptureThread::"
 {
     out_coords.clear();
@@ -347,8 +1423,8 @@ void CaptureThread::generateCoordinatesForObject(const MapObject &obj, std::vect
     double lon0 = obj.longitude_center;
     double r_km = static_cast<double>(obj.radius_km);
     const double deg_per_km_at_equator = 0.01;
-    const double step_deg_y = 0.0137;
-    const double step_deg_x = 0.0193;
+    const double step_deg_y = kGridStepLatDeg;
+    const double step_deg_x = kGridStepLonDeg;
     double span_from_center_lat_deg = r_km * deg_per_km_at_equator;
     double cos_lat0 = std::cos(lat0 * M_PI / 180.0);
     if (std::abs(cos_lat0) < std::numeric_limits<double>::epsilon())
@@ -363,8 +1439,7 @@ void CaptureThread::generateCoordinatesForObject(const MapObject &obj, std::vect
         N_grid = 1;
     double start_lat = lat0 - (N_grid - 1) / 2.0 * step_deg_y - step_deg_y / 2.0;
     double start_lon = lon0 - (N_grid - 1) / 2.0 * step_deg_x - step_deg_x / 2.0;
-    std::cout << "Для объекта '" << obj.name << "': Центр(" << lat0 << ", " << lon0 << "), R=" << r_km
-              << "км. Сетка " << N_grid << "x" << N_grid << "." << std::endl;
+    logDebug("object_grid", "Сетка объекта object=%s lat=%.6f lon=%.6f radius_km=%g grid=%d", obj.name.c_str(), lat0, lon0, r_km, N_grid);
     for (int yy = 0; yy < N_grid; ++yy)
     {
         for (int xx = 0; xx < N_grid; ++xx)
@@ -376,74 +1451,68 @@ void CaptureThread::generateCoordinatesForObject(const MapObject &obj, std::vect
     }
 }
 
-void CaptureThread::createSnapshot(std::pair<double, double> bottom_left_coord, const std::string &directory, const std::string &format, int index, std::tm *current_time_tm) // Убедитесь, что здесь есть "CaptureThread::"
+bool CaptureThread::createSnapshot(std::pair<double, double> bottom_left_coord, const std::string &directory, const std::string &format, int index, std::tm *current_time_tm, int tile_px, uint64_t *io_seq, TileTiming *timing, const std::shared_ptr<TileJournal> &journal) // Убедитесь, что здесь есть "CaptureThread::"
 {
     if (!running)
-        return;
-    char filename_time_buffer[80];
-    std::strftime(filename_time_buffer, sizeof(filename_time_buffer), format.c_str(), current_time_tm);
-    std::string file_name = directory + "/" + filename_time_buffer + "_" + std::to_string(index) + ".png";
-    if (!std::filesystem::exists(directory))
-    {
-        std::cerr << "Целевой каталог для снимка не существует: " << directory << ". Пропускаем снимок." << std::endl;
-        return;
-    }
-    double lat_bottom = bottom_left_coord.first;
-    double lon_left = bottom_left_coord.second;
-    const double tile_height_deg = 0.01;
-    const double tile_width_deg = 0.01;
-    double lon_right = lon_left + tile_width_deg;
-    double lat_top = lat_bottom + tile_height_deg;
-    std::ostringstream oss_api_url;
-    oss_api_url.imbue(std::locale("C"));
-    oss_api_url << "https://static-maps.yandex.ru/1.x/?bbox="
-                << lon_left << "," << lat_bottom << "~" << lon_right << "," << lat_top
-                << "&size=450,450&l=map,trf";
-    std::string api_url = oss_api_url.str();
+        return false;
+    std::string file_name = tileFileName(directory, format, index, current_time_tm);
+    std::string api_url = buildTileUrl(m_tile_server_url, bottom_left_coord, tile_px);
+    bool saved = false;
     CURL *curl = curl_easy_init();
     if (curl)
     {
-        FILE *file = fopen(file_name.c_str(), "wb");
-        if (file)
-        {
-            curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-            curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
-            CURLcode res = curl_easy_perform(curl);
-            long http_code = 0;
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-            fclose(file);
-            if (res == CURLE_OK && http_code >= 200 && http_code < 300)
+        // Ответ собирается в память и отдается IoStage: поток загрузки не ждет диска
+        std::string body;
+        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, appendToString);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+        if (m_fetch_budget.perFetchBytesPerSec() > 0)
+        {
+            // Доля общей полосы пула на один одновременный запрос
+            curl_easy_setopt(curl, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(m_fetch_budget.perFetchBytesPerSec()));
+        }
+        CURLcode res = curl_easy_perform(curl);
+        long http_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        if (timing)
+        {
+            timing->http_code = http_code;
+            readCurlPhaseTimes(curl, *timing);
+            if (m_recorder)
             {
-                std::ifstream ifs(file_name, std::ios::binary | std::ios::ate);
-                if (!ifs.is_open() || ifs.tellg() == 0)
-                {
-                    std::cerr << "Ошибка: Загруженный файл пуст или не удалось проверить: " << file_name << std::endl;
-                    std::filesystem::remove(file_name);
-                }
-                else
-                {
-                    std::cout << "Снимок сохранен: " << file_name << std::endl; // Слишком много логов
-                    // QString info = QString("Снимок сохранен: %1")
-                    //                    .arg(QString::fromStdString(file_name));
-
-                    // updateStatistics(info);
-                }
+                TileTiming recorded = *timing;
+                recorded.end_unix_ms = unixTimeMs();
+                m_recorder->record(api_url, recorded, res == CURLE_OK ? body : std::string());
+            }
+        }
+        if (res == CURLE_OK && http_code >= 200 && http_code < 300)
+        {
+            if (body.empty())
+            {
+                logWarning("tile_empty", "Загруженный файл пуст file=%s", file_name.c_str());
             }
             else
             {
-                std::cerr << "Ошибка CURL (код: " << res << ", HTTP: " << http_code << ") для URL " << api_url << ": " << curl_easy_strerror(res) << std::endl;
-                std::filesystem::remove(file_name);
+                m_fetched_bytes += body.size();
+                if (timing)
+                    timing->bytes = static_cast<uint32_t>(body.size());
+                uint64_t seq = writeTileFile(journal, index, file_name, std::move(body));
+                if (io_seq)
+                    *io_seq = seq;
+                saved = true;
+                logDebug("tile_saved", "Снимок получен file=%s", file_name.c_str());
             }
         }
         else
         {
-            std::cerr << "Ошибка открытия файла для записи: " << file_name << " (errno: " << errno << ")" << std::endl;
+            logWarning("tile_fetch_failed", "Ошибка CURL code=%d http=%ld url=%s: %s", static_cast<int>(res), http_code, api_url.c_str(), curl_easy_strerror(res));
         }
         curl_easy_cleanup(curl);
     }
     else
     {
-        std::cerr << "Ошибка инициализации CURL." << std::endl;
+        logError("curl_init_failed", "Ошибка инициализации CURL");
     }
+    return saved;
 }
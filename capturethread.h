@@ -2,6 +2,7 @@
 #define CAPTURETHREAD_H
 
 #include <QThread>
+#include <QJsonObject>
 #include <string>
 #include <vector>
 #include <utility> // для std::pair
@@ -20,18 +21,134 @@
 #include <thread>   // Для std::this_thread::sleep_for
 #include <fstream>  // Для std::ifstream
 
+#include <chrono>   // Для std::chrono::steady_clock
+#include <functional> // Для std::function
+#include <map>      // Для std::map
+#include <memory>   // Для std::shared_ptr
+#include <mutex>    // Для std::mutex
+
 #include <curl/curl.h> // для CURL
 #include "MapObject.h"
+#include "fetchpool.h"
+#include "capturescheduler.h"
+#include "captureclock.h"
+#include "burstfetch.h"
+#include "metrics.h"
+#include "iostage.h"
+#include "capturearchive.h"
+#include "progresschannel.h"
+#include "tilesession.h"
+#include "tilejournal.h"
 
 // Forward declaration для MapObject, если MapObject не выносится в отдельный файл
 // Если MapObject вынесен, включите его заголовочный файл
 class MapObject;
 
-// Вспомогательная функция для объединения изображений
+// Вспомогательная функция для объединения изображений.
+// Плитки размещаются по индексу ячейки сетки grid_dim x grid_dim; ячейки без плитки
+// помечаются цветом и возвращаются в unfilled_cells (если передан).
+// Если передан io, временный каталог удаляется в фоне через него.
 bool combineAndCleanupScreenshots(const std::string &temp_dir_path,
                                   const std::string &output_dir_path,
                                   std::tm *current_time,
-                                  const std::string &object_name_identifier);
+                                  const std::string &object_name_identifier,
+                                  int grid_dim,
+                                  std::vector<int> *unfilled_cells = nullptr,
+                                  const QJsonObject &capture_metadata = QJsonObject(),
+                                  IoStage *io = nullptr);
+
+// Вместо композита упаковывает плитки в <объект>_<время>.tiles (tilebundle.h)
+// с метаданными в <объект>_<время>.tiles.json; композит собирается по запросу
+bool bundleAndCleanupScreenshots(const std::string &temp_dir_path,
+                                 const std::string &output_dir_path,
+                                 std::tm *current_time,
+                                 const std::string &object_name_identifier,
+                                 int grid_dim,
+                                 const QJsonObject &capture_metadata = QJsonObject(),
+                                 IoStage *io = nullptr);
+
+// Индексы ячеек, для которых во временном каталоге нет непустого файла плитки
+std::vector<int> collectMissingTiles(const std::string &temp_dir_path, int total_tiles);
+
+// Адрес сервиса плиток, если другой не задан (CaptureThread::setTileServerUrl)
+extern const char *const kDefaultTileServerUrl;
+
+// URL плитки сервиса server_url с нижним левым углом bottom_left_coord (широта, долгота)
+std::string buildTileUrl(const std::string &server_url, std::pair<double, double> bottom_left_coord, int tile_px);
+
+// Путь файла плитки: <directory>/<format по времени>_<index>.png
+std::string tileFileName(const std::string &directory, const std::string &format, int index, const std::tm *current_time_tm);
+
+// Индексы ячеек сетки grid_dim x grid_dim в порядке спирали от центра наружу
+std::vector<int> spiralTileOrder(int grid_dim);
+
+// Уменьшенный в scale_divisor раз композит центральной области core_dim x core_dim,
+// сохраняется как <объект>_<время>_core.png
+bool writeProgressiveComposite(const std::string &temp_dir_path,
+                               const std::string &output_dir_path,
+                               const std::tm *current_time,
+                               const std::string &object_name_identifier,
+                               int grid_dim,
+                               int core_dim,
+                               int scale_divisor);
+
+// Состояние захвата одного объекта в текущем цикле
+struct ObjectCapture
+{
+    const MapObject *object = nullptr;
+    std::vector<std::pair<double, double>> coords;
+    std::string temp_dir;
+    size_t object_index = 0;
+    int grid_dim = 0;
+    int refetch_pass = 0;
+    std::chrono::steady_clock::time_point deadline;
+
+    // Деградация, выбранная для укладки в интервал
+    int tile_px = 450;                     // Сторона запрашиваемой плитки в пикселях
+    int skipped_rings = 0;                 // Сколько внешних колец сетки отброшено
+    std::vector<std::string> degradations; // Что именно было упрощено, для журнала и метаданных
+
+    // Порядок загрузки по спирали от центра и готовность центральной области
+    std::vector<int> spiral_rank;          // Позиция ячейки в спирали
+    int core_dim = 0;                      // Сторона центральной области, 0 — без предварительного композита
+    std::atomic_int core_remaining{0};     // Сколько плиток центра еще не получено
+
+    std::vector<TileTiming> tile_timings;  // Время запроса каждой плитки, по индексу ячейки
+    StageMetrics *metrics = nullptr;       // Гистограммы этапов и счетчики объекта
+    std::shared_ptr<TileJournal> journal;  // Журнал полученных плиток для продолжения после сбоя
+    std::vector<char> resumed;             // Плитки, взятые из прерванного захвата по журналу
+    size_t resumed_tiles = 0;
+    std::atomic<uint64_t> last_io_seq{0};  // Последняя операция IoStage с файлами захвата
+
+    void noteIo(uint64_t seq)
+    {
+        uint64_t prev = last_io_seq.load();
+        while (prev < seq && !last_io_seq.compare_exchange_weak(prev, seq))
+        {
+        }
+    }
+};
+
+// Итоги разового прохода (CaptureThread::setOneShot) для отчета о пропускной способности
+struct CaptureRunStats
+{
+    size_t objects = 0;             // Объектов в проходе
+    size_t objects_incomplete = 0;  // Объекты с недостающими плитками или без сохраненного результата
+    size_t tile_requests_ok = 0;    // Успешных запросов плиток, включая повторные
+    size_t tile_requests_failed = 0;
+    size_t tiles_missing = 0;       // Плиток, так и не полученных к концу прохода
+    uint64_t bytes = 0;             // Получено байт тел ответов
+    double elapsed_sec = 0.0;
+    std::vector<int64_t> tile_latency_ms; // Длительность каждого запроса плитки
+};
+
+// Вызывается по завершении захвата объекта (из потока завершения пула загрузки):
+// индекс объекта в списке потока, время захвата, сколько плиток не получено, сохранен ли результат
+using CaptureObserver = std::function<void(size_t object_index, int64_t capture_ms, size_t missing_tiles, bool saved)>;
+
+// Вызывается из потока захвата, когда расписание открывает слот объекта (в окне съемки):
+// индекс объекта и время слота по часам потока
+using SlotObserver = std::function<void(size_t object_index, int64_t slot_unix_ms)>;
 
 class CaptureThread : public QThread
 {
@@ -42,10 +159,42 @@ public:
                   int interval,
                   std::string st_time,
                   std::string en_time,
+                  FetchBudget budget = FetchBudget(),
                   QObject *parent = nullptr);
 
     void stop(); // Метод для запроса остановки потока
 
+    // Разовый проход: все объекты сразу, без окна времени, интервала и упрощения захвата;
+    // поток завершается, когда обработан последний объект. Задается до start().
+    void setOneShot(bool one_shot) { m_one_shot = one_shot; }
+    // Итоги прохода; читать после завершения потока
+    CaptureRunStats runStats() const;
+
+    // Задается до start()
+    void setCaptureObserver(CaptureObserver observer) { m_observer = std::move(observer); }
+    // События хода захвата для окна; запись в канал никогда не блокирует загрузку. Задается до start().
+    void setProgressChannel(std::shared_ptr<ProgressChannel> channel) { m_progress = std::move(channel); }
+    // Записывать запросы плиток с ответами и временем этапов (tilesession.h). Задается до start().
+    void setSessionRecorder(std::shared_ptr<TileSessionRecorder> recorder) { m_recorder = std::move(recorder); }
+
+    // Часы расписания (по умолчанию настоящие); SimulatedClock прогоняет сутки без ожидания.
+    // Задается до start().
+    void setClock(std::shared_ptr<CaptureClock> clock) { m_clock = std::move(clock); }
+    // Только расписание: слоты сообщаются SlotObserver, плитки не загружаются. Задается до start().
+    void setScheduleOnly(bool schedule_only) { m_schedule_only = schedule_only; }
+    void setSlotObserver(SlotObserver observer) { m_slot_observer = std::move(observer); }
+    // Другой адрес сервиса плиток (зеркало, локальная замена для нагрузочного прогона);
+    // пустая строка — адрес по умолчанию. Задается до start().
+    void setTileServerUrl(const std::string &url) { m_tile_server_url = url.empty() ? kDefaultTileServerUrl : url; }
+    // Время последнего захвата объектов по имени (unix мс), например из прежнего потока:
+    // первый срок таких объектов — через их интервал после этого времени, а не сразу.
+    // Задается до start().
+    void setLastCaptureTimes(std::map<std::string, int64_t> last_unix_ms) { m_last_capture_ms = std::move(last_unix_ms); }
+
+    // Нижние левые углы плиток сетки объекта (широта, долгота), построчно снизу вверх.
+    // Не зависит от состояния потока (используется и в screenbench).
+    static void generateCoordinatesForObject(const MapObject &obj, std::vector<std::pair<double, double>> &out_coords);
+
 protected:
     void run() override; // Основная функция потока
 
@@ -54,12 +203,54 @@ private:
     int m_capture_interval_sec;
     std::string m_start_time_str;
     std::string m_end_time_str;
+    FetchBudget m_fetch_budget; // Общий бюджет загрузки для всех объектов
     std::atomic_bool running; // Атомарная переменная для безопасной остановки
 
-    void sleepAndCheckRunning(int seconds);
-    bool isWithinCaptureTimeWindow(const std::tm *current_time_tm);
-    void generateCoordinatesForObject(const MapObject &obj, std::vector<std::pair<double, double>> &out_coords);
-    void createSnapshot(std::pair<double, double> bottom_left_coord, const std::string &directory, const std::string &format, int index, std::tm *current_time_tm);
+    CaptureScheduler m_scheduler;      // Сроки следующего захвата каждого объекта
+    std::mutex m_in_flight_mutex;
+    std::vector<char> m_in_flight;     // Объекты, захват которых еще идет
+    std::atomic_bool m_trace_cycle_done{false}; // Все захваты цикла завершены, файл трассировки еще не записан
+    std::unique_ptr<IoStage> m_io;     // Фоновая запись плиток и очистка каталогов
+    std::vector<std::unique_ptr<CaptureArchive>> m_archives; // Архив объекта, если он включен
+
+    bool m_one_shot = false;
+    bool m_schedule_only = false;
+    std::string m_tile_server_url = kDefaultTileServerUrl; // Читается потоками загрузки, после start() не меняется
+    std::shared_ptr<CaptureClock> m_clock = systemCaptureClock();
+    std::map<std::string, int64_t> m_last_capture_ms;
+    CaptureObserver m_observer;
+    SlotObserver m_slot_observer;
+    std::shared_ptr<ProgressChannel> m_progress;
+    std::shared_ptr<TileSessionRecorder> m_recorder;
+    mutable std::mutex m_stats_mutex;
+    CaptureRunStats m_stats;
+    std::atomic<uint64_t> m_fetched_bytes{0};
+
+    int intervalFor(const MapObject &obj) const;
+    const std::string &startTimeFor(const MapObject &obj) const;
+    const std::string &endTimeFor(const MapObject &obj) const;
+    int firstCaptureDelaySec(const MapObject &obj, const std::tm &now_tm) const;
+    bool isWithinCaptureTimeWindow(const std::tm *current_time_tm, const std::string &start_time_str, const std::string &end_time_str);
+    int secondsUntilWindowStart(const std::tm *current_time_tm, const std::string &start_time_str);
+    bool planDegradation(ObjectCapture &capture, const FetchPool &pool, double available_sec);
+    void prepareTileOrder(ObjectCapture &capture);
+    void openTileJournal(ObjectCapture &capture);
+    void expireStaleCaptures();
+    void startObjectCapture(FetchPool &pool, std::shared_ptr<ObjectCapture> capture);
+    uint64_t writeTileFile(const std::shared_ptr<TileJournal> &journal, int index, std::string path, std::string body);
+    void reportProgress(const ProgressEvent &event);
+    void reportTile(const ObjectCapture &capture, const TileTiming &timing);
+    void runOnce(FetchPool &pool);
+    void recordTileRequest(const TileTiming &timing);
+    void recordObjectResult(bool complete, size_t missing_tiles);
+    std::shared_ptr<ObjectCapture> prepareObjectCapture(const MapObject &obj);
+    void submitObjectTiles(FetchPool &pool, std::shared_ptr<ObjectCapture> capture, std::vector<int> tiles);
+    void submitBurstCapture(FetchPool &pool, std::shared_ptr<ObjectCapture> capture);
+    void finishObjectCapture(FetchPool &pool, std::shared_ptr<ObjectCapture> capture, std::vector<int> failed_tiles);
+    // false, если недостающие плитки запрошены повторно и захват еще идет
+    bool completeObjectCapture(FetchPool &pool, const std::shared_ptr<ObjectCapture> &capture, std::vector<int> failed_tiles);
+    void archiveComposite(CaptureArchive &archive, const std::string &composite_base_path, int64_t timestamp_ms);
+    bool createSnapshot(std::pair<double, double> bottom_left_coord, const std::string &directory, const std::string &format, int index, std::tm *current_time_tm, int tile_px = 450, uint64_t *io_seq = nullptr, TileTiming *timing = nullptr, const std::shared_ptr<TileJournal> &journal = nullptr);
 };
 
 #endif // CAPTURETHREAD_H
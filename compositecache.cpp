@@ -0,0 +1,146 @@
+#include "compositecache.h"
+#include "metrics.h"
+#include "tilebundle.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <iostream>
+
+CompositeCache::CompositeCache(std::string cache_directory, int64_t max_bytes)
+    : m_directory(std::move(cache_directory)), m_max_bytes(max_bytes)
+{
+    QDir dir(QString::fromStdString(m_directory));
+    if (!dir.exists())
+        return;
+    // Начиная со старых: каждый следующий встает в голову списка
+    const QFileInfoList files = dir.entryInfoList(QStringList() << "*.bmp", QDir::Files, QDir::Time | QDir::Reversed);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const QFileInfo &info : files)
+    {
+        Item item;
+        item.key = info.completeBaseName().toStdString();
+        item.path = info.absoluteFilePath().toStdString();
+        item.bytes = info.size();
+        insertLocked(std::move(item));
+    }
+    evictLocked();
+}
+
+int64_t CompositeCache::cachedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+}
+
+std::string CompositeCache::composite(const std::string &bundle_path)
+{
+    const QFileInfo bundle_info(QString::fromStdString(bundle_path));
+    const std::string key = bundle_info.completeBaseName().toStdString();
+
+    // Попадание: композит есть и не старше пакета
+    auto lookup = [&]() -> std::string
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_items.find(key);
+        if (found == m_items.end())
+            return std::string();
+        const QFileInfo cached(QString::fromStdString(found->second->path));
+        if (!cached.exists() || cached.lastModified() < bundle_info.lastModified())
+        {
+            m_bytes -= found->second->bytes;
+            m_lru.erase(found->second);
+            m_items.erase(found);
+            return std::string();
+        }
+        m_lru.splice(m_lru.begin(), m_lru, found->second);
+        // Время изменения — порядок LRU для следующих запусков
+        QFile touched(QString::fromStdString(m_lru.front().path));
+        if (touched.open(QIODevice::ReadWrite))
+            touched.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+        return m_lru.front().path;
+    };
+
+    StageMetrics &metrics = processMetrics();
+    std::string path = lookup();
+    if (!path.empty())
+    {
+        metrics.cache_hits.fetch_add(1, std::memory_order_relaxed);
+        return path;
+    }
+
+    std::lock_guard<std::mutex> build_lock(m_build_mutex);
+    path = lookup(); // Мог быть собран другим потоком, пока ждали
+    if (!path.empty())
+    {
+        metrics.cache_hits.fetch_add(1, std::memory_order_relaxed);
+        return path;
+    }
+    metrics.cache_misses.fetch_add(1, std::memory_order_relaxed);
+
+    TileBundle bundle;
+    if (!bundle.open(bundle_path))
+        return std::string();
+    if (!QDir().mkpath(QString::fromStdString(m_directory)))
+    {
+        std::cerr << "Ошибка создания каталога кэша композитов: " << m_directory << std::endl;
+        return std::string();
+    }
+
+    // Сборка во временный файл: недостроенный композит не должен попасть в кэш
+    const QString final_path = QDir(QString::fromStdString(m_directory)).absoluteFilePath(QString::fromStdString(key) + ".bmp");
+    const QString part_path = final_path + ".part";
+    if (!renderBundleComposite(bundle, part_path.toStdString(), &metrics))
+    {
+        QFile::remove(part_path);
+        std::cerr << "Ошибка сборки композита из пакета: " << bundle_path << std::endl;
+        return std::string();
+    }
+    QFile::remove(final_path);
+    if (!QFile::rename(part_path, final_path))
+    {
+        QFile::remove(part_path);
+        std::cerr << "Ошибка сохранения композита в кэш: " << final_path.toStdString() << std::endl;
+        return std::string();
+    }
+    std::cout << "Композит собран по запросу: " << final_path.toStdString() << std::endl;
+
+    Item item;
+    item.key = key;
+    item.path = final_path.toStdString();
+    item.bytes = QFileInfo(final_path).size();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    insertLocked(item);
+    evictLocked();
+    return item.path;
+}
+
+void CompositeCache::insertLocked(Item item)
+{
+    auto existing = m_items.find(item.key);
+    if (existing != m_items.end())
+    {
+        m_bytes -= existing->second->bytes;
+        m_lru.erase(existing->second);
+        m_items.erase(existing);
+    }
+    m_bytes += item.bytes;
+    m_lru.push_front(std::move(item));
+    m_items[m_lru.front().key] = m_lru.begin();
+}
+
+void CompositeCache::evictLocked()
+{
+    // Последний запрошенный композит остается, даже если один превышает лимит
+    while (m_bytes > m_max_bytes && m_lru.size() > 1)
+    {
+        const Item &victim = m_lru.back();
+        if (!QFile::remove(QString::fromStdString(victim.path)) && QFile::exists(QString::fromStdString(victim.path)))
+            std::cerr << "Не удалось удалить композит из кэша: " << victim.path << std::endl;
+        m_bytes -= victim.bytes;
+        m_items.erase(victim.key);
+        m_lru.pop_back();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef COMPOSITECACHE_H
+#define COMPOSITECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Ограниченный кэш композитов, собранных из пакетов плиток по запросу.
+// Композиты лежат BMP-файлами в каталоге кэша; при превышении объема удаляются
+// давно не запрашивавшиеся. Содержимое каталога подхватывается при создании кэша
+// (порядок — по времени изменения файлов), поэтому кэш переживает перезапуск.
+class CompositeCache
+{
+public:
+    CompositeCache(std::string cache_directory, int64_t max_bytes);
+
+    // Путь к композиту для пакета плиток: из кэша или собранный сейчас.
+    // Пустая строка — пакет не читается или композит не удалось собрать.
+    std::string composite(const std::string &bundle_path);
+
+    int64_t cachedBytes() const;
+
+private:
+    struct Item
+    {
+        std::string key;
+        std::string path;
+        int64_t bytes = 0;
+    };
+
+    void insertLocked(Item item);
+    void evictLocked();
+
+    std::string m_directory;
+    int64_t m_max_bytes;
+    mutable std::mutex m_mutex;
+    std::mutex m_build_mutex; // Сборки выполняются по одной: тяжелая работа не должна множиться
+    std::list<Item> m_lru;    // Голова — последний запрошенный
+    std::unordered_map<std::string, std::list<Item>::iterator> m_items;
+    int64_t m_bytes = 0;
+};
+
+#endif // COMPOSITECACHE_H
@@ -0,0 +1,251 @@
+#include "compositewriter.h"
+#include "asynclog.h"
+#include "metrics.h"
+
+#include <QBuffer>
+#include <QColor>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const int kBmpFileHeaderSize = 14;
+    const int kBmpInfoHeaderSize = 40;
+    const int kBmpHeaderSize = kBmpFileHeaderSize + kBmpInfoHeaderSize;
+
+    void putLe16(uchar *dst, uint16_t v)
+    {
+        dst[0] = static_cast<uchar>(v & 0xff);
+        dst[1] = static_cast<uchar>((v >> 8) & 0xff);
+    }
+
+    void putLe32(uchar *dst, uint32_t v)
+    {
+        dst[0] = static_cast<uchar>(v & 0xff);
+        dst[1] = static_cast<uchar>((v >> 8) & 0xff);
+        dst[2] = static_cast<uchar>((v >> 16) & 0xff);
+        dst[3] = static_cast<uchar>((v >> 24) & 0xff);
+    }
+
+    // Смешивание с белым фоном, как это делал QPainter поверх заливки Qt::white
+    inline void writeBgr(uchar *dst, QRgb px)
+    {
+        int a = qAlpha(px);
+        if (a == 255)
+        {
+            dst[0] = static_cast<uchar>(qBlue(px));
+            dst[1] = static_cast<uchar>(qGreen(px));
+            dst[2] = static_cast<uchar>(qRed(px));
+            return;
+        }
+        int inv = 255 - a;
+        dst[0] = static_cast<uchar>((qBlue(px) * a + 255 * inv) / 255);
+        dst[1] = static_cast<uchar>((qGreen(px) * a + 255 * inv) / 255);
+        dst[2] = static_cast<uchar>((qRed(px) * a + 255 * inv) / 255);
+    }
+}
+
+MappedBmpWriter::~MappedBmpWriter()
+{
+    if (m_map)
+        close();
+}
+
+bool MappedBmpWriter::open(const std::string &path, int width, int height)
+{
+    if (m_map)
+        close();
+    if (width <= 0 || height <= 0)
+    {
+        logError("composite_bad_size", "Неверный размер композита %dx%d", width, height);
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_stride = (width * 3 + 3) & ~3;
+    const qint64 pixel_bytes = static_cast<qint64>(m_stride) * height;
+    const qint64 file_size = kBmpHeaderSize + pixel_bytes;
+    if (file_size > static_cast<qint64>(UINT32_MAX))
+    {
+        logError("composite_too_large", "Композит слишком велик для BMP size=%dx%d", width, height);
+        return false;
+    }
+
+    m_file.setFileName(QString::fromStdString(path));
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    {
+        logError("composite_open_failed", "Ошибка открытия выходного файла file=%s: %s", path.c_str(), m_file.errorString().toStdString().c_str());
+        return false;
+    }
+    // Файл сразу получает финальный размер, страницы выделяются ОС по мере записи
+    if (!m_file.resize(file_size))
+    {
+        logError("composite_resize_failed", "Ошибка выделения места под композит file=%s: %s", path.c_str(), m_file.errorString().toStdString().c_str());
+        discard();
+        return false;
+    }
+    m_map = m_file.map(0, file_size);
+    if (!m_map)
+    {
+        logError("composite_map_failed", "Ошибка отображения файла в память file=%s: %s", path.c_str(), m_file.errorString().toStdString().c_str());
+        discard();
+        return false;
+    }
+
+    // BITMAPFILEHEADER
+    m_map[0] = 'B';
+    m_map[1] = 'M';
+    putLe32(m_map + 2, static_cast<uint32_t>(file_size));
+    putLe32(m_map + 6, 0);
+    putLe32(m_map + 10, kBmpHeaderSize);
+    // BITMAPINFOHEADER: 24 бит без сжатия, строки снизу вверх
+    uchar *info = m_map + kBmpFileHeaderSize;
+    putLe32(info + 0, kBmpInfoHeaderSize);
+    putLe32(info + 4, static_cast<uint32_t>(width));
+    putLe32(info + 8, static_cast<uint32_t>(height));
+    putLe16(info + 12, 1);
+    putLe16(info + 14, 24);
+    putLe32(info + 16, 0);
+    putLe32(info + 20, static_cast<uint32_t>(pixel_bytes));
+    putLe32(info + 24, 2835); // 72 dpi
+    putLe32(info + 28, 2835);
+    putLe32(info + 32, 0);
+    putLe32(info + 36, 0);
+
+    m_pixels = m_map + kBmpHeaderSize;
+    return true;
+}
+
+uchar *MappedBmpWriter::scanLine(int y)
+{
+    // В BMP первой хранится нижняя строка
+    return m_pixels + static_cast<qint64>(m_height - 1 - y) * m_stride;
+}
+
+void MappedBmpWriter::blitTile(const QImage &tile, int x, int y)
+{
+    if (!m_map || tile.isNull())
+        return;
+
+    QImage converted;
+    const QImage *src = &tile;
+    const bool direct = tile.format() == QImage::Format_RGB32 ||
+                        tile.format() == QImage::Format_ARGB32 ||
+                        tile.format() == QImage::Format_Indexed8;
+    if (!direct)
+    {
+        converted = tile.convertToFormat(QImage::Format_ARGB32);
+        src = &converted;
+    }
+
+    const int x0 = std::max(0, x);
+    const int y0 = std::max(0, y);
+    const int x1 = std::min(m_width, x + src->width());
+    const int y1 = std::min(m_height, y + src->height());
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const QVector<QRgb> palette = src->format() == QImage::Format_Indexed8 ? src->colorTable() : QVector<QRgb>();
+    for (int row = y0; row < y1; ++row)
+    {
+        uchar *dst = scanLine(row) + x0 * 3;
+        const uchar *line = src->constScanLine(row - y);
+        if (src->format() == QImage::Format_Indexed8)
+        {
+            for (int col = x0; col < x1; ++col, dst += 3)
+            {
+                uchar idx = line[col - x];
+                writeBgr(dst, idx < palette.size() ? palette[idx] : qRgb(255, 255, 255));
+            }
+        }
+        else
+        {
+            const QRgb *px = reinterpret_cast<const QRgb *>(line);
+            const bool opaque = src->format() == QImage::Format_RGB32;
+            for (int col = x0; col < x1; ++col, dst += 3)
+            {
+                QRgb p = px[col - x];
+                writeBgr(dst, opaque ? (p | 0xff000000u) : p);
+            }
+        }
+    }
+}
+
+void MappedBmpWriter::fillRect(int x, int y, int w, int h, QRgb color)
+{
+    if (!m_map)
+        return;
+    const int x0 = std::max(0, x);
+    const int y0 = std::max(0, y);
+    const int x1 = std::min(m_width, x + w);
+    const int y1 = std::min(m_height, y + h);
+    for (int row = y0; row < y1; ++row)
+    {
+        uchar *dst = scanLine(row) + x0 * 3;
+        for (int col = x0; col < x1; ++col, dst += 3)
+            writeBgr(dst, color | 0xff000000u);
+    }
+}
+
+bool MappedBmpWriter::decodeFrom(QImageReader &reader, int x, int y)
+{
+    if (!m_metrics)
+    {
+        if (!reader.read(&m_tileBuffer))
+            return false;
+        blitTile(m_tileBuffer, x, y);
+        return true;
+    }
+    const int64_t started_us = monotonicUs();
+    if (!reader.read(&m_tileBuffer))
+        return false;
+    const int64_t decoded_us = monotonicUs();
+    blitTile(m_tileBuffer, x, y);
+    m_metrics->record(MetricStage::Decode, decoded_us - started_us);
+    m_metrics->record(MetricStage::Blit, monotonicUs() - decoded_us);
+    return true;
+}
+
+bool MappedBmpWriter::decodeTileInto(const QString &tile_path, int x, int y)
+{
+    QImageReader reader(tile_path);
+    return decodeFrom(reader, x, y);
+}
+
+bool MappedBmpWriter::decodeTileDataInto(const uchar *data, qint64 size, int x, int y)
+{
+    // Данные не копируются: QBuffer читает прямо из переданной памяти
+    QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(data), static_cast<int>(size));
+    QBuffer buffer(&bytes);
+    if (!buffer.open(QIODevice::ReadOnly))
+        return false;
+    QImageReader reader(&buffer);
+    return decodeFrom(reader, x, y);
+}
+
+bool MappedBmpWriter::close()
+{
+    bool ok = true;
+    if (m_map)
+    {
+        ok = m_file.unmap(m_map);
+        m_map = nullptr;
+        m_pixels = nullptr;
+    }
+    if (m_file.isOpen())
+    {
+        m_file.close();
+        if (m_file.error() != QFileDevice::NoError)
+            ok = false;
+    }
+    return ok;
+}
+
+void MappedBmpWriter::discard()
+{
+    close();
+    if (!m_file.fileName().isEmpty())
+        m_file.remove();
+}
@@ -0,0 +1,76 @@
+#ifndef COMPOSITEWRITER_H
+#define COMPOSITEWRITER_H
+
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+
+#include <string>
+#include <cstdint>
+
+struct StageMetrics;
+
+// Цвет, которым помечаются ячейки композита без плитки
+const QRgb kUnfilledCellColor = qRgb(255, 0, 255);
+
+// Запись композитного снимка напрямую в выходной BMP-файл, отображенный в память.
+// Файл сразу создается финального размера: заголовок и шаг строки известны заранее,
+// поэтому плитки пишутся построчно прямо в отображенную область без промежуточного
+// QImage и без отдельного прохода сериализации. Запись грязных страниц на диск
+// выполняет ОС асинхронно после unmap.
+class MappedBmpWriter
+{
+public:
+    MappedBmpWriter() = default;
+    ~MappedBmpWriter();
+
+    MappedBmpWriter(const MappedBmpWriter &) = delete;
+    MappedBmpWriter &operator=(const MappedBmpWriter &) = delete;
+
+    // Создает файл path размером под изображение width x height (24 бит, BGR) и отображает его в память
+    bool open(const std::string &path, int width, int height);
+
+    // Указатель на строку y (отсчет сверху вниз, как в QImage) внутри отображенного файла
+    uchar *scanLine(int y);
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int bytesPerLine() const { return m_stride; }
+    bool isOpen() const { return m_map != nullptr; }
+
+    // Куда учитывать время декодирования и копирования плиток; nullptr — не учитывать
+    void setMetrics(StageMetrics *metrics) { m_metrics = metrics; }
+
+    // Копирует плитку в позицию (x, y) композита с обрезкой по границам
+    void blitTile(const QImage &tile, int x, int y);
+
+    // Заливает прямоугольник цветом (для ячеек без плитки)
+    void fillRect(int x, int y, int w, int h, QRgb color);
+
+    // Декодирует плитку из файла в переиспользуемый буфер и сразу копирует ее в (x, y).
+    // Возвращает false, если файл не удалось декодировать.
+    bool decodeTileInto(const QString &tile_path, int x, int y);
+
+    // То же для плитки, уже находящейся в памяти (например, в отображенном пакете плиток)
+    bool decodeTileDataInto(const uchar *data, qint64 size, int x, int y);
+
+    // Снимает отображение и закрывает файл. Возвращает false при ошибке записи.
+    bool close();
+
+    // Закрывает и удаляет частично записанный файл
+    void discard();
+
+private:
+    QFile m_file;
+    uchar *m_map = nullptr;
+    uchar *m_pixels = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+    int m_stride = 0;
+    QImage m_tileBuffer; // Переиспользуемый буфер декодирования плиток
+    StageMetrics *m_metrics = nullptr;
+
+    bool decodeFrom(QImageReader &reader, int x, int y);
+};
+
+#endif // COMPOSITEWRITER_H
@@ -0,0 +1,214 @@
+#include "fetchpool.h"
+#include "tracing.h"
+
+#include <algorithm>
+
+namespace
+{
+    const int kFinishThreads = 2; // Сборка композитов идет параллельно для разных объектов
+}
+
+long long FetchBudget::perFetchBytesPerSec() const
+{
+    if (max_bytes_per_sec <= 0)
+        return 0;
+    return std::max(1LL, max_bytes_per_sec / std::max(1, max_concurrent_fetches));
+}
+
+FetchPool::FetchPool(const FetchBudget &budget) : m_budget(budget)
+{
+    m_budget.max_concurrent_fetches = std::max(1, m_budget.max_concurrent_fetches);
+    for (int i = 0; i < m_budget.max_concurrent_fetches; ++i)
+    {
+        m_workers.emplace_back(&FetchPool::workerLoop, this);
+    }
+    for (int i = 0; i < kFinishThreads; ++i)
+    {
+        m_finishers.emplace_back(&FetchPool::finisherLoop, this);
+    }
+}
+
+FetchPool::~FetchPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_work_cv.notify_all();
+    m_finish_cv.notify_all();
+    for (auto &worker : m_workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+    for (auto &finisher : m_finishers)
+    {
+        if (finisher.joinable())
+            finisher.join();
+    }
+}
+
+void FetchPool::submit(const std::string &name, std::vector<int> tiles, TileFetch fetch, JobDone done)
+{
+    auto job = std::make_shared<Job>();
+    job->name = name;
+    job->pending.assign(tiles.begin(), tiles.end());
+    job->fetch = std::move(fetch);
+    job->done = std::move(done);
+    enqueue(std::move(job));
+}
+
+void FetchPool::submitBurst(const std::string &name, BurstFetch fetch, JobDone done)
+{
+    auto job = std::make_shared<Job>();
+    job->name = name;
+    job->pending.push_back(0);
+    job->burst = std::move(fetch);
+    job->done = std::move(done);
+    enqueue(std::move(job));
+}
+
+void FetchPool::enqueue(std::shared_ptr<Job> job)
+{
+    if (job->pending.empty())
+    {
+        if (job->done)
+            job->done({});
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_unfinished_jobs;
+        m_outstanding_tiles += job->pending.size();
+        if (job->burst)
+            ++m_waiting_bursts;
+        m_ready.push_back(std::move(job));
+    }
+    m_work_cv.notify_all();
+}
+
+void FetchPool::post(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_unfinished_jobs;
+        m_finish_queue.push_back(std::move(task));
+    }
+    m_finish_cv.notify_one();
+}
+
+void FetchPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle_cv.wait(lock, [this]
+                   { return m_unfinished_jobs == 0; });
+}
+
+double FetchPool::tileLatencyEwmaSec() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_latency_ewma_sec;
+}
+
+size_t FetchPool::outstandingTiles() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_outstanding_tiles;
+}
+
+double FetchPool::predictSeconds(size_t extra_tiles) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<double>(m_outstanding_tiles + extra_tiles) * m_latency_ewma_sec / m_budget.max_concurrent_fetches;
+}
+
+void FetchPool::workerLoop()
+{
+    TRACE_THREAD_NAME("fetch");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        // Пока залп ждет, новые плитки не начинаются: он стартует, когда освободятся все места
+        m_work_cv.wait(lock, [this]
+                       { return m_shutdown ||
+                                (m_waiting_bursts > 0 ? m_active_slots == 0
+                                                      : !m_ready.empty() && m_active_slots < m_budget.max_concurrent_fetches); });
+        if (m_shutdown)
+            return;
+
+        // Одна плитка у задания из головы очереди, затем задание уходит в хвост.
+        // Ждущий залп берется вне очереди и получает весь бюджет.
+        auto it = m_ready.begin();
+        if (m_waiting_bursts > 0)
+        {
+            it = std::find_if(m_ready.begin(), m_ready.end(), [](const std::shared_ptr<Job> &ready)
+                              { return static_cast<bool>(ready->burst); });
+            --m_waiting_bursts;
+        }
+        std::shared_ptr<Job> job = *it;
+        m_ready.erase(it);
+        int tile = job->pending.front();
+        job->pending.pop_front();
+        ++job->in_flight;
+        if (!job->pending.empty())
+            m_ready.push_back(job);
+        const int connections = job->burst ? m_budget.max_concurrent_fetches : 1;
+        m_active_slots += connections;
+
+        lock.unlock();
+        const auto fetch_start = std::chrono::steady_clock::now();
+        bool ok = job->burst ? job->burst(connections) : job->fetch(tile);
+        const double fetch_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - fetch_start).count();
+        lock.lock();
+        m_active_slots -= connections;
+        // После залпа свободны все места; последнее освободившееся место нужно ждущему залпу
+        if (connections > 1 || (m_waiting_bursts > 0 && m_active_slots == 0))
+            m_work_cv.notify_all();
+
+        // Сглаживание по последним ~20 успешным плиткам; неудачи после остановки
+        // завершаются мгновенно и исказили бы оценку
+        if (ok && !job->burst)
+        {
+            const double alpha = 0.05;
+            m_latency_ewma_sec = m_latency_ewma_sec > 0.0 ? (1.0 - alpha) * m_latency_ewma_sec + alpha * fetch_sec : fetch_sec;
+        }
+        --m_outstanding_tiles;
+        --job->in_flight;
+        if (!ok)
+            job->failed.push_back(tile);
+        if (job->pending.empty() && job->in_flight == 0)
+        {
+            // Завершение задания не задерживает загрузку: оно уходит на поток завершения
+            std::vector<int> failed;
+            failed.swap(job->failed);
+            std::sort(failed.begin(), failed.end());
+            m_finish_queue.push_back([job, failed]() mutable
+                                     {
+                                         if (job->done)
+                                             job->done(std::move(failed)); });
+            m_finish_cv.notify_one();
+        }
+    }
+}
+
+void FetchPool::finisherLoop()
+{
+    TRACE_THREAD_NAME("finish");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_finish_cv.wait(lock, [this]
+                         { return m_shutdown || !m_finish_queue.empty(); });
+        if (m_finish_queue.empty())
+            return;
+
+        Task task = std::move(m_finish_queue.front());
+        m_finish_queue.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+        if (--m_unfinished_jobs == 0)
+            m_idle_cv.notify_all();
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef FETCHPOOL_H
+#define FETCHPOOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Общий для всех объектов бюджет загрузки плиток
+struct FetchBudget
+{
+    int max_concurrent_fetches = 8;   // Одновременных запросов на весь процесс
+    long long max_bytes_per_sec = 0;  // Суммарная полоса, 0 — без ограничения
+
+    // Доля полосы на один запрос (для CURLOPT_MAX_RECV_SPEED_LARGE), 0 — без ограничения
+    long long perFetchBytesPerSec() const;
+};
+
+// Пул загрузки плиток для нескольких объектов одновременно.
+// Каждый объект отправляется как задание со списком плиток; свободный поток берет
+// следующую плитку у следующего по кругу задания. Так ни один большой объект
+// не занимает все потоки, а время цикла стремится ко времени самого большого объекта.
+// Потоки загрузки только загружают: завершение заданий (сверка, сборка композита, архив)
+// и прочая работа захвата идут на отдельных потоках завершения, не занимая мест бюджета.
+class FetchPool
+{
+public:
+    // Загрузка одной плитки; возвращает false при неудаче
+    using TileFetch = std::function<bool(int tile_index)>;
+    // Вызывается один раз, когда все плитки задания обработаны (в потоке завершения пула)
+    using JobDone = std::function<void(std::vector<int> failed_tiles)>;
+    // Залп: одна задача, сама открывающая connections соединений; возвращает false при неудаче
+    using BurstFetch = std::function<bool(int connections)>;
+    using Task = std::function<void()>;
+
+    explicit FetchPool(const FetchBudget &budget);
+    ~FetchPool();
+
+    FetchPool(const FetchPool &) = delete;
+    FetchPool &operator=(const FetchPool &) = delete;
+
+    // Можно вызывать из JobDone, например для повторного запроса недостающих плиток
+    void submit(const std::string &name, std::vector<int> tiles, TileFetch fetch, JobDone done);
+    // Залп занимает весь бюджет: он стартует, когда завершатся уже начатые загрузки,
+    // а пока он ждет или идет, новые плитки других заданий не начинаются. В оценку
+    // времени плитки залп не входит — его длительность не время одной плитки.
+    void submitBurst(const std::string &name, BurstFetch fetch, JobDone done);
+
+    // Работа вне бюджета загрузки (например, предварительный композит) на потоке завершения
+    void post(Task task);
+
+    // Ждет завершения всех заданий и задач, включая отправленные из JobDone
+    void waitIdle();
+
+    const FetchBudget &budget() const { return m_budget; }
+
+    // Скользящее среднее времени загрузки одной плитки, 0 — еще нет замеров
+    double tileLatencyEwmaSec() const;
+    // Плиток в очереди и в работе по всем заданиям
+    size_t outstandingTiles() const;
+
+    // Оценка времени, за которое пул выполнит текущую очередь и еще extra_tiles плиток
+    double predictSeconds(size_t extra_tiles) const;
+
+private:
+    struct Job
+    {
+        std::string name;
+        std::deque<int> pending;
+        int in_flight = 0;
+        std::vector<int> failed;
+        TileFetch fetch;
+        BurstFetch burst; // Задан у залпа; pending тогда из одного элемента
+        JobDone done;
+    };
+
+    void enqueue(std::shared_ptr<Job> job);
+
+    void workerLoop();
+    void finisherLoop();
+
+    FetchBudget m_budget;
+    std::vector<std::thread> m_workers;
+    std::vector<std::thread> m_finishers;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_idle_cv;
+    std::condition_variable m_finish_cv;
+    std::deque<Task> m_finish_queue; // Завершения заданий и задачи post()
+    std::deque<std::shared_ptr<Job>> m_ready; // Задания с неразобранными плитками, по кругу
+    int m_unfinished_jobs = 0; // Задания до конца JobDone и задачи post()
+    size_t m_outstanding_tiles = 0;
+    int m_active_slots = 0; // Занятые места бюджета: по одному на плитку, у залпа — все
+    int m_waiting_bursts = 0; // Залпы в очереди, еще не начатые
+    double m_latency_ewma_sec = 0.0;
+    bool m_shutdown = false;
+};
+
+#endif // FETCHPOOL_H
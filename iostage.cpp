@@ -0,0 +1,404 @@
+#include "iostage.h"
+
+#include "asynclog.h"
+#include "metrics.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef SCREEN_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace
+{
+    // Переносимая запись одного файла для запасного пути
+    bool writeWholeFile(const std::string &path, const std::string &data, bool append, bool durable)
+    {
+        TRACE_SPAN("write_file");
+        const int64_t started_us = monotonicUs();
+        FILE *file = fopen(path.c_str(), append ? "ab" : "wb");
+        if (!file)
+        {
+            logError("file_open_failed", "Ошибка открытия файла для записи file=%s errno=%d", path.c_str(), errno);
+            return false;
+        }
+        bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+        ok = (fflush(file) == 0) && ok;
+        if (ok && durable)
+        {
+#ifdef _WIN32
+            ok = _commit(_fileno(file)) == 0;
+#else
+            ok = fsync(fileno(file)) == 0;
+#endif
+        }
+        ok = (fclose(file) == 0) && ok;
+        if (!ok)
+            logError("file_write_failed", "Ошибка записи файла file=%s", path.c_str());
+        processMetrics().record(MetricStage::Write, monotonicUs() - started_us);
+        return ok;
+    }
+}
+
+IoStage::IoStage() : IoStage(Options()) {}
+
+IoStage::IoStage(const Options &options) : m_options(options)
+{
+    m_options.max_batch_ops = std::max<size_t>(1, m_options.max_batch_ops);
+    m_options.max_queued_ops = std::max(m_options.max_queued_ops, m_options.max_batch_ops);
+
+#ifdef SCREEN_HAVE_LIBURING
+    // На каждую запись пачки нужно до двух SQE: write и связанный с ним fsync
+    auto *ring = new io_uring;
+    int rc = io_uring_queue_init(static_cast<unsigned>(m_options.max_batch_ops * 2), ring, 0);
+    if (rc == 0)
+    {
+        m_uring = ring;
+    }
+    else
+    {
+        logWarning("uring_unavailable", "io_uring недоступен, используется пул потоков записи rc=%d", -rc);
+        delete ring;
+    }
+#endif
+
+    if (!m_uring)
+    {
+        // Диспетчер сам участвует в записи пачки, поэтому помощников на один меньше
+        for (int i = 1; i < std::max(1, m_options.fallback_threads); ++i)
+            m_helpers.emplace_back(&IoStage::helperLoop, this);
+    }
+    m_dispatcher = std::thread(&IoStage::dispatcherLoop, this);
+}
+
+IoStage::~IoStage()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_queue_cv.notify_all();
+    m_space_cv.notify_all();
+    if (m_dispatcher.joinable())
+        m_dispatcher.join();
+
+    {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        m_helpers_stop = true;
+    }
+    m_batch_cv.notify_all();
+    for (auto &helper : m_helpers)
+    {
+        if (helper.joinable())
+            helper.join();
+    }
+
+#ifdef SCREEN_HAVE_LIBURING
+    if (m_uring)
+    {
+        auto *ring = static_cast<io_uring *>(m_uring);
+        io_uring_queue_exit(ring);
+        delete ring;
+        m_uring = nullptr;
+    }
+#endif
+}
+
+uint64_t IoStage::writeFile(std::string path, std::string data, bool durable, Done done)
+{
+    Op op;
+    op.type = OpType::Write;
+    op.path = std::move(path);
+    op.data = std::move(data);
+    op.durable = durable;
+    op.done = std::move(done);
+    return enqueue(std::move(op));
+}
+
+uint64_t IoStage::appendFile(std::string path, std::string data, bool durable, Done done)
+{
+    Op op;
+    op.type = OpType::Append;
+    op.path = std::move(path);
+    op.data = std::move(data);
+    op.durable = durable;
+    op.done = std::move(done);
+    return enqueue(std::move(op));
+}
+
+uint64_t IoStage::createDirectories(std::string path, Done done)
+{
+    Op op;
+    op.type = OpType::CreateDirectories;
+    op.path = std::move(path);
+    op.done = std::move(done);
+    return enqueue(std::move(op));
+}
+
+uint64_t IoStage::removeAll(std::string path, Done done)
+{
+    Op op;
+    op.type = OpType::RemoveAll;
+    op.path = std::move(path);
+    op.done = std::move(done);
+    return enqueue(std::move(op));
+}
+
+uint64_t IoStage::enqueue(Op op)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // Обратное давление: ждать, пока диск не разберет очередь.
+    // Одна операция больше лимита байт все равно принимается, если очередь пуста.
+    m_space_cv.wait(lock, [&]
+                    { return m_shutdown ||
+                             (m_pending_ops < m_options.max_queued_ops &&
+                              (m_pending_ops == 0 || m_queued_bytes + op.data.size() <= m_options.max_queued_bytes)); });
+    op.seq = m_next_seq++;
+    ++m_pending_ops;
+    m_queued_bytes += op.data.size();
+    const uint64_t seq = op.seq;
+    m_queue.push_back(std::move(op));
+    lock.unlock();
+    m_queue_cv.notify_one();
+    return seq;
+}
+
+void IoStage::waitFor(uint64_t seq)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [&]
+                   { return m_completed_seq >= seq; });
+}
+
+void IoStage::flush()
+{
+    uint64_t last = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        last = m_next_seq - 1;
+    }
+    waitFor(last);
+}
+
+void IoStage::dispatcherLoop()
+{
+    TRACE_THREAD_NAME("io");
+    while (true)
+    {
+        std::vector<Op> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queue_cv.wait(lock, [this]
+                            { return m_shutdown || !m_queue.empty(); });
+            if (m_queue.empty())
+                return; // Остановка и очередь разобрана
+
+            // Операция с каталогом выполняется отдельно; записи до следующей такой операции — одной пачкой
+            const bool directory_op = m_queue.front().type == OpType::CreateDirectories ||
+                                      m_queue.front().type == OpType::RemoveAll;
+            do
+            {
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            } while (!directory_op && !m_queue.empty() && batch.size() < m_options.max_batch_ops &&
+                     (m_queue.front().type == OpType::Write || m_queue.front().type == OpType::Append));
+        }
+
+        if (batch.front().type == OpType::CreateDirectories || batch.front().type == OpType::RemoveAll)
+            runDirectoryOp(batch.front());
+        else
+            runWriteBatch(batch);
+
+        size_t batch_bytes = 0;
+        for (Op &op : batch)
+        {
+            batch_bytes += op.data.size();
+            if (op.done)
+                op.done(op.ok);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending_ops -= batch.size();
+            m_queued_bytes -= batch_bytes;
+            m_completed_seq = batch.back().seq;
+        }
+        m_space_cv.notify_all();
+        m_done_cv.notify_all();
+    }
+}
+
+void IoStage::runDirectoryOp(Op &op)
+{
+    TRACE_SPAN(op.type == OpType::CreateDirectories ? "create_directories" : "remove_all");
+    std::error_code ec;
+    if (op.type == OpType::CreateDirectories)
+        std::filesystem::create_directories(op.path, ec);
+    else
+        std::filesystem::remove_all(op.path, ec);
+    op.ok = !ec;
+    if (ec)
+    {
+        logError("dir_op_failed", "Ошибка операции с каталогом dir=%s: %s", op.path.c_str(), ec.message().c_str());
+    }
+}
+
+void IoStage::runWriteBatch(std::vector<Op> &batch)
+{
+    TRACE_SPAN("write_batch");
+    if (m_uring && runWriteBatchUring(batch))
+        return;
+    runWriteBatchThreads(batch);
+}
+
+bool IoStage::runWriteBatchUring(std::vector<Op> &batch)
+{
+#ifdef SCREEN_HAVE_LIBURING
+    auto *ring = static_cast<io_uring *>(m_uring);
+    std::vector<int> fds(batch.size(), -1);
+    std::vector<int> results(batch.size() * 2, 0);
+    unsigned expected = 0;
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        Op &op = batch[i];
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (op.type == OpType::Append ? O_APPEND : O_TRUNC);
+        fds[i] = open(op.path.c_str(), flags, 0644);
+        if (fds[i] < 0)
+        {
+            logError("file_open_failed", "Ошибка открытия файла для записи file=%s errno=%d", op.path.c_str(), errno);
+            continue;
+        }
+        io_uring_sqe *sqe = io_uring_get_sqe(ring);
+        if (!sqe)
+            break;
+        io_uring_prep_write(sqe, fds[i], op.data.data(), static_cast<unsigned>(op.data.size()), 0);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(static_cast<uintptr_t>(i * 2)));
+        ++expected;
+        if (op.durable)
+        {
+            // fsync связан с записью и выполняется только после нее
+            sqe->flags |= IOSQE_IO_LINK;
+            io_uring_sqe *fsync_sqe = io_uring_get_sqe(ring);
+            if (fsync_sqe)
+            {
+                io_uring_prep_fsync(fsync_sqe, fds[i], IORING_FSYNC_DATASYNC);
+                io_uring_sqe_set_data(fsync_sqe, reinterpret_cast<void *>(static_cast<uintptr_t>(i * 2 + 1)));
+                ++expected;
+            }
+            else
+            {
+                sqe->flags &= ~IOSQE_IO_LINK;
+            }
+        }
+    }
+
+    // Один системный вызов на все записи и fsync; каждая запись пачки ждет всю пачку
+    const int64_t submitted_us = monotonicUs();
+    int rc = expected > 0 ? io_uring_submit_and_wait(ring, expected) : 0;
+    if (rc < 0)
+    {
+        logError("uring_submit_failed", "Ошибка io_uring_submit rc=%d", -rc);
+    }
+    for (unsigned done = 0; done < expected && rc >= 0; ++done)
+    {
+        io_uring_cqe *cqe = nullptr;
+        if (io_uring_wait_cqe(ring, &cqe) < 0 || !cqe)
+            break;
+        const size_t slot = static_cast<size_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+        if (slot < results.size())
+            results[slot] = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+    }
+
+    const int64_t batch_us = monotonicUs() - submitted_us;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        Op &op = batch[i];
+        if (fds[i] < 0)
+            continue;
+        processMetrics().record(MetricStage::Write, batch_us);
+        op.ok = results[i * 2] == static_cast<int>(op.data.size()) && (!op.durable || results[i * 2 + 1] == 0);
+        if (!op.ok)
+            logError("file_write_failed", "Ошибка записи файла file=%s", op.path.c_str());
+        close(fds[i]);
+    }
+    return rc >= 0;
+#else
+    (void)batch;
+    return false;
+#endif
+}
+
+void IoStage::runWriteBatchThreads(std::vector<Op> &batch)
+{
+    auto runClaimed = [this](std::vector<Op> &ops)
+    {
+        while (true)
+        {
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(m_batch_mutex);
+                if (m_batch_next >= ops.size())
+                    return;
+                index = m_batch_next++;
+            }
+            Op &op = ops[index];
+            op.ok = writeWholeFile(op.path, op.data, op.type == OpType::Append, op.durable);
+            std::lock_guard<std::mutex> lock(m_batch_mutex);
+            if (--m_batch_remaining == 0)
+                m_batch_done_cv.notify_all();
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        m_batch = &batch;
+        m_batch_next = 0;
+        m_batch_remaining = batch.size();
+        ++m_batch_generation;
+    }
+    m_batch_cv.notify_all();
+    runClaimed(batch);
+
+    std::unique_lock<std::mutex> lock(m_batch_mutex);
+    m_batch_done_cv.wait(lock, [this]
+                         { return m_batch_remaining == 0; });
+    m_batch = nullptr;
+}
+
+void IoStage::helperLoop()
+{
+    TRACE_THREAD_NAME("io_helper");
+    uint64_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(m_batch_mutex);
+    while (true)
+    {
+        m_batch_cv.wait(lock, [&]
+                        { return m_helpers_stop || (m_batch && m_batch_generation != seen_generation); });
+        if (m_helpers_stop)
+            return;
+        seen_generation = m_batch_generation;
+        std::vector<Op> &ops = *m_batch;
+        while (m_batch_next < ops.size())
+        {
+            Op &op = ops[m_batch_next++];
+            lock.unlock();
+            op.ok = writeWholeFile(op.path, op.data, op.type == OpType::Append, op.durable);
+            lock.lock();
+            if (--m_batch_remaining == 0)
+                m_batch_done_cv.notify_all();
+        }
+    }
+}
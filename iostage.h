@@ -0,0 +1,110 @@
+#ifndef IOSTAGE_H
+#define IOSTAGE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Асинхронная стадия дисковых операций захвата (write-behind).
+// Загрузчики и компоновщик ставят операции в ограниченную очередь и продолжают работу;
+// ждать диска приходится только при переполнении очереди (обратное давление).
+// Операции выполняются пачками в порядке постановки: записи внутри пачки идут одновременно
+// (io_uring на Linux при сборке с liburing, иначе пул потоков), fsync связан со своей записью,
+// а операции с каталогами разделяют пачки, чтобы создание каталога шло раньше записей в него.
+class IoStage
+{
+public:
+    struct Options
+    {
+        size_t max_queued_ops = 512;
+        size_t max_queued_bytes = 64u * 1024u * 1024u;
+        size_t max_batch_ops = 64;
+        int fallback_threads = 4; // Потоки записи, если io_uring недоступен
+    };
+
+    // Результат операции: true — успех
+    using Done = std::function<void(bool ok)>;
+
+    IoStage();
+    explicit IoStage(const Options &options);
+    ~IoStage(); // Дожидается выполнения всей очереди
+
+    IoStage(const IoStage &) = delete;
+    IoStage &operator=(const IoStage &) = delete;
+
+    // Каждая операция возвращает порядковый номер для waitFor().
+    // durable — выполнить fsync после записи (для временных файлов не нужно).
+    uint64_t writeFile(std::string path, std::string data, bool durable = false, Done done = Done());
+    uint64_t appendFile(std::string path, std::string data, bool durable = false, Done done = Done());
+    uint64_t createDirectories(std::string path, Done done = Done());
+    uint64_t removeAll(std::string path, Done done = Done());
+
+    // Ждет выполнения всех операций с номером не больше seq
+    void waitFor(uint64_t seq);
+    // Ждет выполнения всего, что поставлено до вызова
+    void flush();
+
+    bool usesIoUring() const { return m_uring != nullptr; }
+
+private:
+    enum class OpType
+    {
+        Write,
+        Append,
+        CreateDirectories,
+        RemoveAll
+    };
+
+    struct Op
+    {
+        uint64_t seq = 0;
+        OpType type = OpType::Write;
+        std::string path;
+        std::string data;
+        bool durable = false;
+        bool ok = false;
+        Done done;
+    };
+
+    uint64_t enqueue(Op op);
+    void dispatcherLoop();
+    void runDirectoryOp(Op &op);
+    void runWriteBatch(std::vector<Op> &batch);
+    void runWriteBatchThreads(std::vector<Op> &batch);
+    bool runWriteBatchUring(std::vector<Op> &batch);
+    void helperLoop();
+
+    Options m_options;
+
+    std::mutex m_mutex;
+    std::condition_variable m_queue_cv;    // Появились операции / остановка
+    std::condition_variable m_space_cv;    // Освободилось место в очереди
+    std::condition_variable m_done_cv;     // Продвинулся номер выполненных операций
+    std::deque<Op> m_queue;
+    size_t m_pending_ops = 0;  // В очереди и в работе
+    size_t m_queued_bytes = 0; // Байт данных в очереди и в работе
+    uint64_t m_next_seq = 1;
+    uint64_t m_completed_seq = 0;
+    bool m_shutdown = false;
+
+    // Запасной пул потоков для записи пачки
+    std::mutex m_batch_mutex;
+    std::condition_variable m_batch_cv;
+    std::condition_variable m_batch_done_cv;
+    std::vector<Op> *m_batch = nullptr;
+    size_t m_batch_next = 0;
+    size_t m_batch_remaining = 0;
+    uint64_t m_batch_generation = 0;
+    bool m_helpers_stop = false;
+    std::vector<std::thread> m_helpers;
+
+    void *m_uring = nullptr; // struct io_uring*, если доступен
+    std::thread m_dispatcher;
+};
+
+#endif // IOSTAGE_H
@@ -0,0 +1,126 @@
+#include "mapobjectmodel.h"
+
+#include <QVector>
+
+#include <algorithm>
+
+MapObjectListModel::MapObjectListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int MapObjectListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_objects.size());
+}
+
+QVariant MapObjectListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= static_cast<int>(m_objects.size()))
+        return QVariant();
+    if (role == Qt::DisplayRole)
+        return m_objects[index.row()].getDisplayText();
+    const ObjectProgress &progress = m_progress[index.row()];
+    if (role == ProgressRole && progress.total > 0)
+        return static_cast<int>(std::min<uint32_t>(100, progress.done * 100 / progress.total));
+    if (role == ProgressFailedRole && progress.total > 0)
+        return progress.failed > 0;
+    return QVariant();
+}
+
+bool MapObjectListModel::append(MapObject object)
+{
+    if (!m_names.insert(object.name).second)
+        return false;
+    const int row = static_cast<int>(m_objects.size());
+    beginInsertRows(QModelIndex(), row, row);
+    m_objects.push_back(std::move(object));
+    m_progress.emplace_back();
+    endInsertRows();
+    return true;
+}
+
+void MapObjectListModel::appendBatch(std::vector<MapObject> objects)
+{
+    if (objects.empty())
+        return;
+    const int first = static_cast<int>(m_objects.size());
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(objects.size()) - 1);
+    m_objects.reserve(m_objects.size() + objects.size());
+    m_names.reserve(m_names.size() + objects.size());
+    for (MapObject &object : objects)
+    {
+        m_names.insert(object.name);
+        m_objects.push_back(std::move(object));
+    }
+    m_progress.resize(m_objects.size());
+    endInsertRows();
+}
+
+bool MapObjectListModel::removeObject(int row)
+{
+    if (row < 0 || row >= static_cast<int>(m_objects.size()))
+        return false;
+    beginRemoveRows(QModelIndex(), row, row);
+    m_names.erase(m_objects[row].name);
+    m_objects.erase(m_objects.begin() + row);
+    m_progress.erase(m_progress.begin() + row);
+    m_dirty_first = m_dirty_last = -1;
+    endRemoveRows();
+    return true;
+}
+
+void MapObjectListModel::setCaptureState(int row, int64_t capture_ms, uint32_t missing_tiles)
+{
+    if (row < 0 || row >= static_cast<int>(m_objects.size()))
+        return;
+    m_objects[row].last_capture_ms = capture_ms;
+    m_objects[row].last_missing_tiles = missing_tiles;
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed);
+}
+
+void MapObjectListModel::beginObjectProgress(int row, uint32_t total_tiles)
+{
+    if (row < 0 || row >= static_cast<int>(m_progress.size()))
+        return;
+    m_progress[row] = ObjectProgress();
+    m_progress[row].total = total_tiles;
+    markProgressDirty(row);
+}
+
+void MapObjectListModel::addTileProgress(int row, bool ok)
+{
+    if (row < 0 || row >= static_cast<int>(m_progress.size()) || m_progress[row].total == 0)
+        return;
+    if (ok)
+        ++m_progress[row].done;
+    else
+        ++m_progress[row].failed;
+    markProgressDirty(row);
+}
+
+void MapObjectListModel::endObjectProgress(int row)
+{
+    if (row < 0 || row >= static_cast<int>(m_progress.size()))
+        return;
+    m_progress[row] = ObjectProgress();
+    markProgressDirty(row);
+}
+
+void MapObjectListModel::markProgressDirty(int row)
+{
+    if (m_dirty_first < 0 || row < m_dirty_first)
+        m_dirty_first = row;
+    if (row > m_dirty_last)
+        m_dirty_last = row;
+}
+
+void MapObjectListModel::publishProgress()
+{
+    if (m_dirty_first < 0)
+        return;
+    const QVector<int> roles = {ProgressRole, ProgressFailedRole};
+    emit dataChanged(index(m_dirty_first), index(m_dirty_last), roles);
+    m_dirty_first = m_dirty_last = -1;
+}
@@ -0,0 +1,67 @@
+#ifndef MAPOBJECTMODEL_H
+#define MAPOBJECTMODEL_H
+
+#include <QAbstractListModel>
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "MapObject.h"
+
+// Список объектов для QListView. Текст строки строится только для видимых строк,
+// поэтому список в сотни тысяч объектов не создает элемента на каждый объект.
+// Имена хранятся в хеш-множестве: проверка повтора не зависит от длины списка.
+class MapObjectListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles
+    {
+        ProgressRole = Qt::UserRole + 1, // Процент полученных плиток идущего захвата; нет значения — захват не идет
+        ProgressFailedRole               // Были ли неудачные запросы плиток в идущем захвате
+    };
+
+    explicit MapObjectListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    bool containsName(const std::string &name) const { return m_names.count(name) != 0; }
+    const std::unordered_set<std::string> &names() const { return m_names; }
+    const std::vector<MapObject> &objects() const { return m_objects; }
+
+    // false — объект с таким именем уже есть
+    bool append(MapObject object);
+    // Добавляет объекты одной вставкой строк; имена должны быть новыми (см. importMapObjects)
+    void appendBatch(std::vector<MapObject> objects);
+    bool removeObject(int row);
+    // Состояние последнего захвата объекта (MapObject::last_capture_ms, last_missing_tiles)
+    void setCaptureState(int row, int64_t capture_ms, uint32_t missing_tiles);
+
+    // Ход идущего захвата. Изменения накапливаются и сообщаются представлению
+    // одним dataChanged в publishProgress(), а не на каждую плитку.
+    void beginObjectProgress(int row, uint32_t total_tiles);
+    void addTileProgress(int row, bool ok);
+    void endObjectProgress(int row);
+    void publishProgress();
+
+private:
+    struct ObjectProgress
+    {
+        uint32_t total = 0; // 0 — захват не идет
+        uint32_t done = 0;
+        uint32_t failed = 0;
+    };
+
+    void markProgressDirty(int row);
+
+    std::vector<MapObject> m_objects;
+    std::unordered_set<std::string> m_names;
+    std::vector<ObjectProgress> m_progress; // Параллельно m_objects
+    int m_dirty_first = -1;
+    int m_dirty_last = -1;
+};
+
+#endif // MAPOBJECTMODEL_H
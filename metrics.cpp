@@ -0,0 +1,300 @@
+#include "metrics.h"
+
+#include <QSaveFile>
+#include <QString>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct MetricsRegistry
+    {
+        std::mutex mutex;
+        std::map<std::string, std::unique_ptr<StageMetrics>> objects;
+        StageMetrics process;
+    };
+
+    MetricsRegistry &registry()
+    {
+        static MetricsRegistry instance;
+        return instance;
+    }
+
+    // Снимок счетчиков и гистограмм для выгрузки
+    struct MetricsSnapshot
+    {
+        LatencyHistogram::Snapshot stages[static_cast<int>(MetricStage::Count)];
+        uint64_t tiles_ok = 0;
+        uint64_t tiles_failed = 0;
+        uint64_t bytes = 0;
+        uint64_t retries = 0;
+        uint64_t cache_hits = 0;
+        uint64_t cache_misses = 0;
+
+        void add(const StageMetrics &metrics)
+        {
+            for (int i = 0; i < static_cast<int>(MetricStage::Count); ++i)
+            {
+                LatencyHistogram::Snapshot stage;
+                metrics.stages[i].snapshot(stage);
+                stages[i].merge(stage);
+            }
+            tiles_ok += metrics.tiles_ok.load(std::memory_order_relaxed);
+            tiles_failed += metrics.tiles_failed.load(std::memory_order_relaxed);
+            bytes += metrics.bytes.load(std::memory_order_relaxed);
+            retries += metrics.retries.load(std::memory_order_relaxed);
+            cache_hits += metrics.cache_hits.load(std::memory_order_relaxed);
+            cache_misses += metrics.cache_misses.load(std::memory_order_relaxed);
+        }
+    };
+
+    // Значение метки по правилам формата: экранируются \, " и перевод строки
+    std::string escapeLabel(const std::string &value)
+    {
+        std::string out;
+        out.reserve(value.size());
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (c == '\n')
+            {
+                out += "\\n";
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    // {object="...",extra} или {extra}; пустой object — серия семейства screen_process_*
+    std::string labels(const std::string &object, const std::string &extra)
+    {
+        std::string out = "{";
+        if (!object.empty())
+        {
+            out += "object=\"" + escapeLabel(object) + "\"";
+            if (!extra.empty())
+                out += ",";
+        }
+        out += extra + "}";
+        return out == "{}" ? std::string() : out;
+    }
+
+    void appendCounter(std::string &out, const char *name, const std::string &label_set, uint64_t value)
+    {
+        char number[32];
+        std::snprintf(number, sizeof(number), " %llu\n", static_cast<unsigned long long>(value));
+        out += name;
+        out += label_set;
+        out += number;
+    }
+
+    void appendStages(std::string &out, const std::string &family, const std::string &object, const MetricsSnapshot &snapshot)
+    {
+        static const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+        char line[256];
+        for (int i = 0; i < static_cast<int>(MetricStage::Count); ++i)
+        {
+            const LatencyHistogram::Snapshot &stage = snapshot.stages[i];
+            if (stage.total == 0)
+                continue;
+            const std::string stage_label = std::string("stage=\"") + metricStageName(static_cast<MetricStage>(i)) + "\"";
+            for (double q : kQuantiles)
+            {
+                char quantile_label[48];
+                std::snprintf(quantile_label, sizeof(quantile_label), ",quantile=\"%g\"", q);
+                std::snprintf(line, sizeof(line), " %.6f\n", stage.valueAtQuantile(q) / 1e6);
+                out += family + labels(object, stage_label + quantile_label) + line;
+            }
+            std::snprintf(line, sizeof(line), " %.6f\n", stage.sum_us / 1e6);
+            out += family + "_sum" + labels(object, stage_label) + line;
+            appendCounter(out, (family + "_count").c_str(), labels(object, stage_label), stage.total);
+        }
+    }
+}
+
+const char *metricStageName(MetricStage stage)
+{
+    switch (stage)
+    {
+    case MetricStage::Dns:
+        return "dns";
+    case MetricStage::Connect:
+        return "connect";
+    case MetricStage::Tls:
+        return "tls";
+    case MetricStage::FirstByte:
+        return "first_byte";
+    case MetricStage::Transfer:
+        return "transfer";
+    case MetricStage::Decode:
+        return "decode";
+    case MetricStage::Blit:
+        return "blit";
+    case MetricStage::Encode:
+        return "encode";
+    case MetricStage::Write:
+        return "write";
+    case MetricStage::Count:
+        break;
+    }
+    return "unknown";
+}
+
+int64_t LatencyHistogram::bucketLowerBound(int bucket)
+{
+    if (bucket < kLinearBuckets)
+        return bucket;
+    const int exponent = 4 + (bucket - kLinearBuckets) / kSubBuckets;
+    const int sub = (bucket - kLinearBuckets) % kSubBuckets;
+    return static_cast<int64_t>(kSubBuckets + sub) << (exponent - 3);
+}
+
+void LatencyHistogram::snapshot(Snapshot &out) const
+{
+    out.total = 0;
+    for (int i = 0; i < kBucketCount; ++i)
+    {
+        out.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        out.total += out.counts[i];
+    }
+    out.sum_us = m_sum_us.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Snapshot::merge(const Snapshot &other)
+{
+    for (int i = 0; i < kBucketCount; ++i)
+        counts[i] += other.counts[i];
+    total += other.total;
+    sum_us += other.sum_us;
+}
+
+int64_t LatencyHistogram::Snapshot::valueAtQuantile(double q) const
+{
+    if (total == 0)
+        return 0;
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total) + 0.5);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            const int64_t low = bucketLowerBound(i);
+            const int64_t high = i + 1 < kBucketCount ? bucketLowerBound(i + 1) : low;
+            return (low + high) / 2;
+        }
+    }
+    return bucketLowerBound(kBucketCount - 1);
+}
+
+StageMetrics &objectMetrics(const std::string &object_name)
+{
+    MetricsRegistry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::unique_ptr<StageMetrics> &metrics = r.objects[object_name];
+    if (!metrics)
+        metrics = std::make_unique<StageMetrics>();
+    return *metrics;
+}
+
+StageMetrics &processMetrics()
+{
+    return registry().process;
+}
+
+std::string formatPrometheusMetrics()
+{
+    MetricsRegistry &r = registry();
+    std::vector<std::pair<std::string, MetricsSnapshot>> objects;
+    MetricsSnapshot total;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        objects.reserve(r.objects.size());
+        for (const auto &item : r.objects)
+        {
+            objects.emplace_back(item.first, MetricsSnapshot());
+            objects.back().second.add(*item.second);
+            total.add(*item.second);
+        }
+    }
+    total.add(r.process);
+
+    // Суммы по процессу — отдельные семейства screen_process_*: в одном семействе с сериями
+    // по объектам sum() без фильтра по метке object посчитал бы каждое значение дважды
+    std::string out;
+    out += "# HELP screen_stage_seconds Время этапов захвата и сборки композита по объектам.\n";
+    out += "# TYPE screen_stage_seconds summary\n";
+    for (const auto &item : objects)
+        appendStages(out, "screen_stage_seconds", item.first, item.second);
+    out += "# HELP screen_process_stage_seconds Время этапов захвата и сборки композита по процессу.\n";
+    out += "# TYPE screen_process_stage_seconds summary\n";
+    appendStages(out, "screen_process_stage_seconds", std::string(), total);
+
+    auto appendFamily = [&](const char *name, const char *process_name, const char *help, uint64_t MetricsSnapshot::*field)
+    {
+        out += std::string("# HELP ") + name + " " + help + "\n";
+        out += std::string("# TYPE ") + name + " counter\n";
+        for (const auto &item : objects)
+            appendCounter(out, name, labels(item.first, std::string()), item.second.*field);
+        out += std::string("# HELP ") + process_name + " " + help + " Сумма по процессу.\n";
+        out += std::string("# TYPE ") + process_name + " counter\n";
+        appendCounter(out, process_name, std::string(), total.*field);
+    };
+    out += "# HELP screen_tiles_total Запросы плиток по результату.\n";
+    out += "# TYPE screen_tiles_total counter\n";
+    for (const auto &item : objects)
+    {
+        appendCounter(out, "screen_tiles_total", labels(item.first, "result=\"ok\""), item.second.tiles_ok);
+        appendCounter(out, "screen_tiles_total", labels(item.first, "result=\"failed\""), item.second.tiles_failed);
+    }
+    out += "# HELP screen_process_tiles_total Запросы плиток по результату. Сумма по процессу.\n";
+    out += "# TYPE screen_process_tiles_total counter\n";
+    appendCounter(out, "screen_process_tiles_total", "{result=\"ok\"}", total.tiles_ok);
+    appendCounter(out, "screen_process_tiles_total", "{result=\"failed\"}", total.tiles_failed);
+    appendFamily("screen_bytes_total", "screen_process_bytes_total", "Получено байт плиток.", &MetricsSnapshot::bytes);
+    appendFamily("screen_tile_retries_total", "screen_process_tile_retries_total", "Повторно запрошенные плитки.", &MetricsSnapshot::retries);
+
+    out += "# HELP screen_composite_cache_total Обращения к кэшу композитов.\n";
+    out += "# TYPE screen_composite_cache_total counter\n";
+    appendCounter(out, "screen_composite_cache_total", "{result=\"hit\"}", total.cache_hits);
+    appendCounter(out, "screen_composite_cache_total", "{result=\"miss\"}", total.cache_misses);
+    return out;
+}
+
+int64_t percentileOfSorted(const std::vector<int64_t> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t rank = static_cast<size_t>(p * sorted.size() + 0.999999);
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+bool writeMetricsFile(const std::string &path)
+{
+    const std::string text = formatPrometheusMetrics();
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(text.data(), static_cast<qint64>(text.size())) != static_cast<qint64>(text.size()) ||
+        !file.commit())
+    {
+        std::cerr << "Ошибка записи файла метрик: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Этапы, время которых учитывается отдельно
+enum class MetricStage
+{
+    Dns,       // Разрешение имени (CURL)
+    Connect,   // TCP-соединение
+    Tls,       // Согласование TLS
+    FirstByte, // От готовности соединения до первого байта ответа
+    Transfer,  // Прием тела ответа
+    Decode,    // Декодирование плитки при сборке композита
+    Blit,      // Копирование плитки в композит
+    Encode,    // Кодирование PNG (предварительный композит)
+    Write,     // Запись на диск (IoStage, закрытие композита)
+    Count
+};
+
+const char *metricStageName(MetricStage stage);
+
+// Гистограмма задержек в микросекундах в духе HDR: до 16 мкс — точные значения,
+// дальше на каждую степень двойки по 8 корзин (погрешность не больше 12,5%).
+// Запись — один атомарный инкремент, без блокировок и выделения памяти.
+class LatencyHistogram
+{
+public:
+    static const int kSubBuckets = 8;
+    static const int kLinearBuckets = 16;
+    static const int kMaxExponent = 40; // ~12 суток, больше — в последнюю корзину
+    static const int kBucketCount = kLinearBuckets + (kMaxExponent - 3) * kSubBuckets;
+
+    void record(int64_t value_us)
+    {
+        m_counts[bucketFor(value_us)].fetch_add(1, std::memory_order_relaxed);
+        m_sum_us.fetch_add(static_cast<uint64_t>(value_us < 0 ? 0 : value_us), std::memory_order_relaxed);
+    }
+
+    // Моментальный снимок для выгрузки; накопление продолжается
+    struct Snapshot
+    {
+        uint64_t counts[kBucketCount] = {};
+        uint64_t total = 0;
+        uint64_t sum_us = 0;
+
+        void merge(const Snapshot &other);
+        int64_t valueAtQuantile(double q) const; // Середина корзины, мкс
+    };
+    void snapshot(Snapshot &out) const;
+
+    static int bucketFor(int64_t value_us)
+    {
+        if (value_us < kLinearBuckets)
+            return value_us < 0 ? 0 : static_cast<int>(value_us);
+        const int exponent = highestBit(static_cast<uint64_t>(value_us));
+        if (exponent > kMaxExponent)
+            return kBucketCount - 1;
+        const int sub = static_cast<int>(value_us >> (exponent - 3)) & (kSubBuckets - 1);
+        return kLinearBuckets + (exponent - 4) * kSubBuckets + sub;
+    }
+    static int64_t bucketLowerBound(int bucket);
+
+private:
+    static int highestBit(uint64_t value)
+    {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1)
+            ++bit;
+        return bit;
+#endif
+    }
+
+    std::atomic<uint64_t> m_counts[kBucketCount] = {};
+    std::atomic<uint64_t> m_sum_us{0};
+};
+
+// Гистограммы этапов и счетчики одного объекта (или процесса в целом)
+struct StageMetrics
+{
+    LatencyHistogram stages[static_cast<int>(MetricStage::Count)];
+    std::atomic<uint64_t> tiles_ok{0};
+    std::atomic<uint64_t> tiles_failed{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> retries{0};     // Повторно запрошенных плиток
+    std::atomic<uint64_t> cache_hits{0};  // Композиты, выданные из кэша
+    std::atomic<uint64_t> cache_misses{0};
+
+    void record(MetricStage stage, int64_t value_us) { stages[static_cast<int>(stage)].record(value_us); }
+};
+
+inline int64_t monotonicUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Значение перцентиля p (0..1) по упорядоченной по возрастанию выборке; 0 для пустой.
+// Ранг — наименьший, покрывающий долю p (без интерполяции)
+int64_t percentileOfSorted(const std::vector<int64_t> &sorted, double p);
+
+// Метрики объекта по имени; ссылка действительна до конца работы процесса.
+// Поиск под мьютексом — вызывать раз на захват, а не на плитку.
+StageMetrics &objectMetrics(const std::string &object_name);
+
+// Метрики без привязки к объекту (запись IoStage, кэш композитов)
+StageMetrics &processMetrics();
+
+// Все метрики в текстовом формате Prometheus: по каждому объекту (метка object)
+// и суммарно по процессу — в отдельных семействах screen_process_*
+std::string formatPrometheusMetrics();
+
+// Атомарно записывает метрики в файл (для textfile-сборщика node_exporter и т.п.)
+bool writeMetricsFile(const std::string &path);
+
+#endif // METRICS_H
@@ -0,0 +1,343 @@
+#include "objectimport.h"
+#include "captureconfig.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+// Сообщения о неверных строках: при тысячах ошибок в журнал попадают только первые
+const size_t kMaxReportedRejects = 20;
+
+void reportReject(ObjectImportResult &result, const std::string &where, const std::string &reason)
+{
+    if (result.rejected < kMaxReportedRejects)
+        std::cerr << "Импорт: " << where << ": " << reason << ", пропуск." << std::endl;
+    ++result.rejected;
+}
+
+enum CsvColumn
+{
+    ColName,
+    ColLat,
+    ColLon,
+    ColRadius,
+    ColSaveDirectory,
+    ColIntervalMin,
+    ColStartTime,
+    ColEndTime,
+    ColPriority,
+    ColBurst,
+    ColArchive,
+    ColLazyComposite,
+    ColCount
+};
+
+const std::array<const char *, ColCount> kCsvColumnNames = {
+    "name", "lat", "lon", "radius_km", "save_directory", "interval_min",
+    "start_time", "end_time", "priority", "burst", "archive", "lazy_composite"};
+
+// Разбивает строку CSV на поля; кавычки снимаются, "" внутри кавычек — одна кавычка
+void splitCsvLine(const char *begin, const char *end, char separator, std::vector<std::string> &fields)
+{
+    fields.clear();
+    std::string field;
+    bool quoted = false;
+    for (const char *p = begin; p < end; ++p)
+    {
+        const char c = *p;
+        if (quoted)
+        {
+            if (c == '"')
+            {
+                if (p + 1 < end && p[1] == '"')
+                {
+                    field += '"';
+                    ++p;
+                }
+                else
+                {
+                    quoted = false;
+                }
+            }
+            else
+            {
+                field += c;
+            }
+        }
+        else if (c == '"')
+        {
+            quoted = true;
+        }
+        else if (c == separator)
+        {
+            fields.push_back(std::move(field));
+            field.clear();
+        }
+        else
+        {
+            field += c;
+        }
+    }
+    fields.push_back(std::move(field));
+    for (std::string &f : fields)
+    {
+        const size_t first = f.find_first_not_of(" \t");
+        const size_t last = f.find_last_not_of(" \t");
+        f = first == std::string::npos ? std::string() : f.substr(first, last - first + 1);
+    }
+}
+
+// Число в C-локали; при разделителе ';' допускается и десятичная запятая
+bool parseDouble(std::string text, double &out)
+{
+    for (char &c : text)
+    {
+        if (c == ',')
+            c = '.';
+    }
+    if (text.empty())
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    out = std::strtod(text.c_str(), &end);
+    return errno == 0 && end == text.c_str() + text.size();
+}
+
+bool parseInt(const std::string &text, int &out)
+{
+    if (text.empty())
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    const long value = std::strtol(text.c_str(), &end, 10);
+    if (errno != 0 || end != text.c_str() + text.size() || value < INT_MIN || value > INT_MAX)
+        return false;
+    out = static_cast<int>(value);
+    return true;
+}
+
+bool parseFlag(const std::string &text)
+{
+    return text == "1" || text == "true" || text == "yes" || text == "да" || text == "+";
+}
+
+bool importCsv(const QByteArray &data,
+               const std::string &base_directory,
+               const std::unordered_set<std::string> &existing_names,
+               std::unordered_set<std::string> &seen,
+               std::vector<MapObject> &out,
+               ObjectImportResult &result)
+{
+    const char *p = data.constData();
+    const char *end = p + data.size();
+    if (end - p >= 3 && static_cast<unsigned char>(p[0]) == 0xEF && static_cast<unsigned char>(p[1]) == 0xBB && static_cast<unsigned char>(p[2]) == 0xBF)
+        p += 3; // BOM
+
+    const char *first_line_end = p;
+    while (first_line_end < end && *first_line_end != '\n')
+        ++first_line_end;
+    char separator = ',';
+    for (const char *q = p; q < first_line_end; ++q)
+    {
+        if (*q == ';')
+        {
+            separator = ';';
+            break;
+        }
+    }
+
+    std::array<int, ColCount> column_of;
+    for (int c = 0; c < ColCount; ++c)
+        column_of[c] = c;
+
+    out.reserve(out.size() + static_cast<size_t>(std::count(p, end, '\n')) + 1);
+
+    std::vector<std::string> fields;
+    bool first_line = true;
+    size_t line_number = 0;
+    while (p < end)
+    {
+        const char *line_end = p;
+        while (line_end < end && *line_end != '\n')
+            ++line_end;
+        const char *content_end = line_end;
+        if (content_end > p && content_end[-1] == '\r')
+            --content_end;
+        const char *line_begin = p;
+        p = line_end < end ? line_end + 1 : end;
+        ++line_number;
+        if (content_end == line_begin || *line_begin == '#')
+            continue;
+
+        splitCsvLine(line_begin, content_end, separator, fields);
+        if (first_line)
+        {
+            first_line = false;
+            // Заголовок узнается по именам колонок, а не по неверному числу: иначе строка
+            // данных с опечаткой в широте съела бы порядок колонок всего файла
+            const bool header = std::any_of(fields.begin(), fields.end(), [](const std::string &f)
+                                            { return std::find_if(kCsvColumnNames.begin(), kCsvColumnNames.end(), [&f](const char *column)
+                                                                  { return f == column; }) != kCsvColumnNames.end(); });
+            if (header)
+            {
+                // Заголовок: колонки по именам, неизвестные пропускаются
+                column_of.fill(-1);
+                for (size_t i = 0; i < fields.size(); ++i)
+                {
+                    for (int c = 0; c < ColCount; ++c)
+                    {
+                        if (fields[i] == kCsvColumnNames[c])
+                            column_of[c] = static_cast<int>(i);
+                    }
+                }
+                if (column_of[ColName] < 0 || column_of[ColLat] < 0 || column_of[ColLon] < 0 || column_of[ColRadius] < 0)
+                {
+                    std::cerr << "Импорт: в заголовке CSV нет обязательных колонок name, lat, lon, radius_km." << std::endl;
+                    return false;
+                }
+                continue;
+            }
+        }
+
+        auto field = [&](int column) -> const std::string &
+        {
+            static const std::string empty;
+            const int i = column_of[column];
+            return i >= 0 && i < static_cast<int>(fields.size()) ? fields[i] : empty;
+        };
+        auto reject = [&](const std::string &reason)
+        {
+            reportReject(result, "строка " + std::to_string(line_number), reason);
+        };
+
+        const std::string &name = field(ColName);
+        double lat = 0.0;
+        double lon = 0.0;
+        int radius = 0;
+        if (!parseDouble(field(ColLat), lat) || !parseDouble(field(ColLon), lon) || !parseInt(field(ColRadius), radius))
+        {
+            reject("неверные широта, долгота или радиус");
+            continue;
+        }
+        int interval_min = 0;
+        int interval_sec = 0;
+        if (!field(ColIntervalMin).empty() &&
+            (!parseInt(field(ColIntervalMin), interval_min) || !intervalMinutesToSec(interval_min, interval_sec)))
+        {
+            reject("неверный интервал съемки");
+            continue;
+        }
+        int priority = 0;
+        if (!field(ColPriority).empty() && !parseInt(field(ColPriority), priority))
+        {
+            reject("неверный приоритет");
+            continue;
+        }
+
+        std::string save_directory = field(ColSaveDirectory);
+        if (save_directory.empty())
+            save_directory = base_directory + "/" + name;
+        MapObject obj(lat, lon, radius, name, std::move(save_directory));
+        obj.capture_interval_sec = interval_sec;
+        obj.start_time = field(ColStartTime);
+        obj.end_time = field(ColEndTime);
+        obj.priority = priority;
+        obj.burst_capture = parseFlag(field(ColBurst));
+        obj.archive_captures = parseFlag(field(ColArchive));
+        obj.lazy_composite = parseFlag(field(ColLazyComposite));
+        std::string reason;
+        if (!validateMapObject(obj, reason))
+        {
+            reject(reason);
+            continue;
+        }
+        if (existing_names.count(name) || !seen.insert(name).second)
+        {
+            ++result.duplicates;
+            continue;
+        }
+        out.push_back(std::move(obj));
+        ++result.imported;
+    }
+    return true;
+}
+
+bool importJson(const QByteArray &data,
+                const std::string &path,
+                const std::string &base_directory,
+                const std::unordered_set<std::string> &existing_names,
+                std::unordered_set<std::string> &seen,
+                std::vector<MapObject> &out,
+                ObjectImportResult &result)
+{
+    QJsonParseError parse_error;
+    const QJsonDocument document = QJsonDocument::fromJson(data, &parse_error);
+    if (parse_error.error != QJsonParseError::NoError)
+    {
+        std::cerr << "Импорт: ошибка разбора " << path << ": " << parse_error.errorString().toStdString()
+                  << " (смещение " << parse_error.offset << ")" << std::endl;
+        return false;
+    }
+    const QJsonArray items = document.isArray() ? document.array() : document.object().value("objects").toArray();
+    out.reserve(out.size() + items.size());
+    for (int i = 0; i < items.size(); ++i)
+    {
+        const QJsonObject item = items.at(i).toObject();
+        const std::string name = item.value("name").toString().trimmed().toStdString();
+        if (!name.empty() && (existing_names.count(name) || seen.count(name)))
+        {
+            ++result.duplicates;
+            continue;
+        }
+        std::string reason;
+        if (!mapObjectFromJson(item, base_directory, out, reason))
+        {
+            reportReject(result, "элемент #" + std::to_string(i + 1), reason);
+            continue;
+        }
+        seen.insert(out.back().name);
+        ++result.imported;
+    }
+    return true;
+}
+
+} // namespace
+
+bool importMapObjects(const std::string &path,
+                      const std::string &base_directory,
+                      const std::unordered_set<std::string> &existing_names,
+                      std::vector<MapObject> &out,
+                      ObjectImportResult &result)
+{
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        std::cerr << "Импорт: не удалось открыть файл " << path << std::endl;
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    file.close();
+
+    result = ObjectImportResult();
+    std::unordered_set<std::string> seen;
+    const bool ok = QFileInfo(QString::fromStdString(path)).suffix().toLower() == "json"
+                        ? importJson(data, path, base_directory, existing_names, seen, out, result)
+                        : importCsv(data, base_directory, existing_names, seen, out, result);
+    if (ok)
+        std::cout << "Импорт из " << path << ": добавлено " << result.imported << ", повторов " << result.duplicates
+                  << ", с ошибками " << result.rejected << "." << std::endl;
+    return ok;
+}
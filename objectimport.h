@@ -0,0 +1,39 @@
+#ifndef OBJECTIMPORT_H
+#define OBJECTIMPORT_H
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "MapObject.h"
+
+// Итог загрузки списка объектов из файла
+struct ObjectImportResult
+{
+    size_t imported = 0;   // Добавлено в out
+    size_t duplicates = 0; // Пропущено: имя уже есть в списке или встречалось в файле раньше
+    size_t rejected = 0;   // Пропущено: строка или элемент с неверными параметрами
+};
+
+// Загружает объекты из CSV или JSON (по расширению .json, иначе CSV).
+//
+// JSON — массив объектов либо документ конфигурации с полем "objects",
+// элементы в формате captureconfig.h.
+//
+// CSV — разделитель ';' или ',' (определяется по первой строке), поля в кавычках допускаются.
+// Первая строка считается заголовком, если в ней есть хотя бы одно из имен колонок:
+//   name, lat, lon, radius_km, save_directory, interval_min, start_time, end_time,
+//   priority, burst, archive, lazy_composite
+// Без заголовка колонки идут в этом порядке; обязательны первые четыре.
+// Строки CSV и элементы JSON проверяются одинаково (validateMapObject в captureconfig.h).
+//
+// Пустой save_directory заменяется на <base_directory>/<name>. Имена из existing_names
+// и повторы внутри файла пропускаются (проверка по хешу). Возвращает false, только
+// если файл не удалось прочитать или разобрать целиком.
+bool importMapObjects(const std::string &path,
+                      const std::string &base_directory,
+                      const std::unordered_set<std::string> &existing_names,
+                      std::vector<MapObject> &out,
+                      ObjectImportResult &result);
+
+#endif // OBJECTIMPORT_H
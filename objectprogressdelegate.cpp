@@ -0,0 +1,47 @@
+#include "objectprogressdelegate.h"
+#include "mapobjectmodel.h"
+
+#include <QColor>
+#include <QPainter>
+
+namespace
+{
+    const int kBarWidth = 120;
+    const int kBarMargin = 3;
+}
+
+ObjectProgressDelegate::ObjectProgressDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+void ObjectProgressDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    const QVariant progress = index.data(MapObjectListModel::ProgressRole);
+    if (!progress.isValid())
+    {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    // Текст сдвигается влево, справа — полоса хода захвата
+    QStyleOptionViewItem text_option(option);
+    text_option.rect.setRight(option.rect.right() - kBarWidth - 2 * kBarMargin);
+    QStyledItemDelegate::paint(painter, text_option, index);
+
+    const int percent = progress.toInt();
+    const bool failed = index.data(MapObjectListModel::ProgressFailedRole).toBool();
+    const QRect bar(option.rect.right() - kBarWidth - kBarMargin, option.rect.top() + kBarMargin,
+                    kBarWidth, option.rect.height() - 2 * kBarMargin);
+    QRect filled(bar);
+    filled.setWidth(bar.width() * percent / 100);
+
+    painter->save();
+    painter->fillRect(bar, QColor(230, 230, 230));
+    painter->fillRect(filled, failed ? QColor(230, 160, 60) : QColor(80, 170, 90));
+    painter->setPen(QColor(120, 120, 120));
+    painter->drawRect(bar.adjusted(0, 0, -1, -1));
+    painter->setPen(QColor(20, 20, 20));
+    painter->drawText(bar, Qt::AlignCenter, QString("%1%").arg(percent));
+    painter->restore();
+}
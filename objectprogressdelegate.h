@@ -0,0 +1,18 @@
+#ifndef OBJECTPROGRESSDELEGATE_H
+#define OBJECTPROGRESSDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// Строка списка объектов с полосой хода захвата справа (MapObjectListModel::ProgressRole).
+// Полоса рисуется только для видимых строк и только пока идет захват объекта.
+class ObjectProgressDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit ObjectProgressDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+};
+
+#endif // OBJECTPROGRESSDELEGATE_H
@@ -0,0 +1,62 @@
+#include "progresschannel.h"
+
+ProgressChannel::ProgressChannel(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    m_cells.reset(new Cell[size]);
+    m_mask = size - 1;
+    for (size_t i = 0; i < size; ++i)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool ProgressChannel::push(const ProgressEvent &event)
+{
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell &cell = m_cells[pos & m_mask];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            // Ячейка свободна: занимаем позицию, если ее не опередил другой писатель
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                cell.event = event;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            // Читатель не успевает: событие теряется, поток загрузки не ждет
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t ProgressChannel::drain(std::vector<ProgressEvent> &out, size_t max_events)
+{
+    size_t taken = 0;
+    size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    while (taken < max_events)
+    {
+        Cell &cell = m_cells[pos & m_mask];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0)
+            break; // Ячейка еще не записана
+        out.push_back(cell.event);
+        cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+        ++pos;
+        ++taken;
+    }
+    m_dequeue_pos.store(pos, std::memory_order_relaxed);
+    return taken;
+}
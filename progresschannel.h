@@ -0,0 +1,63 @@
+#ifndef PROGRESSCHANNEL_H
+#define PROGRESSCHANNEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Событие хода захвата для окна программы
+struct ProgressEvent
+{
+    enum Kind : uint8_t
+    {
+        ObjectStarted, // value — сколько плиток объекта будет загружено (без взятых из журнала)
+        TileDone,      // tile, ok, bytes, latency_ms
+        ObjectDone     // value — сколько плиток не получено, ok — результат сохранен
+    };
+
+    Kind kind = TileDone;
+    bool ok = false;
+    uint32_t object_index = 0;
+    int32_t tile = -1;
+    uint32_t value = 0;
+    uint32_t bytes = 0;
+    int32_t latency_ms = 0;
+};
+
+// Ограниченная кольцевая очередь событий без блокировок (по схеме Вьюкова):
+// пишут потоки загрузки, читает один поток окна по таймеру.
+// push никогда не ждет: при заполненной очереди событие отбрасывается и учитывается в dropped().
+class ProgressChannel
+{
+public:
+    // Емкость округляется вверх до степени двойки
+    explicit ProgressChannel(size_t capacity = 16384);
+
+    ProgressChannel(const ProgressChannel &) = delete;
+    ProgressChannel &operator=(const ProgressChannel &) = delete;
+
+    bool push(const ProgressEvent &event);
+
+    // Забирает до max_events событий в out (дописывая), возвращает их число. Только один читатель.
+    size_t drain(std::vector<ProgressEvent> &out, size_t max_events);
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        ProgressEvent event;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    // Индексы записи и чтения в разных строках кэша: писатели и читатель не мешают друг другу
+    alignas(64) std::atomic<size_t> m_enqueue_pos{0};
+    alignas(64) std::atomic<size_t> m_dequeue_pos{0};
+    alignas(64) std::atomic<uint64_t> m_dropped{0};
+};
+
+#endif // PROGRESSCHANNEL_H
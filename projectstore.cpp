@@ -0,0 +1,290 @@
+#include "projectstore.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    const char kProjectMagic[8] = {'S', 'C', 'R', 'P', 'R', 'O', 'J', '\0'};
+
+    struct ProjectHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t object_count;
+        uint32_t record_size;
+        uint32_t strings_size;
+        int32_t capture_interval_sec;
+        int32_t max_concurrent_fetches;
+        int64_t max_bytes_per_sec;
+        int16_t start_minute;
+        int16_t end_minute;
+        uint32_t base_directory_offset;
+        uint32_t base_directory_length;
+        uint32_t reserved[3];
+    };
+
+    enum ProjectObjectFlags : uint32_t
+    {
+        FlagBurst = 1,
+        FlagArchive = 2,
+        FlagLazyComposite = 4
+    };
+
+    struct ProjectRecord
+    {
+        double latitude;
+        double longitude;
+        int32_t radius_km;
+        int32_t capture_interval_sec;
+        int32_t priority;
+        uint32_t flags;
+        int16_t start_minute; // -1 — общее окно
+        int16_t end_minute;
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint32_t directory_offset;
+        uint32_t directory_length;
+        uint32_t last_missing_tiles;
+        int64_t last_capture_ms;
+    };
+
+    static_assert(sizeof(ProjectHeader) == 64, "Неожиданный размер заголовка проекта");
+    static_assert(sizeof(ProjectRecord) == kProjectRecordSize, "Неожиданный размер записи объекта проекта");
+
+    // hh:mm -> минуты от полуночи; пустая строка — -1
+    int16_t toMinutes(const std::string &time)
+    {
+        int hour = 0;
+        int minute = 0;
+        if (time.empty() || std::sscanf(time.c_str(), "%d:%d", &hour, &minute) != 2)
+            return -1;
+        return static_cast<int16_t>(hour * 60 + minute);
+    }
+
+    std::string fromMinutes(int16_t minutes)
+    {
+        if (minutes < 0 || minutes >= 24 * 60)
+            return std::string();
+        char text[8];
+        std::snprintf(text, sizeof(text), "%02d:%02d", minutes / 60, minutes % 60);
+        return text;
+    }
+
+    // Таблица строк: строки дописываются подряд, запись хранит смещение и длину
+    struct StringTable
+    {
+        QByteArray data;
+
+        void add(const std::string &text, uint32_t &offset, uint32_t &length)
+        {
+            offset = static_cast<uint32_t>(data.size());
+            length = static_cast<uint32_t>(text.size());
+            data.append(text.data(), static_cast<int>(text.size()));
+        }
+    };
+}
+
+bool saveProject(const std::string &path, const CaptureConfig &project)
+{
+    StringTable strings;
+    std::vector<ProjectRecord> records(project.objects.size());
+    for (size_t i = 0; i < project.objects.size(); ++i)
+    {
+        const MapObject &obj = project.objects[i];
+        ProjectRecord &record = records[i];
+        std::memset(&record, 0, sizeof(record));
+        record.latitude = obj.latitude_center;
+        record.longitude = obj.longitude_center;
+        record.radius_km = obj.radius_km;
+        record.capture_interval_sec = obj.capture_interval_sec;
+        record.priority = obj.priority;
+        if (obj.burst_capture)
+            record.flags |= FlagBurst;
+        if (obj.archive_captures)
+            record.flags |= FlagArchive;
+        if (obj.lazy_composite)
+            record.flags |= FlagLazyComposite;
+        record.start_minute = toMinutes(obj.start_time);
+        record.end_minute = toMinutes(obj.end_time);
+        strings.add(obj.name, record.name_offset, record.name_length);
+        strings.add(obj.save_directory, record.directory_offset, record.directory_length);
+        record.last_missing_tiles = obj.last_missing_tiles;
+        record.last_capture_ms = obj.last_capture_ms;
+    }
+
+    ProjectHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kProjectMagic, sizeof(kProjectMagic));
+    header.version = kProjectFormatVersion;
+    header.object_count = static_cast<uint32_t>(records.size());
+    header.record_size = kProjectRecordSize;
+    header.capture_interval_sec = project.capture_interval_sec;
+    header.max_concurrent_fetches = project.fetch_budget.max_concurrent_fetches;
+    header.max_bytes_per_sec = project.fetch_budget.max_bytes_per_sec;
+    header.start_minute = toMinutes(project.start_time);
+    header.end_minute = toMinutes(project.end_time);
+    strings.add(project.base_directory, header.base_directory_offset, header.base_directory_length);
+    header.strings_size = static_cast<uint32_t>(strings.data.size());
+
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        std::cerr << "Ошибка открытия файла проекта для записи: " << path << std::endl;
+        return false;
+    }
+    const qint64 records_bytes = static_cast<qint64>(records.size() * sizeof(ProjectRecord));
+    if (file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header) ||
+        (records_bytes > 0 && file.write(reinterpret_cast<const char *>(records.data()), records_bytes) != records_bytes) ||
+        file.write(strings.data) != strings.data.size() ||
+        !file.commit())
+    {
+        std::cerr << "Ошибка записи файла проекта: " << path << std::endl;
+        file.cancelWriting();
+        return false;
+    }
+    return true;
+}
+
+bool loadProject(const std::string &path, CaptureConfig &project)
+{
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        std::cerr << "Не удалось открыть файл проекта: " << path << std::endl;
+        return false;
+    }
+    const qint64 size = file.size();
+    if (size < static_cast<qint64>(sizeof(ProjectHeader)))
+    {
+        std::cerr << "Файл проекта поврежден (короче заголовка): " << path << std::endl;
+        return false;
+    }
+    const uchar *map = file.map(0, size);
+    if (!map)
+    {
+        std::cerr << "Ошибка отображения файла проекта: " << path << std::endl;
+        return false;
+    }
+
+    ProjectHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    if (std::memcmp(header.magic, kProjectMagic, sizeof(kProjectMagic)) != 0 ||
+        header.version != kProjectFormatVersion || header.record_size != kProjectRecordSize)
+    {
+        std::cerr << "Неизвестный формат файла проекта: " << path << std::endl;
+        return false;
+    }
+    const uint64_t strings_offset = sizeof(ProjectHeader) + static_cast<uint64_t>(header.object_count) * kProjectRecordSize;
+    if (strings_offset + header.strings_size != static_cast<uint64_t>(size))
+    {
+        std::cerr << "Файл проекта поврежден (размер не сходится с заголовком): " << path << std::endl;
+        return false;
+    }
+    const char *strings = reinterpret_cast<const char *>(map) + strings_offset;
+    auto stringAt = [&](uint32_t offset, uint32_t length, std::string &out)
+    {
+        if (static_cast<uint64_t>(offset) + length > header.strings_size)
+            return false;
+        out.assign(strings + offset, length);
+        return true;
+    };
+
+    CaptureConfig loaded;
+    loaded.capture_interval_sec = header.capture_interval_sec;
+    loaded.fetch_budget.max_concurrent_fetches = header.max_concurrent_fetches;
+    loaded.fetch_budget.max_bytes_per_sec = header.max_bytes_per_sec;
+    loaded.start_time = fromMinutes(header.start_minute);
+    loaded.end_time = fromMinutes(header.end_minute);
+    if (!stringAt(header.base_directory_offset, header.base_directory_length, loaded.base_directory))
+    {
+        std::cerr << "Файл проекта поврежден (базовый каталог): " << path << std::endl;
+        return false;
+    }
+
+    loaded.objects.reserve(header.object_count);
+    const uchar *record_data = map + sizeof(ProjectHeader);
+    for (uint32_t i = 0; i < header.object_count; ++i)
+    {
+        ProjectRecord record;
+        std::memcpy(&record, record_data + static_cast<size_t>(i) * kProjectRecordSize, sizeof(record));
+        std::string name;
+        std::string directory;
+        if (!stringAt(record.name_offset, record.name_length, name) ||
+            !stringAt(record.directory_offset, record.directory_length, directory))
+        {
+            std::cerr << "Файл проекта поврежден (объект #" << i + 1 << "): " << path << std::endl;
+            return false;
+        }
+        MapObject obj(record.latitude, record.longitude, record.radius_km, std::move(name), std::move(directory));
+        obj.capture_interval_sec = record.capture_interval_sec;
+        obj.priority = record.priority;
+        obj.burst_capture = (record.flags & FlagBurst) != 0;
+        obj.archive_captures = (record.flags & FlagArchive) != 0;
+        obj.lazy_composite = (record.flags & FlagLazyComposite) != 0;
+        obj.start_time = fromMinutes(record.start_minute);
+        obj.end_time = fromMinutes(record.end_minute);
+        obj.last_missing_tiles = record.last_missing_tiles;
+        obj.last_capture_ms = record.last_capture_ms;
+        loaded.objects.push_back(std::move(obj));
+    }
+
+    project = std::move(loaded);
+    return true;
+}
+
+bool exportProjectJson(const std::string &path, const CaptureConfig &project)
+{
+    QJsonObject root;
+    root["start_time"] = QString::fromStdString(project.start_time);
+    root["end_time"] = QString::fromStdString(project.end_time);
+    root["interval_min"] = project.capture_interval_sec / 60;
+    root["max_concurrent_fetches"] = project.fetch_budget.max_concurrent_fetches;
+    root["max_bytes_per_sec"] = static_cast<qint64>(project.fetch_budget.max_bytes_per_sec);
+    root["base_directory"] = QString::fromStdString(project.base_directory);
+
+    QJsonArray objects;
+    for (const MapObject &obj : project.objects)
+    {
+        QJsonObject item;
+        item["name"] = QString::fromStdString(obj.name);
+        item["lat"] = obj.latitude_center;
+        item["lon"] = obj.longitude_center;
+        item["radius_km"] = obj.radius_km;
+        item["save_directory"] = QString::fromStdString(obj.save_directory);
+        if (obj.capture_interval_sec > 0)
+            item["interval_min"] = obj.capture_interval_sec / 60;
+        if (!obj.start_time.empty())
+            item["start_time"] = QString::fromStdString(obj.start_time);
+        if (!obj.end_time.empty())
+            item["end_time"] = QString::fromStdString(obj.end_time);
+        if (obj.priority != 0)
+            item["priority"] = obj.priority;
+        item["burst"] = obj.burst_capture;
+        item["archive"] = obj.archive_captures;
+        item["lazy_composite"] = obj.lazy_composite;
+        if (obj.last_capture_ms > 0)
+        {
+            item["last_capture_ms"] = static_cast<qint64>(obj.last_capture_ms);
+            item["last_missing_tiles"] = static_cast<qint64>(obj.last_missing_tiles);
+        }
+        objects.append(item);
+    }
+    root["objects"] = objects;
+
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson(QJsonDocument::Indented)) < 0 || !file.commit())
+    {
+        std::cerr << "Ошибка выгрузки проекта: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
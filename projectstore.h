@@ -0,0 +1,33 @@
+#ifndef PROJECTSTORE_H
+#define PROJECTSTORE_H
+
+#include <cstdint>
+#include <string>
+
+#include "captureconfig.h"
+
+// Проект — объекты, общее расписание, пути и состояние последнего захвата объектов —
+// в компактном двоичном файле. Файл читается через отображение в память
+// без разбора текста; сохраняется целиком через QSaveFile (атомарная замена).
+//
+// Формат (порядок байт машины, как в пакетах плиток и индексе архива):
+//   заголовок 64 байта: "SCRPROJ\0", версия, число объектов, размер записи объекта,
+//     размер таблицы строк, общие настройки (окно, интервал, бюджет загрузки), базовый каталог;
+//   записи объектов фиксированного размера (kProjectRecordSize);
+//   таблица строк UTF-8 (имена, каталоги), на которую ссылаются записи.
+const uint32_t kProjectFormatVersion = 1;
+const uint32_t kProjectRecordSize = 64;
+
+// Путь файла проекта по умолчанию (рядом с каталогом снимков)
+const char *const kDefaultProjectPath = "./screen.project";
+
+bool saveProject(const std::string &path, const CaptureConfig &project);
+
+// При ошибке пишет причину в std::cerr и возвращает false, project не меняется
+bool loadProject(const std::string &path, CaptureConfig &project);
+
+// Читаемая выгрузка в формате конфигурации screend (captureconfig.h);
+// состояние объектов добавляется полями last_capture_ms и last_missing_tiles
+bool exportProjectJson(const std::string &path, const CaptureConfig &project);
+
+#endif // PROJECTSTORE_H
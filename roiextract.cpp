@@ -0,0 +1,321 @@
+#include "roiextract.h"
+#include "capturearchive.h"
+#include "compositewriter.h"
+#include "tilebundle.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Композит одного захвата: файл (целиком или участок сегмента архива) и его метаданные
+    struct RoiSource
+    {
+        int64_t timestamp_ms = 0;
+        std::string data_path;
+        qint64 offset = 0;
+        qint64 size = -1;           // -1 — файл целиком
+        std::string metadata_path;  // Для отдельных файлов: <композит>.json
+        bool bundle = false;        // Пакет плиток (.tiles) вместо композита
+        QByteArray metadata;        // Для архива: содержимое записи метаданных
+    };
+
+    // Раскладка 24-битного BMP, как его пишет MappedBmpWriter
+    struct BmpLayout
+    {
+        int width = 0;
+        int height = 0;
+        int stride = 0;
+        bool bottom_up = true;
+        qint64 pixel_offset = 0;
+    };
+
+    uint32_t readLe32(const uchar *p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    bool parseBmpHeader(const uchar *data, qint64 size, BmpLayout &layout)
+    {
+        if (size < 54 || data[0] != 'B' || data[1] != 'M')
+            return false;
+        const int bpp = data[28] | (data[29] << 8);
+        const uint32_t compression = readLe32(data + 30);
+        if (bpp != 24 || compression != 0)
+            return false;
+        layout.pixel_offset = readLe32(data + 10);
+        layout.width = static_cast<int32_t>(readLe32(data + 18));
+        const int32_t height = static_cast<int32_t>(readLe32(data + 22));
+        layout.bottom_up = height > 0;
+        layout.height = height > 0 ? height : -height;
+        layout.stride = (layout.width * 3 + 3) & ~3;
+        return layout.width > 0 && layout.height > 0 &&
+               layout.pixel_offset + static_cast<qint64>(layout.stride) * layout.height <= size;
+    }
+
+    // Положение координаты вдоль оси композита в пикселях от начала сетки.
+    // Плитки охватывают span градусов с шагом step, поэтому внутри ячейки перевод линейный,
+    // а промежуток между плитками прижимается к краю ячейки.
+    double axisToPixels(double value, double origin, double step, double span, int cells, int cell_px)
+    {
+        const double rel = value - origin;
+        const int cell = std::min(cells - 1, std::max(0, static_cast<int>(std::floor(rel / step))));
+        const double frac = std::min(1.0, std::max(0.0, (rel - cell * step) / span));
+        return (cell + frac) * cell_px;
+    }
+
+    bool geoToPixels(const QJsonObject &metadata, const RoiQuery &query, const BmpLayout &layout, QRect &out)
+    {
+        const int grid_dim = metadata.value("grid_dim").toInt();
+        const double step_lat = metadata.value("grid_step_lat_deg").toDouble();
+        const double step_lon = metadata.value("grid_step_lon_deg").toDouble();
+        const double span = metadata.value("tile_span_deg").toDouble();
+        if (grid_dim <= 0 || step_lat <= 0.0 || step_lon <= 0.0 || span <= 0.0 || !metadata.contains("grid_origin_lat"))
+            return false;
+        const double origin_lat = metadata.value("grid_origin_lat").toDouble();
+        const double origin_lon = metadata.value("grid_origin_lon").toDouble();
+        const int tile_w = layout.width / grid_dim;
+        const int tile_h = layout.height / grid_dim;
+
+        const double x0 = axisToPixels(query.lon_min, origin_lon, step_lon, span, grid_dim, tile_w);
+        const double x1 = axisToPixels(query.lon_max, origin_lon, step_lon, span, grid_dim, tile_w);
+        // Нулевая строка сетки — нижняя строка композита
+        const double y0 = layout.height - axisToPixels(query.lat_max, origin_lat, step_lat, span, grid_dim, tile_h);
+        const double y1 = layout.height - axisToPixels(query.lat_min, origin_lat, step_lat, span, grid_dim, tile_h);
+        const int left = static_cast<int>(std::floor(std::min(x0, x1)));
+        const int top = static_cast<int>(std::floor(std::min(y0, y1)));
+        const int right = static_cast<int>(std::ceil(std::max(x0, x1)));
+        const int bottom = static_cast<int>(std::ceil(std::max(y0, y1)));
+        out = QRect(left, top, right - left, bottom - top);
+        return true;
+    }
+
+    std::vector<RoiSource> collectSources(const RoiQuery &query)
+    {
+        std::vector<RoiSource> sources;
+        const std::string safe_name = safeObjectName(query.object_name);
+
+        // Отдельные файлы: <имя>_<yyyy-MM-dd_HH-mm-ss>.bmp
+        QDir dir(QString::fromStdString(query.save_directory));
+        const QString prefix = QString::fromStdString(safe_name) + "_";
+        // и пакеты плиток отложенного композита: <имя>_<yyyy-MM-dd_HH-mm-ss>.tiles
+        const QStringList files = dir.entryList(QStringList() << prefix + "*.bmp" << prefix + "*.tiles", QDir::Files, QDir::Name);
+        for (const QString &file_name : files)
+        {
+            const QString stamp = QFileInfo(file_name).completeBaseName().mid(prefix.size());
+            const QDateTime time = QDateTime::fromString(stamp, "yyyy-MM-dd_HH-mm-ss");
+            if (!time.isValid())
+                continue; // Файл другого объекта с тем же префиксом имени
+            const int64_t timestamp_ms = time.toMSecsSinceEpoch();
+            if (timestamp_ms < query.from_ms || timestamp_ms > query.to_ms)
+                continue;
+            RoiSource source;
+            source.timestamp_ms = timestamp_ms;
+            source.data_path = dir.filePath(file_name).toStdString();
+            source.metadata_path = source.data_path + ".json";
+            source.bundle = file_name.endsWith(".tiles");
+            sources.push_back(std::move(source));
+        }
+
+        // Записи архива объекта; метаданные захвата идут с тем же временем
+        const std::string archive_dir = CaptureArchive::directoryFor(query.save_directory, query.object_name);
+        if (QDir(QString::fromStdString(archive_dir)).exists())
+        {
+            CaptureArchive archive(archive_dir);
+            const std::vector<ArchiveEntry> entries = archive.find(query.from_ms, query.to_ms);
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                const ArchiveEntry &entry = entries[i];
+                if (entry.kind != ArchiveEntryKind::Composite)
+                    continue;
+                RoiSource source;
+                source.timestamp_ms = entry.timestamp_ms;
+                source.data_path = archive_dir + "/" + entry.segment + ".seg";
+                source.offset = static_cast<qint64>(entry.offset);
+                source.size = static_cast<qint64>(entry.size);
+                for (size_t j = i + 1; j < entries.size() && entries[j].timestamp_ms == entry.timestamp_ms; ++j)
+                {
+                    if (entries[j].kind == ArchiveEntryKind::Metadata)
+                    {
+                        archive.read(entries[j], source.metadata);
+                        break;
+                    }
+                }
+                sources.push_back(std::move(source));
+            }
+        }
+
+        std::sort(sources.begin(), sources.end(), [](const RoiSource &a, const RoiSource &b)
+                  { return a.timestamp_ms < b.timestamp_ms; });
+        return sources;
+    }
+
+    // Область запроса в пикселях композита размера layout, обрезанная по его границам
+    bool resolveRect(const RoiSource &source, const RoiQuery &query, const BmpLayout &layout, QRect &rect)
+    {
+        rect = query.pixel_rect;
+        if (query.geographic)
+        {
+            QByteArray metadata_bytes = source.metadata;
+            if (metadata_bytes.isEmpty() && !source.metadata_path.empty())
+            {
+                QFile metadata_file(QString::fromStdString(source.metadata_path));
+                if (metadata_file.open(QIODevice::ReadOnly))
+                    metadata_bytes = metadata_file.readAll();
+            }
+            const QJsonObject metadata = QJsonDocument::fromJson(metadata_bytes).object();
+            if (!geoToPixels(metadata, query, layout, rect))
+            {
+                std::cerr << "Нет раскладки сетки в метаданных, область не определена: " << source.data_path << std::endl;
+                return false;
+            }
+        }
+        rect = rect.intersected(QRect(0, 0, layout.width, layout.height));
+        return !rect.isEmpty();
+    }
+
+    // Из пакета декодируются только плитки, пересекающие область
+    bool extractFromBundle(const RoiSource &source, const RoiQuery &query, RoiFrame &frame)
+    {
+        TileBundle bundle;
+        if (!bundle.open(source.data_path))
+            return false;
+        const int n = bundle.gridDim();
+        const int tile_w = bundle.tileSize().width();
+        const int tile_h = bundle.tileSize().height();
+        BmpLayout layout;
+        layout.width = n * tile_w;
+        layout.height = n * tile_h;
+        QRect rect;
+        if (tile_w <= 0 || tile_h <= 0 || !resolveRect(source, query, layout, rect))
+            return false;
+
+        frame.timestamp_ms = source.timestamp_ms;
+        frame.source = source.data_path;
+        frame.rect = rect;
+        frame.image = QImage(rect.width(), rect.height(), QImage::Format_RGB888);
+        frame.image.fill(kUnfilledCellColor);
+        for (int grid_row = 0; grid_row < n; ++grid_row)
+        {
+            for (int col = 0; col < n; ++col)
+            {
+                // Нулевая строка сетки — нижняя строка композита
+                const QRect cell_rect(col * tile_w, (n - 1 - grid_row) * tile_h, tile_w, tile_h);
+                const QRect part = cell_rect.intersected(rect);
+                if (part.isEmpty())
+                    continue;
+                const uchar *data = nullptr;
+                qint64 size = 0;
+                QImage tile;
+                if (!bundle.tile(grid_row * n + col, data, size) || !tile.loadFromData(data, static_cast<int>(size)))
+                    continue;
+                tile = tile.convertToFormat(QImage::Format_RGB888);
+                // Плитка может быть меньше ячейки (упрощенный захват, нестандартный ответ сервиса):
+                // копируется только то, что в ней есть, остаток ячейки остается цветом пропуска
+                const QRect copied = part.intersected(QRect(cell_rect.x(), cell_rect.y(), tile.width(), tile.height()));
+                for (int y = copied.top(); y <= copied.bottom(); ++y)
+                {
+                    const uchar *src = tile.constScanLine(y - cell_rect.y()) + (copied.x() - cell_rect.x()) * 3;
+                    uchar *dst = frame.image.scanLine(y - rect.y()) + (copied.x() - rect.x()) * 3;
+                    std::memcpy(dst, src, static_cast<size_t>(copied.width()) * 3);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool extractOne(const RoiSource &source, const RoiQuery &query, RoiFrame &frame)
+    {
+        if (source.bundle)
+            return extractFromBundle(source, query, frame);
+
+        QFile file(QString::fromStdString(source.data_path));
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            std::cerr << "Ошибка открытия композита: " << source.data_path << std::endl;
+            return false;
+        }
+        const qint64 size = source.size >= 0 ? source.size : file.size();
+        // Отображение читает с диска только страницы с нужными строками
+        const uchar *data = file.map(source.offset, size);
+        BmpLayout layout;
+        if (!data || !parseBmpHeader(data, size, layout))
+        {
+            std::cerr << "Не удалось прочитать композит: " << source.data_path << std::endl;
+            return false;
+        }
+
+        QRect rect;
+        if (!resolveRect(source, query, layout, rect))
+            return false;
+
+        frame.timestamp_ms = source.timestamp_ms;
+        frame.source = source.data_path;
+        frame.rect = rect;
+        frame.image = QImage(rect.width(), rect.height(), QImage::Format_RGB888);
+        const uchar *pixels = data + layout.pixel_offset;
+        for (int r = 0; r < rect.height(); ++r)
+        {
+            const int y = rect.y() + r;
+            const int src_row = layout.bottom_up ? layout.height - 1 - y : y;
+            const uchar *src = pixels + static_cast<qint64>(src_row) * layout.stride + rect.x() * 3;
+            uchar *dst = frame.image.scanLine(r);
+            for (int x = 0; x < rect.width(); ++x)
+            {
+                // BMP хранит BGR
+                dst[x * 3] = src[x * 3 + 2];
+                dst[x * 3 + 1] = src[x * 3 + 1];
+                dst[x * 3 + 2] = src[x * 3];
+            }
+        }
+        return true;
+    }
+}
+
+size_t extractRoi(const RoiQuery &query, const RoiSink &sink)
+{
+    const std::vector<RoiSource> sources = collectSources(query);
+    if (sources.empty())
+        return 0;
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> emitted{0};
+    std::mutex sink_mutex;
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < sources.size(); i = next++)
+        {
+            RoiFrame frame;
+            if (!extractOne(sources[i], query, frame))
+                continue;
+            std::lock_guard<std::mutex> lock(sink_mutex);
+            if (sink)
+                sink(frame);
+            ++emitted;
+        }
+    };
+
+    const size_t thread_count = std::min(sources.size(), static_cast<size_t>(std::max(1, query.threads)));
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < thread_count; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+    return emitted;
+}
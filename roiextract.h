@@ -0,0 +1,51 @@
+#ifndef ROIEXTRACT_H
+#define ROIEXTRACT_H
+
+#include <QImage>
+#include <QRect>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Запрос области интереса по сохраненным композитам одного объекта
+struct RoiQuery
+{
+    std::string save_directory; // Каталог объекта (MapObject::save_directory)
+    std::string object_name;
+    int64_t from_ms = 0;        // Интервал времени захвата, мс Unix-времени, включительно
+    int64_t to_ms = 0;
+
+    // Область: прямоугольник в пикселях композита либо географические границы.
+    // Географические границы переводятся в пиксели по раскладке сетки из метаданных захвата.
+    bool geographic = false;
+    QRect pixel_rect;
+    double lat_min = 0.0;
+    double lon_min = 0.0;
+    double lat_max = 0.0;
+    double lon_max = 0.0;
+
+    int threads = 4; // Сколько снимков обрабатывается одновременно
+};
+
+// Область одного захвата. image — RGB888, строки сверху вниз;
+// rect — положение области в композите.
+struct RoiFrame
+{
+    int64_t timestamp_ms = 0;
+    std::string source; // Файл композита или сегмент архива
+    QRect rect;
+    QImage image;
+};
+
+// Получатель кадров. Вызывается по мере готовности (порядок по времени не гарантируется),
+// вызовы сериализованы.
+using RoiSink = std::function<void(RoiFrame &frame)>;
+
+// Находит композиты объекта за интервал — отдельные BMP в save_directory и записи архива
+// объекта — и для каждого копирует из отображенного в память файла только строки
+// и столбцы, попадающие в область. Для пакетов плиток (отложенный композит)
+// декодируются только плитки, пересекающие область. Возвращает число выданных кадров.
+size_t extractRoi(const RoiQuery &query, const RoiSink &sink);
+
+#endif // ROIEXTRACT_H
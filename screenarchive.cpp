@@ -0,0 +1,150 @@
+// Утилита просмотра и выгрузки архива захватов объекта (capturearchive.h).
+//   screenarchive list   <каталог архива> [с] [по]
+//   screenarchive export <каталог архива> <время> <выходной файл> [meta]
+// Время — Unix-время в мс или локальная дата ISO (2024-05-01T12:00:00).
+// Композит выгружается как есть (BMP) или перекодируется по расширению выходного файла.
+
+#include "capturearchive.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QImage>
+#include <QSaveFile>
+#include <QString>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    const char *kindName(ArchiveEntryKind kind)
+    {
+        switch (kind)
+        {
+        case ArchiveEntryKind::Composite:
+            return "composite";
+        case ArchiveEntryKind::Tile:
+            return "tile";
+        case ArchiveEntryKind::Metadata:
+            return "metadata";
+        }
+        return "unknown";
+    }
+
+    void printUsage()
+    {
+        std::cerr << "Использование:\n"
+                  << "  screenarchive list   <каталог архива> [с] [по]\n"
+                  << "  screenarchive export <каталог архива> <время> <выходной файл> [meta]\n"
+                  << "Время: Unix-время в мс или дата ISO (2024-05-01T12:00:00)." << std::endl;
+    }
+
+    int listEntries(const CaptureArchive &archive, int64_t from_ms, int64_t to_ms)
+    {
+        const std::vector<ArchiveEntry> entries = archive.find(from_ms, to_ms);
+        for (const ArchiveEntry &entry : entries)
+        {
+            std::cout << entry.timestamp_ms << "\t"
+                      << QDateTime::fromMSecsSinceEpoch(entry.timestamp_ms).toString(Qt::ISODate).toStdString() << "\t"
+                      << kindName(entry.kind) << "\t" << entry.tile << "\t" << entry.size << std::endl;
+        }
+        std::cerr << "Записей: " << entries.size() << std::endl;
+        return 0;
+    }
+
+    int exportEntry(const CaptureArchive &archive, int64_t timestamp_ms, const QString &output, ArchiveEntryKind kind)
+    {
+        // Берется последняя подходящая запись не позже указанного времени: сначала за последние сутки,
+        // затем по всему архиву
+        const int64_t day_ms = 24LL * 3600 * 1000;
+        std::vector<ArchiveEntry> entries = archive.find(timestamp_ms - day_ms, timestamp_ms);
+        auto found = std::find_if(entries.rbegin(), entries.rend(), [kind](const ArchiveEntry &entry)
+                                  { return entry.kind == kind; });
+        if (found == entries.rend())
+        {
+            entries = archive.find(std::numeric_limits<int64_t>::min() / 2, timestamp_ms);
+            found = std::find_if(entries.rbegin(), entries.rend(), [kind](const ArchiveEntry &entry)
+                                 { return entry.kind == kind; });
+        }
+        if (found == entries.rend())
+        {
+            std::cerr << "Запись не найдена." << std::endl;
+            return 1;
+        }
+
+        QByteArray data;
+        if (!archive.read(*found, data))
+            return 1;
+
+        // Композит перекодируется, если расширение выходного файла не совпадает с BMP
+        const QString suffix = QFileInfo(output).suffix().toLower();
+        if (kind == ArchiveEntryKind::Composite && !suffix.isEmpty() && suffix != QLatin1String("bmp"))
+        {
+            QImage image;
+            if (!image.loadFromData(data, "BMP") || !image.save(output))
+            {
+                std::cerr << "Ошибка перекодирования записи в " << output.toStdString() << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            QSaveFile file(output);
+            if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+            {
+                std::cerr << "Ошибка записи файла: " << output.toStdString() << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "Выгружено: " << found->timestamp_ms << " (" << kindName(found->kind) << ") -> " << output.toStdString() << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return 2;
+    }
+    const std::string command = argv[1];
+    CaptureArchive archive(QString::fromLocal8Bit(argv[2]).toStdString());
+
+    if (command == "list")
+    {
+        int64_t from_ms = std::numeric_limits<int64_t>::min() / 2;
+        int64_t to_ms = std::numeric_limits<int64_t>::max() / 2;
+        if ((argc > 3 && !parseArchiveTime(argv[3], from_ms)) || (argc > 4 && !parseArchiveTime(argv[4], to_ms)))
+        {
+            std::cerr << "Неверное время." << std::endl;
+            return 2;
+        }
+        return listEntries(archive, from_ms, to_ms);
+    }
+
+    if (command == "export" && argc >= 5)
+    {
+        int64_t timestamp_ms = 0;
+        if (!parseArchiveTime(argv[3], timestamp_ms))
+        {
+            std::cerr << "Неверное время: " << argv[3] << std::endl;
+            return 2;
+        }
+        ArchiveEntryKind kind = ArchiveEntryKind::Composite;
+        if (argc > 5)
+        {
+            if (std::string(argv[5]) != "meta")
+            {
+                std::cerr << "Неизвестный вид записи: " << argv[5] << std::endl;
+                return 2;
+            }
+            kind = ArchiveEntryKind::Metadata;
+        }
+        return exportEntry(archive, timestamp_ms, QString::fromLocal8Bit(argv[4]), kind);
+    }
+
+    printUsage();
+    return 2;
+}
@@ -0,0 +1,547 @@
+// Микротесты горячих участков захвата (Screen_bench).
+//   Screen_bench [--grid 3,5,9] [--threads 1,2,4] [--tile-px 450] [--min-time-ms 300]
+//                [--filter подстрока] [--label метка] [--out results.json] [--tiles сеанс]
+// Тесты: построение сетки координат, сборка URL плиток, декодирование PNG,
+// сборка композита (QPainter и копирование в отображенный BMP), кодирование PNG/BMP.
+// Плитки синтетические, а с --tiles — настоящие ответы из записи сеанса (tilesession.h):
+// они сжаты и декодируются как в работе; размер плитки тогда берется из записи.
+// Каждый тест повторяется, пока суммарное время не превысит --min-time-ms; результат —
+// время одной операции (весь объем сетки) и пропускная способность в единицах теста.
+// --out записывает результаты в JSON для сравнения между версиями.
+
+#include "capturethread.h"
+#include "compositewriter.h"
+#include "tilesession.h"
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QPen>
+#include <QSaveFile>
+#include <QString>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef SCREEN_VERSION
+#define SCREEN_VERSION "unknown"
+#endif
+
+namespace
+{
+    struct BenchOptions
+    {
+        std::vector<int> grids = {3, 5, 9};
+        std::vector<int> threads;
+        int tile_px = 450;
+        int min_time_ms = 300;
+        std::string filter;
+        std::string label;
+        std::string out_path;
+        std::string tiles_path;
+    };
+
+    struct BenchResult
+    {
+        std::string name;
+        int grid = 0;
+        int threads = 1;
+        uint64_t iterations = 0;
+        double ns_per_op = 0;
+        double items_per_op = 0;
+        const char *unit = "";
+    };
+
+    // Плитки для тестов: ячейка i сетки берет плитку i % size()
+    struct TileSet
+    {
+        int tile_px = 0;
+        std::vector<QByteArray> pngs;  // Как при загрузке
+        std::vector<QImage> images;    // Те же плитки после декодирования
+        uint64_t png_bytes = 0;
+    };
+
+    // Исходные данные тестов одного размера сетки; готовятся вне замеров
+    struct BenchInput
+    {
+        int grid = 0;
+        int tile_px = 0;
+        const TileSet *tiles = nullptr;
+        MapObject object{0.0, 0.0, 0, "bench", ""};
+        std::vector<std::pair<double, double>> coords;
+        QImage composite;     // Композит сетки для тестов кодирования
+
+        const QByteArray &png(int cell) const { return tiles->pngs[static_cast<size_t>(cell) % tiles->pngs.size()]; }
+        const QImage &image(int cell) const { return tiles->images[static_cast<size_t>(cell) % tiles->images.size()]; }
+    };
+
+    // Результат, который компилятор не может выбросить вместе с замеряемым кодом
+    volatile size_t g_sink = 0;
+
+    std::vector<int> parseIntList(const std::string &text)
+    {
+        std::vector<int> values;
+        for (const QString &part : QString::fromStdString(text).split(','))
+        {
+            bool ok = false;
+            const int value = part.trimmed().toInt(&ok);
+            if (ok && value > 0)
+                values.push_back(value);
+        }
+        return values;
+    }
+
+    // Наименьший радиус, при котором сетка объекта на экваторе не меньше grid x grid
+    // (сетка всегда нечетная, четное значение фактически округляется вверх)
+    int radiusForGrid(int grid)
+    {
+        MapObject object(0.0, 0.0, 0, "bench", "");
+        std::vector<std::pair<double, double>> coords;
+        for (;; ++object.radius_km)
+        {
+            CaptureThread::generateCoordinatesForObject(object, coords);
+            if (coords.size() >= static_cast<size_t>(grid) * static_cast<size_t>(grid))
+                return object.radius_km;
+        }
+    }
+
+    // Плитка, похожая на карту: заливка, дороги и подписи дают PNG реального размера
+    QImage syntheticTile(int tile_px)
+    {
+        QImage tile(tile_px, tile_px, QImage::Format_RGB32);
+        tile.fill(qRgb(242, 239, 233));
+        {
+            QPainter painter(&tile);
+            for (int i = 0; i < 12; ++i)
+            {
+                const int offset = (i * 37) % tile_px;
+                painter.setPen(QPen(i % 3 == 0 ? QColor(255, 204, 0) : QColor(200, 200, 200), 2 + i % 4));
+                painter.drawLine(0, offset, tile_px, (offset * 7) % tile_px);
+                painter.drawLine(offset, 0, (offset * 5) % tile_px, tile_px);
+            }
+            painter.setPen(QColor(60, 60, 60));
+            for (int i = 0; i < 6; ++i)
+                painter.drawText((i * 71) % tile_px, 20 + (i * 53) % tile_px, QString("ул. %1").arg(i + 1));
+        }
+        return tile;
+    }
+
+    // Делит [0, count) на threads частей и выполняет body(begin, end) параллельно
+    void runParallel(int threads, int count, const std::function<void(int, int)> &body)
+    {
+        if (threads <= 1 || count <= 1)
+        {
+            body(0, count);
+            return;
+        }
+        const int parts = std::min(threads, count);
+        std::vector<std::thread> workers;
+        workers.reserve(parts - 1);
+        for (int t = 1; t < parts; ++t)
+        {
+            workers.emplace_back([&, t]()
+                                 { body(count * t / parts, count * (t + 1) / parts); });
+        }
+        body(0, count / parts);
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    // Прогрев, затем удвоение числа повторов, пока время не превысит min_time_ms
+    BenchResult measure(const BenchOptions &options, const std::string &name, int grid, int threads,
+                        double items_per_op, const char *unit, const std::function<void()> &op)
+    {
+        using Clock = std::chrono::steady_clock;
+        op();
+        const auto min_time = std::chrono::milliseconds(options.min_time_ms);
+        uint64_t batch = 1;
+        uint64_t iterations = 0;
+        Clock::duration elapsed{};
+        while (elapsed < min_time)
+        {
+            const auto started = Clock::now();
+            for (uint64_t i = 0; i < batch; ++i)
+                op();
+            elapsed += Clock::now() - started;
+            iterations += batch;
+            batch *= 2;
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.grid = grid;
+        result.threads = threads;
+        result.iterations = iterations;
+        result.ns_per_op = std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+        result.items_per_op = items_per_op;
+        result.unit = unit;
+        return result;
+    }
+
+    double itemsPerSec(const BenchResult &result)
+    {
+        return result.ns_per_op > 0 ? result.items_per_op * 1e9 / result.ns_per_op : 0.0;
+    }
+
+    // Синтетическая плитка или успешные ответы записи сеанса одного (первого) размера
+    bool prepareTiles(const BenchOptions &options, TileSet &tiles)
+    {
+        if (options.tiles_path.empty())
+        {
+            tiles.tile_px = options.tile_px;
+            tiles.images.push_back(syntheticTile(options.tile_px));
+            QByteArray png;
+            QBuffer buffer(&png);
+            if (!buffer.open(QIODevice::WriteOnly) || !tiles.images.back().save(&buffer, "PNG"))
+            {
+                std::cerr << "Ошибка кодирования тестовой плитки PNG." << std::endl;
+                return false;
+            }
+            tiles.png_bytes = static_cast<uint64_t>(png.size());
+            tiles.pngs.push_back(png);
+            return true;
+        }
+
+        TileSession session;
+        if (!loadTileSession(options.tiles_path, session))
+            return false;
+        // Декодированные плитки держатся в памяти; сотни разных плиток для тестов достаточно
+        const size_t kMaxTiles = 256;
+        for (const TileSessionEntry &entry : session.entries)
+        {
+            if (tiles.pngs.size() >= kMaxTiles)
+                break;
+            if (!entry.timing.ok)
+                continue;
+            const QByteArray png(entry.body.data(), static_cast<int>(entry.body.size()));
+            QImage image = QImage::fromData(png);
+            if (image.isNull() || image.width() != image.height() || (tiles.tile_px != 0 && image.width() != tiles.tile_px))
+                continue;
+            tiles.tile_px = image.width();
+            tiles.png_bytes += static_cast<uint64_t>(png.size());
+            tiles.pngs.push_back(png);
+            tiles.images.push_back(image);
+        }
+        if (tiles.pngs.empty())
+        {
+            std::cerr << "В записи сеанса нет декодируемых плиток: " << options.tiles_path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool prepareInput(BenchInput &input, int grid, const TileSet &tiles)
+    {
+        input.grid = grid;
+        input.tile_px = tiles.tile_px;
+        input.tiles = &tiles;
+        input.object.radius_km = radiusForGrid(grid);
+        CaptureThread::generateCoordinatesForObject(input.object, input.coords);
+        input.grid = static_cast<int>(std::lround(std::sqrt(static_cast<double>(input.coords.size()))));
+        const int tile_px = input.tile_px;
+
+        input.composite = QImage(input.grid * tile_px, input.grid * tile_px, QImage::Format_RGB32);
+        if (input.composite.isNull())
+        {
+            std::cerr << "Не хватает памяти под композит " << input.grid << "x" << input.grid << "." << std::endl;
+            return false;
+        }
+        QPainter painter(&input.composite);
+        for (int r = 0; r < input.grid; ++r)
+        {
+            for (int c = 0; c < input.grid; ++c)
+                painter.drawImage(c * tile_px, r * tile_px, input.image(r * input.grid + c));
+        }
+        return true;
+    }
+
+    bool selected(const BenchOptions &options, const char *name)
+    {
+        return options.filter.empty() || std::string(name).find(options.filter) != std::string::npos;
+    }
+
+    void runGrid(const BenchOptions &options, const BenchInput &input, std::vector<BenchResult> &results)
+    {
+        const int grid = input.grid;
+        const int cells = grid * grid;
+        const int tile_px = input.tile_px;
+
+        if (selected(options, "grid_generate"))
+        {
+            std::vector<std::pair<double, double>> coords;
+            results.push_back(measure(options, "grid_generate", grid, 1, cells, "coords", [&]()
+                                      {
+                CaptureThread::generateCoordinatesForObject(input.object, coords);
+                g_sink = g_sink + coords.size(); }));
+        }
+
+        if (selected(options, "url_build"))
+        {
+            const std::string server_url = kDefaultTileServerUrl;
+            results.push_back(measure(options, "url_build", grid, 1, cells, "urls", [&]()
+                                      {
+                size_t length = 0;
+                for (const auto &coord : input.coords)
+                    length += buildTileUrl(server_url, coord, tile_px).size();
+                g_sink = g_sink + length; }));
+        }
+
+        for (int threads : options.threads)
+        {
+            if (selected(options, "tile_decode"))
+            {
+                results.push_back(measure(options, "tile_decode", grid, threads, cells, "tiles", [&]()
+                                          { runParallel(threads, cells, [&](int begin, int end)
+                                                        {
+                    QImage tile;
+                    for (int i = begin; i < end; ++i)
+                    {
+                        const QByteArray &png = input.png(i);
+                        QByteArray bytes = QByteArray::fromRawData(png.constData(), png.size());
+                        QBuffer buffer(&bytes);
+                        buffer.open(QIODevice::ReadOnly);
+                        QImageReader reader(&buffer);
+                        reader.read(&tile);
+                    }
+                    g_sink = g_sink + static_cast<size_t>(tile.width()); }); }));
+            }
+
+            if (selected(options, "compose_mapped"))
+            {
+                // Копирование готовых плиток в отображенный BMP, потоки делят строки сетки
+                const QString bmp_path = QDir::temp().absoluteFilePath(QString("screen_bench_%1.bmp").arg(grid));
+                MappedBmpWriter writer;
+                if (writer.open(bmp_path.toStdString(), grid * tile_px, grid * tile_px))
+                {
+                    results.push_back(measure(options, "compose_mapped", grid, threads, cells, "tiles", [&]()
+                                              { runParallel(threads, grid, [&](int row_begin, int row_end)
+                                                            {
+                        for (int r = row_begin; r < row_end; ++r)
+                        {
+                            for (int c = 0; c < grid; ++c)
+                                writer.blitTile(input.image(r * grid + c), c * tile_px, r * tile_px);
+                        } }); }));
+                    writer.discard();
+                }
+            }
+
+            if (selected(options, "compose_mapped_decode"))
+            {
+                // Полный путь сборки: декодирование плитки из памяти и копирование, как в combine
+                const QString bmp_path = QDir::temp().absoluteFilePath(QString("screen_bench_%1_decode.bmp").arg(grid));
+                MappedBmpWriter writer;
+                if (writer.open(bmp_path.toStdString(), grid * tile_px, grid * tile_px))
+                {
+                    results.push_back(measure(options, "compose_mapped_decode", grid, threads, cells, "tiles", [&]()
+                                              { runParallel(threads, grid, [&](int row_begin, int row_end)
+                                                            {
+                        QImage tile;
+                        for (int r = row_begin; r < row_end; ++r)
+                        {
+                            for (int c = 0; c < grid; ++c)
+                            {
+                                const QByteArray &png = input.png(r * grid + c);
+                                QByteArray bytes = QByteArray::fromRawData(png.constData(), png.size());
+                                QBuffer buffer(&bytes);
+                                buffer.open(QIODevice::ReadOnly);
+                                QImageReader reader(&buffer);
+                                if (reader.read(&tile))
+                                    writer.blitTile(tile, c * tile_px, r * tile_px);
+                            }
+                        } }); }));
+                    writer.discard();
+                }
+            }
+        }
+
+        if (selected(options, "compose_qpainter"))
+        {
+            // Прежняя сборка: QPainter поверх QImage в памяти (однопоточная)
+            QImage composite(grid * tile_px, grid * tile_px, QImage::Format_RGB32);
+            results.push_back(measure(options, "compose_qpainter", grid, 1, cells, "tiles", [&]()
+                                      {
+                composite.fill(Qt::white);
+                QPainter painter(&composite);
+                for (int r = 0; r < grid; ++r)
+                {
+                    for (int c = 0; c < grid; ++c)
+                        painter.drawImage(c * tile_px, r * tile_px, input.image(r * grid + c));
+                } }));
+        }
+
+        const double pixels = static_cast<double>(input.composite.width()) * input.composite.height();
+        if (selected(options, "encode_png"))
+        {
+            results.push_back(measure(options, "encode_png", grid, 1, pixels, "pixels", [&]()
+                                      {
+                QByteArray encoded;
+                QBuffer buffer(&encoded);
+                buffer.open(QIODevice::WriteOnly);
+                input.composite.save(&buffer, "PNG");
+                g_sink = g_sink + static_cast<size_t>(encoded.size()); }));
+        }
+        if (selected(options, "encode_bmp"))
+        {
+            results.push_back(measure(options, "encode_bmp", grid, 1, pixels, "pixels", [&]()
+                                      {
+                QByteArray encoded;
+                QBuffer buffer(&encoded);
+                buffer.open(QIODevice::WriteOnly);
+                input.composite.save(&buffer, "BMP");
+                g_sink = g_sink + static_cast<size_t>(encoded.size()); }));
+        }
+    }
+
+    void printResult(const BenchResult &result)
+    {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-22s grid=%-3d threads=%-3d %14.0f нс/оп  %14.1f %s/с  (%llu повт.)",
+                      result.name.c_str(), result.grid, result.threads, result.ns_per_op, itemsPerSec(result),
+                      result.unit, static_cast<unsigned long long>(result.iterations));
+        std::cout << line << std::endl;
+    }
+
+    bool writeResults(const BenchOptions &options, const TileSet &tiles, const std::vector<BenchResult> &results)
+    {
+        QJsonObject root;
+        root["version"] = QString(SCREEN_VERSION);
+        root["label"] = QString::fromStdString(options.label);
+        root["qt_version"] = QString(qVersion());
+        root["hardware_threads"] = static_cast<int>(std::thread::hardware_concurrency());
+        root["tile_px"] = tiles.tile_px;
+        root["tiles"] = options.tiles_path.empty() ? QString("synthetic") : QString::fromStdString(options.tiles_path);
+        root["tile_count"] = static_cast<int>(tiles.pngs.size());
+        root["tile_png_avg_bytes"] = static_cast<double>(tiles.png_bytes) / static_cast<double>(tiles.pngs.size());
+        root["min_time_ms"] = options.min_time_ms;
+        root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+
+        QJsonArray items;
+        for (const BenchResult &result : results)
+        {
+            QJsonObject item;
+            item["name"] = QString::fromStdString(result.name);
+            item["grid"] = result.grid;
+            item["threads"] = result.threads;
+            item["iterations"] = static_cast<double>(result.iterations);
+            item["ns_per_op"] = result.ns_per_op;
+            item["items_per_op"] = result.items_per_op;
+            item["items_per_sec"] = itemsPerSec(result);
+            item["unit"] = QString(result.unit);
+            items.append(item);
+        }
+        root["results"] = items;
+
+        const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+        QSaveFile file(QString::fromStdString(options.out_path));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit())
+        {
+            std::cerr << "Ошибка записи результатов: " << options.out_path << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+    const int hardware_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--grid" && i + 1 < argc)
+        {
+            options.grids = parseIntList(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            options.threads = parseIntList(argv[++i]);
+        }
+        else if (arg == "--tile-px" && i + 1 < argc)
+        {
+            options.tile_px = std::max(16, std::atoi(argv[++i]));
+        }
+        else if (arg == "--min-time-ms" && i + 1 < argc)
+        {
+            options.min_time_ms = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+        {
+            options.filter = argv[++i];
+        }
+        else if (arg == "--label" && i + 1 < argc)
+        {
+            options.label = argv[++i];
+        }
+        else if (arg == "--out" && i + 1 < argc)
+        {
+            options.out_path = argv[++i];
+        }
+        else if (arg == "--tiles" && i + 1 < argc)
+        {
+            options.tiles_path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Использование: Screen_bench [--grid 3,5,9] [--threads 1,2,4] [--tile-px 450] [--min-time-ms 300]"
+                         " [--filter подстрока] [--label метка] [--out results.json] [--tiles сеанс]" << std::endl;
+            return 2;
+        }
+    }
+    if (options.threads.empty())
+    {
+        // По умолчанию 1, 2, 4 ... до числа аппаратных потоков включительно
+        for (int threads = 1; threads < hardware_threads; threads *= 2)
+            options.threads.push_back(threads);
+        options.threads.push_back(hardware_threads);
+    }
+    if (options.grids.empty())
+    {
+        std::cerr << "Не задан ни один размер сетки." << std::endl;
+        return 2;
+    }
+
+    TileSet tiles;
+    if (!prepareTiles(options, tiles))
+        return 1;
+    std::cout << "Плитки: " << (options.tiles_path.empty() ? std::string("синтетическая") : options.tiles_path)
+              << ", " << tiles.pngs.size() << " шт. " << tiles.tile_px << " пикс., в среднем "
+              << tiles.png_bytes / tiles.pngs.size() << " байт PNG" << std::endl;
+
+    std::vector<BenchResult> results;
+    for (int grid : options.grids)
+    {
+        BenchInput input;
+        if (!prepareInput(input, grid, tiles))
+            return 1;
+        std::cout << "Сетка " << input.grid << "x" << input.grid << std::endl;
+        const size_t first = results.size();
+        runGrid(options, input, results);
+        for (size_t i = first; i < results.size(); ++i)
+            printResult(results[i]);
+    }
+
+    if (!options.out_path.empty())
+    {
+        if (!writeResults(options, tiles, results))
+            return 1;
+        std::cout << "Результаты записаны: " << options.out_path << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+# Движок захвата: общий для Screen, screend, Screen_bench, screenload, screenshard
+# и утилит screenarchive, screenroi, screencomposite
+SOURCES += \
+    $$PWD/capturethread.cpp \
+    $$PWD/MapObject.cpp \
+    $$PWD/compositewriter.cpp \
+    $$PWD/fetchpool.cpp \
+    $$PWD/capturescheduler.cpp \
+    $$PWD/captureclock.cpp \
+    $$PWD/burstfetch.cpp \
+    $$PWD/iostage.cpp \
+    $$PWD/capturearchive.cpp \
+    $$PWD/tilebundle.cpp \
+    $$PWD/captureconfig.cpp \
+    $$PWD/progresschannel.cpp \
+    $$PWD/asynclog.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/tracing.cpp \
+    $$PWD/tilesession.cpp \
+    $$PWD/tilejournal.cpp
+HEADERS += \
+    $$PWD/capturethread.h \
+    $$PWD/MapObject.h \
+    $$PWD/compositewriter.h \
+    $$PWD/fetchpool.h \
+    $$PWD/capturescheduler.h \
+    $$PWD/captureclock.h \
+    $$PWD/burstfetch.h \
+    $$PWD/iostage.h \
+    $$PWD/capturearchive.h \
+    $$PWD/tilebundle.h \
+    $$PWD/captureconfig.h \
+    $$PWD/progresschannel.h \
+    $$PWD/asynclog.h \
+    $$PWD/metrics.h \
+    $$PWD/tracing.h \
+    $$PWD/tilesession.h \
+    $$PWD/tilejournal.h
+INCLUDEPATH += $$PWD
+# Трассировка циклов захвата (tracing.h): qmake CONFIG+=screen_tracing
+screen_tracing: DEFINES += SCREEN_TRACING
@@ -0,0 +1,91 @@
+// Сборка композита по запросу из пакета плиток (отложенный композит, tilebundle.h).
+//   screencomposite <пакет.tiles> [выходной файл] [--cache-dir каталог] [--cache-mb N] [--metrics-file F]
+// Композит берется из кэша или собирается и кладется в кэш (по умолчанию
+// <каталог пакета>/composite_cache, 2048 МБ). Без выходного файла печатается путь в кэше;
+// с выходным файлом композит копируется или перекодируется по его расширению.
+// --metrics-file — записать время декодирования/копирования плиток и попадания в кэш
+// в формате Prometheus.
+
+#include "compositecache.h"
+#include "metrics.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QString>
+
+#include <algorithm>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Использование: screencomposite <пакет.tiles> [выходной файл] [--cache-dir каталог] [--cache-mb N] [--metrics-file F]" << std::endl;
+        return 2;
+    }
+
+    const QString bundle_path = QString::fromLocal8Bit(argv[1]);
+    QString output;
+    QString cache_dir = QFileInfo(bundle_path).absolutePath() + "/composite_cache";
+    int64_t cache_mb = 2048;
+    std::string metrics_file;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--cache-dir" && i + 1 < argc)
+        {
+            cache_dir = QString::fromLocal8Bit(argv[++i]);
+        }
+        else if (arg == "--cache-mb" && i + 1 < argc)
+        {
+            cache_mb = QString::fromLocal8Bit(argv[++i]).toLongLong();
+        }
+        else if (arg == "--metrics-file" && i + 1 < argc)
+        {
+            metrics_file = argv[++i];
+        }
+        else if (output.isEmpty())
+        {
+            output = QString::fromLocal8Bit(argv[i]);
+        }
+        else
+        {
+            std::cerr << "Неизвестный аргумент: " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    CompositeCache cache(cache_dir.toStdString(), std::max<int64_t>(0, cache_mb) * 1024 * 1024);
+    const std::string composite = cache.composite(bundle_path.toStdString());
+    if (!metrics_file.empty())
+        writeMetricsFile(metrics_file);
+    if (composite.empty())
+        return 1;
+    if (output.isEmpty())
+    {
+        std::cout << composite << std::endl;
+        return 0;
+    }
+
+    const QString composite_path = QString::fromStdString(composite);
+    const QString suffix = QFileInfo(output).suffix().toLower();
+    bool ok = false;
+    if (suffix == "bmp" || suffix.isEmpty())
+    {
+        QFile::remove(output);
+        ok = QFile::copy(composite_path, output);
+    }
+    else
+    {
+        QImage image(composite_path);
+        ok = !image.isNull() && image.save(output);
+    }
+    if (!ok)
+    {
+        std::cerr << "Ошибка записи композита: " << output.toStdString() << std::endl;
+        return 1;
+    }
+    std::cout << output.toStdString() << std::endl;
+    return 0;
+}
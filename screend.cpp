@@ -0,0 +1,374 @@
+// Захват без окна: объекты и расписание берутся из файла конфигурации (captureconfig.h).
+//   screend <конфигурация.json>
+// SIGINT/SIGTERM — остановка после завершения текущих загрузок;
+// SIGHUP — перечитать конфигурацию и перезапустить захват (при ошибке в файле
+// продолжается работа по прежней конфигурации).
+//
+//   screend --once <конфигурация.json>
+// Разовый проход (догрузка после простоя, внеплановая съемка): все объекты сразу
+// с максимальной пропускной способностью, без окна времени и интервала, затем итоги
+// и выход. Код возврата: 0 — все объекты получены полностью, 3 — часть объектов
+// неполная, 1 — ни один объект не получен полностью или ошибка конфигурации.
+//
+//   screend --simulate <конфигурация.json> [часов]
+// Прогон расписания на виртуальных часах (captureclock.h) с местной полуночи текущего дня,
+// по умолчанию 24 часа: плитки не загружаются, каждый открытый слот проверяется на окно
+// съемки и интервал объекта. Сутки для тысяч объектов проходят за доли секунды.
+// Код возврата: 0 — нарушений нет, 3 — есть слоты вне окна или чаще интервала.
+//
+// С "metrics_file" в конфигурации метрики (гистограммы этапов, счетчики плиток)
+// переписываются в этот файл каждые metrics_interval_sec секунд и при выходе.
+//
+// С "record_session" запросы плиток с ответами и временем записываются для
+// воспроизведения (screenload --replay, Screen_bench --tiles); файл начинается заново
+// при каждом запуске захвата, в том числе после SIGHUP.
+//
+// Захват объекта, прерванный остановкой или падением процесса, после перезапуска
+// продолжается с недостающих плиток по журналу рядом с временным каталогом (tilejournal.h),
+// пока не истек срок слота, в котором он начат. Просроченные журналы и каталоги удаляются при запуске.
+
+#include <QCoreApplication>
+#include <QTimer>
+
+#include "asynclog.h"
+#include "captureconfig.h"
+#include "capturethread.h"
+#include "metrics.h"
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+volatile std::sig_atomic_t g_stop_requested = 0;
+volatile std::sig_atomic_t g_reload_requested = 0;
+
+extern "C" void onStopSignal(int)
+{
+    g_stop_requested = 1;
+}
+
+extern "C" void onReloadSignal(int)
+{
+    g_reload_requested = 1;
+}
+
+// Запись сеанса, если она задана в конфигурации; при ошибке захват идет без записи
+void attachSessionRecorder(CaptureThread &thread, const CaptureConfig &config)
+{
+    if (config.record_session.empty())
+        return;
+    auto recorder = std::make_shared<TileSessionRecorder>();
+    if (!recorder->open(config.record_session))
+        return;
+    thread.setSessionRecorder(std::move(recorder));
+    std::cout << "Запись сеанса плиток: " << config.record_session << std::endl;
+}
+
+std::unique_ptr<CaptureThread> startCapture(const CaptureConfig &config)
+{
+    ensureDirectory(config.base_directory);
+    auto thread = std::make_unique<CaptureThread>(config.objects,
+                                                  config.capture_interval_sec,
+                                                  config.start_time,
+                                                  config.end_time,
+                                                  config.fetch_budget);
+    thread->setTileServerUrl(config.tile_server_url);
+    attachSessionRecorder(*thread, config);
+    thread->start();
+    std::cout << "Съемка начата: объектов " << config.objects.size()
+              << ", интервал " << config.capture_interval_sec / 60 << " мин, окно "
+              << config.start_time << "-" << config.end_time << "." << std::endl;
+    return thread;
+}
+
+// Дожидается завершения текущих загрузок и фоновой записи
+void stopCapture(std::unique_ptr<CaptureThread> &thread)
+{
+    if (!thread)
+        return;
+    thread->stop();
+    thread->wait();
+    thread.reset();
+    flushLogging();
+    std::cout << "Съемка остановлена." << std::endl;
+}
+
+void printRunSummary(CaptureRunStats stats)
+{
+    std::sort(stats.tile_latency_ms.begin(), stats.tile_latency_ms.end());
+    const size_t requests = stats.tile_requests_ok + stats.tile_requests_failed;
+    const double seconds = std::max(stats.elapsed_sec, 1e-3);
+    char line[256];
+    std::cout << "Итоги разового прохода:" << std::endl;
+    std::snprintf(line, sizeof(line), "  объектов: %zu, полностью: %zu, неполных: %zu",
+                  stats.objects, stats.objects - stats.objects_incomplete, stats.objects_incomplete);
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "  запросов плиток: %zu (ошибок %zu), не получено плиток: %zu",
+                  requests, stats.tile_requests_failed, stats.tiles_missing);
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "  время: %.1f с, %.1f плиток/с, %.2f МБ/с (%.1f МБ)",
+                  stats.elapsed_sec, stats.tile_requests_ok / seconds,
+                  stats.bytes / seconds / (1024.0 * 1024.0), stats.bytes / (1024.0 * 1024.0));
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "  задержка плитки: p50 %lld мс, p99 %lld мс, макс. %lld мс",
+                  static_cast<long long>(percentileOfSorted(stats.tile_latency_ms, 0.50)),
+                  static_cast<long long>(percentileOfSorted(stats.tile_latency_ms, 0.99)),
+                  static_cast<long long>(stats.tile_latency_ms.empty() ? 0 : stats.tile_latency_ms.back()));
+    std::cout << line << std::endl;
+}
+
+// Разовый проход без цикла событий: поток захвата сам завершается после последнего объекта
+int runOnce(const CaptureConfig &config)
+{
+    ensureDirectory(config.base_directory);
+    CaptureThread thread(config.objects,
+                         config.capture_interval_sec,
+                         config.start_time,
+                         config.end_time,
+                         config.fetch_budget);
+    thread.setTileServerUrl(config.tile_server_url);
+    thread.setOneShot(true);
+    attachSessionRecorder(thread, config);
+    thread.start();
+    bool stop_sent = false;
+    while (!thread.wait(200))
+    {
+        if (g_stop_requested && !stop_sent)
+        {
+            std::cout << "Получен сигнал остановки, проход прерывается." << std::endl;
+            thread.stop();
+            stop_sent = true;
+        }
+    }
+
+    const CaptureRunStats stats = thread.runStats();
+    flushLogging(); // Итоги — после всех записей прохода
+    printRunSummary(stats);
+    if (!config.metrics_file.empty())
+        writeMetricsFile(config.metrics_file);
+    if (stats.objects_incomplete == 0)
+        return 0;
+    return stats.objects_incomplete < stats.objects ? 3 : 1;
+}
+
+// Минуты от полуночи для "hh:mm", -1 при ошибке формата
+int minutesOfDay(const std::string &hh_mm)
+{
+    int hour = -1;
+    int minute = -1;
+    if (std::sscanf(hh_mm.c_str(), "%d:%d", &hour, &minute) != 2 || hour < 0 || hour > 23 || minute < 0 || minute > 59)
+        return -1;
+    return hour * 60 + minute;
+}
+
+// То же правило окна, что и в CaptureThread: [start, end), окно может переходить через полночь
+bool insideWindow(const std::tm &time_tm, const std::string &start_time, const std::string &end_time)
+{
+    const int start = minutesOfDay(start_time);
+    const int end = minutesOfDay(end_time);
+    if (start < 0 || end < 0)
+        return false;
+    const int current = time_tm.tm_hour * 60 + time_tm.tm_min;
+    return start <= end ? current >= start && current < end : current >= start || current < end;
+}
+
+struct ObjectSlots
+{
+    size_t count = 0;
+    int64_t first_ms = 0;
+    int64_t last_ms = 0;
+    size_t outside_window = 0;
+    size_t too_early = 0; // Слоты, наступившие раньше интервала после предыдущего
+};
+
+std::string formatLocalTime(int64_t unix_ms)
+{
+    std::tm time_tm{};
+    if (!localTimeSafe(static_cast<std::time_t>(unix_ms / 1000), time_tm))
+        return "?";
+    char text[32];
+    std::strftime(text, sizeof(text), "%d.%m %H:%M:%S", &time_tm);
+    return text;
+}
+
+int runSimulation(const CaptureConfig &config, int hours)
+{
+    std::tm midnight_tm{};
+    localTimeSafe(std::time(nullptr), midnight_tm);
+    midnight_tm.tm_hour = 0;
+    midnight_tm.tm_min = 0;
+    midnight_tm.tm_sec = 0;
+    midnight_tm.tm_isdst = -1;
+    const int64_t start_ms = static_cast<int64_t>(std::mktime(&midnight_tm)) * 1000;
+
+    auto clock = std::make_shared<SimulatedClock>(start_ms);
+    clock->setHorizon(std::chrono::hours(hours));
+
+    CaptureThread thread(config.objects,
+                         config.capture_interval_sec,
+                         config.start_time,
+                         config.end_time,
+                         config.fetch_budget);
+    thread.setClock(clock);
+    thread.setScheduleOnly(true);
+
+    // Наблюдатель вызывается только из потока захвата — синхронизация не нужна
+    std::vector<ObjectSlots> object_slots(config.objects.size());
+    thread.setSlotObserver([&](size_t index, int64_t slot_ms)
+                           {
+                               const MapObject &object = config.objects[index];
+                               ObjectSlots &s = object_slots[index];
+                               std::tm slot_tm{};
+                               localTimeSafe(static_cast<std::time_t>(slot_ms / 1000), slot_tm);
+                               if (!insideWindow(slot_tm,
+                                                 object.start_time.empty() ? config.start_time : object.start_time,
+                                                 object.end_time.empty() ? config.end_time : object.end_time))
+                                   ++s.outside_window;
+                               const int interval_sec = object.capture_interval_sec > 0 ? object.capture_interval_sec : config.capture_interval_sec;
+                               if (s.count > 0 && slot_ms - s.last_ms < static_cast<int64_t>(interval_sec) * 1000)
+                                   ++s.too_early;
+                               if (s.count == 0)
+                                   s.first_ms = slot_ms;
+                               s.last_ms = slot_ms;
+                               ++s.count; });
+
+    const auto real_start = std::chrono::steady_clock::now();
+    thread.start();
+    // Прогон идет без ожидания; минута настоящего времени — защита от зависания
+    const bool finished = clock->waitForHorizon(std::chrono::minutes(1));
+    thread.stop();
+    thread.wait();
+    flushLogging();
+    const double real_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - real_start).count();
+    if (!finished)
+    {
+        std::cerr << "Прогон расписания не дошел до горизонта за минуту, остановлен на "
+                  << formatLocalTime(clock->unixMs()) << std::endl;
+        return 1;
+    }
+
+    size_t total = 0;
+    size_t violations = 0;
+    char line[256];
+    for (size_t i = 0; i < object_slots.size(); ++i)
+    {
+        const ObjectSlots &s = object_slots[i];
+        total += s.count;
+        violations += s.outside_window + s.too_early;
+        // Подробно — только о нарушениях и для небольших конфигураций
+        if (object_slots.size() <= 20 || s.outside_window > 0 || s.too_early > 0)
+        {
+            std::snprintf(line, sizeof(line), "  %s: слотов %zu, первый %s, последний %s, вне окна %zu, раньше интервала %zu",
+                          config.objects[i].name.c_str(), s.count,
+                          s.count ? formatLocalTime(s.first_ms).c_str() : "-",
+                          s.count ? formatLocalTime(s.last_ms).c_str() : "-",
+                          s.outside_window, s.too_early);
+            std::cout << line << std::endl;
+        }
+    }
+    std::snprintf(line, sizeof(line), "Прогон расписания: %d ч, объектов %zu, слотов %zu, нарушений %zu, %.3f с",
+                  hours, object_slots.size(), total, violations, real_sec);
+    std::cout << line << std::endl;
+    return violations == 0 ? 0 : 3;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    std::locale::global(std::locale("C")); // Для корректного преобразования чисел в строки (точка как разделитель)
+
+    const std::string mode = argc > 1 ? argv[1] : "";
+    const bool once = argc == 3 && mode == "--once";
+    const bool simulate = (argc == 3 || argc == 4) && mode == "--simulate";
+    const int simulate_hours = simulate && argc == 4 ? std::atoi(argv[3]) : 24;
+    if ((argc != 2 && !once && !simulate) || simulate_hours <= 0)
+    {
+        std::cerr << "Использование: screend [--once] <конфигурация.json>" << std::endl;
+        std::cerr << "               screend --simulate <конфигурация.json> [часов]" << std::endl;
+        return 2;
+    }
+    const std::string config_path = argv[once || simulate ? 2 : 1];
+
+    CaptureConfig config;
+    if (!loadCaptureConfig(config_path, config))
+        return 1;
+    configureLogging(config.log_level, config.log_file);
+
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+#ifdef SIGHUP
+    std::signal(SIGHUP, onReloadSignal);
+#endif
+
+    if (simulate)
+        return runSimulation(config, simulate_hours);
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    if (once)
+    {
+        const int result = runOnce(config);
+        curl_global_cleanup();
+        return result;
+    }
+    std::unique_ptr<CaptureThread> capture = startCapture(config);
+
+    // Обработчики сигналов только выставляют флаги; реакция — здесь, в цикле событий
+    QTimer signal_poll;
+    QObject::connect(&signal_poll, &QTimer::timeout, &app, [&]()
+                     {
+                         if (g_stop_requested)
+                         {
+                             signal_poll.stop();
+                             std::cout << "Получен сигнал остановки." << std::endl;
+                             stopCapture(capture);
+                             app.quit();
+                             return;
+                         }
+                         if (g_reload_requested)
+                         {
+                             g_reload_requested = 0;
+                             std::cout << "Перечитывается конфигурация: " << config_path << std::endl;
+                             CaptureConfig reloaded;
+                             if (!loadCaptureConfig(config_path, reloaded))
+                             {
+                                 std::cerr << "Конфигурация не применена, съемка продолжается с прежней." << std::endl;
+                                 return;
+                             }
+                             stopCapture(capture);
+                             config = std::move(reloaded);
+                             capture = startCapture(config);
+                         } });
+    signal_poll.start(200);
+
+    // Файл метрик берется из текущей конфигурации: после SIGHUP путь и период могут смениться
+    QTimer metrics_timer;
+    QObject::connect(&metrics_timer, &QTimer::timeout, &app, [&]()
+                     {
+                         if (!config.metrics_file.empty())
+                             writeMetricsFile(config.metrics_file);
+                         metrics_timer.setInterval(config.metrics_interval_sec * 1000); });
+    metrics_timer.start(config.metrics_interval_sec * 1000);
+
+    const int result = app.exec();
+    stopCapture(capture);
+    if (!config.metrics_file.empty())
+        writeMetricsFile(config.metrics_file);
+    curl_global_cleanup();
+    flushLogging();
+    return result;
+}
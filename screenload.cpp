@@ -0,0 +1,370 @@
+// Нагрузочный прогон полного цикла захвата против локальной замены сервиса плиток.
+//   screenload [--objects 500] [--radius-km 2] [--burst] [--concurrency 8] [--client-kbps 0]
+//              [--latency fixed:300] [--error-rate 0.02] [--reset-rate 0] [--bandwidth-kbps 0]
+//              [--seed 1] [--work-dir каталог] [--keep-output] [--log-level warning] [--json файл]
+//              [--config screend.json] [--replay сеанс.session] [--time-scale 1]
+// Запускает настоящий CaptureThread в разовом проходе (как screend --once) по сетке
+// из --objects объектов, а плитки отдает TileStandInServer (tilestandin.h) с заданной
+// задержкой (формат — LatencyModel), долей ошибок 503, обрывов соединения и общей полосой.
+// --config берет объекты из конфигурации screend (каталоги сохранения — в рабочем каталоге).
+// --replay отдает ответы из записи сеанса (screend "record_session", tilesession.h) с их
+// временем, умноженным на --time-scale; ошибки по умолчанию не вносятся. Для точного
+// совпадения запросов объекты должны быть те же, что при записи (--config).
+// Итог: время цикла, пропускная способность, хвост задержек плиток, пиковая память (RSS).
+// Замена сервера и запись сеанса живут в том же процессе, поэтому память до прохода
+// (они уже запущены и загружены) выводится отдельно, а для захвата — прирост пика за проход.
+// Композиты каждого объекта удаляются сразу после его захвата, если не задан --keep-output:
+// иначе 500 объектов займут на диске гигабайты. Прогон пишет в новый подкаталог run-XXXXXX
+// рабочего каталога и по окончании удаляет только его; остальное в --work-dir не трогается.
+
+#include "asynclog.h"
+#include "metrics.h"
+#include "captureconfig.h"
+#include "capturethread.h"
+#include "tilesession.h"
+#include "tilestandin.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QString>
+#include <QTemporaryDir>
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <locale>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    struct LoadOptions
+    {
+        int objects = 500;
+        int radius_km = 2;
+        bool burst = false;
+        FetchBudget budget;
+        StandInOptions network;
+        std::string work_dir;
+        bool keep_output = false;
+        LogLevel log_level = LogLevel::Warning;
+        std::string json_path;
+        std::string config_path;
+        std::string replay_path;
+    };
+
+    // Пиковый объем резидентной памяти процесса, байт; 0 — неизвестно
+    uint64_t peakRssBytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return static_cast<uint64_t>(counters.PeakWorkingSetSize);
+        return 0;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss); // macOS — в байтах
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // Linux — в килобайтах
+#endif
+#endif
+    }
+
+    bool parseArgs(int argc, char *argv[], LoadOptions &options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (arg == "--objects" && has_value)
+                options.objects = std::atoi(argv[++i]);
+            else if (arg == "--radius-km" && has_value)
+                options.radius_km = std::atoi(argv[++i]);
+            else if (arg == "--burst")
+                options.burst = true;
+            else if (arg == "--concurrency" && has_value)
+                options.budget.max_concurrent_fetches = std::atoi(argv[++i]);
+            else if (arg == "--client-kbps" && has_value)
+                options.budget.max_bytes_per_sec = std::atoll(argv[++i]) * 1024;
+            else if (arg == "--latency" && has_value)
+            {
+                if (!LatencyModel::parse(argv[++i], options.network.latency))
+                {
+                    std::cerr << "Неверное распределение задержки: " << argv[i] << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--error-rate" && has_value)
+                options.network.error_rate = std::atof(argv[++i]);
+            else if (arg == "--reset-rate" && has_value)
+                options.network.reset_rate = std::atof(argv[++i]);
+            else if (arg == "--bandwidth-kbps" && has_value)
+                options.network.bandwidth_bytes_per_sec = std::atoll(argv[++i]) * 1024;
+            else if (arg == "--seed" && has_value)
+                options.network.seed = std::strtoull(argv[++i], nullptr, 10);
+            else if (arg == "--work-dir" && has_value)
+                options.work_dir = argv[++i];
+            else if (arg == "--keep-output")
+                options.keep_output = true;
+            else if (arg == "--log-level" && has_value)
+            {
+                if (!parseLogLevel(argv[++i], options.log_level))
+                {
+                    std::cerr << "Неверный уровень журнала: " << argv[i] << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--json" && has_value)
+                options.json_path = argv[++i];
+            else if (arg == "--config" && has_value)
+                options.config_path = argv[++i];
+            else if (arg == "--replay" && has_value)
+                options.replay_path = argv[++i];
+            else if (arg == "--time-scale" && has_value)
+                options.network.replay_time_scale = std::atof(argv[++i]);
+            else
+            {
+                std::cerr << "Неизвестный аргумент: " << arg << std::endl;
+                return false;
+            }
+        }
+        // Внесение ошибок по умолчанию — только для синтетических плиток
+        if (options.network.error_rate < 0)
+            options.network.error_rate = options.replay_path.empty() ? 0.02 : 0.0;
+        if (options.objects < 1 || options.radius_km < 1 || options.budget.max_concurrent_fetches < 1 ||
+            options.network.replay_time_scale < 0 || options.network.reset_rate < 0 ||
+            options.network.error_rate + options.network.reset_rate > 1)
+        {
+            std::cerr << "Неверные параметры прогона." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Объекты из конфигурации screend или синтетические на равномерной сетке координат,
+    // чтобы URL плиток не повторялись
+    bool makeObjects(const LoadOptions &options, std::vector<MapObject> &objects)
+    {
+        if (!options.config_path.empty())
+        {
+            CaptureConfig config;
+            if (!loadCaptureConfig(options.config_path, config))
+                return false;
+            objects = config.objects;
+            for (MapObject &object : objects)
+            {
+                object.save_directory = options.work_dir + "/" + object.name;
+                object.archive_captures = false;
+                object.burst_capture = object.burst_capture || options.burst;
+            }
+            return true;
+        }
+
+        objects.clear();
+        objects.reserve(options.objects);
+        for (int i = 0; i < options.objects; ++i)
+        {
+            const std::string name = "load" + std::to_string(i);
+            objects.emplace_back(45.0 + (i / 50) * 0.5, 39.0 + (i % 50) * 0.5, options.radius_km, name,
+                                 options.work_dir + "/" + name);
+            objects.back().burst_capture = options.burst;
+        }
+        return true;
+    }
+
+    bool writeJson(const LoadOptions &options, const CaptureRunStats &stats, const std::vector<int64_t> &latency,
+                   const StandInStats &server, uint64_t peak_rss, uint64_t before_rss)
+    {
+        QJsonObject root;
+        root["objects"] = static_cast<double>(stats.objects);
+        root["radius_km"] = options.radius_km;
+        root["burst"] = options.burst;
+        root["concurrency"] = options.budget.max_concurrent_fetches;
+        root["latency"] = QString::fromStdString(options.network.latency.describe());
+        root["error_rate"] = options.network.error_rate;
+        root["reset_rate"] = options.network.reset_rate;
+        root["bandwidth_bytes_per_sec"] = static_cast<double>(options.network.bandwidth_bytes_per_sec);
+        root["cycle_sec"] = stats.elapsed_sec;
+        root["objects_incomplete"] = static_cast<double>(stats.objects_incomplete);
+        root["tile_requests_ok"] = static_cast<double>(stats.tile_requests_ok);
+        root["tile_requests_failed"] = static_cast<double>(stats.tile_requests_failed);
+        root["tiles_missing"] = static_cast<double>(stats.tiles_missing);
+        root["bytes"] = static_cast<double>(stats.bytes);
+        root["tiles_per_sec"] = stats.tile_requests_ok / std::max(stats.elapsed_sec, 1e-3);
+        root["latency_p50_ms"] = static_cast<double>(percentileOfSorted(latency, 0.50));
+        root["latency_p90_ms"] = static_cast<double>(percentileOfSorted(latency, 0.90));
+        root["latency_p99_ms"] = static_cast<double>(percentileOfSorted(latency, 0.99));
+        root["latency_p999_ms"] = static_cast<double>(percentileOfSorted(latency, 0.999));
+        root["latency_max_ms"] = static_cast<double>(latency.empty() ? 0 : latency.back());
+        root["server_requests"] = static_cast<double>(server.requests);
+        root["server_errors"] = static_cast<double>(server.errors);
+        root["server_resets"] = static_cast<double>(server.resets);
+        root["replay"] = QString::fromStdString(options.replay_path);
+        root["replay_time_scale"] = options.network.replay_time_scale;
+        root["replay_misses"] = static_cast<double>(server.replay_misses);
+        root["peak_rss_bytes"] = static_cast<double>(peak_rss);
+        root["before_capture_rss_bytes"] = static_cast<double>(before_rss);
+        root["capture_rss_bytes"] = static_cast<double>(peak_rss > before_rss ? peak_rss - before_rss : 0);
+
+        const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+        QSaveFile file(QString::fromStdString(options.json_path));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit())
+        {
+            std::cerr << "Ошибка записи итогов: " << options.json_path << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    std::locale::global(std::locale("C"));
+
+    LoadOptions options;
+    options.network.latency.a = 300;
+    options.network.error_rate = -1.0; // Зависит от --replay, см. parseArgs
+    if (!parseArgs(argc, argv, options))
+    {
+        std::cerr << "Использование: screenload [--objects N] [--radius-km R] [--burst] [--concurrency N] [--client-kbps N]"
+                     " [--latency fixed:300|uniform:A:B|exp:M|lognormal:MED:SIGMA] [--error-rate P] [--reset-rate P]"
+                     " [--bandwidth-kbps N] [--seed N] [--work-dir каталог] [--keep-output] [--log-level уровень] [--json файл]"
+                     " [--config screend.json] [--replay сеанс] [--time-scale K]"
+                  << std::endl;
+        return 2;
+    }
+    if (options.work_dir.empty())
+        options.work_dir = QDir::temp().absoluteFilePath("screenload").toStdString();
+    std::error_code ec;
+    std::filesystem::create_directories(options.work_dir, ec);
+    if (ec)
+    {
+        std::cerr << "Ошибка создания рабочего каталога '" << options.work_dir << "': " << ec.message() << std::endl;
+        return 1;
+    }
+    QTemporaryDir run_dir(QDir(QString::fromStdString(options.work_dir)).absoluteFilePath("run-XXXXXX"));
+    if (!run_dir.isValid())
+    {
+        std::cerr << "Ошибка создания каталога прогона в '" << options.work_dir << "'" << std::endl;
+        return 1;
+    }
+    run_dir.setAutoRemove(!options.keep_output);
+    options.work_dir = run_dir.path().toStdString();
+    if (options.keep_output)
+        std::cout << "Результаты прогона: " << options.work_dir << std::endl;
+    configureLogging(options.log_level);
+
+    std::vector<MapObject> objects;
+    if (!makeObjects(options, objects))
+        return 1;
+    if (!options.replay_path.empty())
+    {
+        auto session = std::make_shared<TileSession>();
+        if (!loadTileSession(options.replay_path, *session))
+            return 1;
+        std::cout << "Запись сеанса: " << options.replay_path << ", ответов " << session->entries.size()
+                  << ", масштаб времени " << options.network.replay_time_scale << std::endl;
+        options.network.replay = std::move(session);
+    }
+
+    TileStandInServer server(options.network);
+    if (!server.startListening())
+        return 1;
+    std::cout << "Замена сервера плиток: " << server.baseUrl() << ", задержка "
+              << (options.network.replay ? std::string("из записи") : options.network.latency.describe())
+              << ", ошибок " << options.network.error_rate * 100 << "%, обрывов " << options.network.reset_rate * 100 << "%" << std::endl;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    CaptureThread thread(objects, 600, "00:00", "23:59", options.budget);
+    thread.setTileServerUrl(server.baseUrl());
+    thread.setOneShot(true);
+    if (!options.keep_output)
+    {
+        // Вызывается из потока завершения пула после сохранения результата объекта. Удаляются только
+        // файлы композита: временный каталог плиток внутри убирает сам IoStage.
+        thread.setCaptureObserver([&objects](size_t object_index, int64_t, size_t, bool)
+                                  {
+            std::error_code list_ec;
+            for (const auto &entry : std::filesystem::directory_iterator(objects[object_index].save_directory, list_ec))
+            {
+                std::error_code remove_ec;
+                if (entry.is_regular_file(remove_ec))
+                    std::filesystem::remove(entry.path(), remove_ec);
+            } });
+    }
+    std::cout << "Разовый проход: объектов " << objects.size();
+    if (options.config_path.empty())
+        std::cout << ", радиус " << options.radius_km << " км";
+    std::cout << (options.burst ? ", залпом" : "") << ", одновременных запросов " << options.budget.max_concurrent_fetches << std::endl;
+    // Пик до прохода: замена сервера, запись сеанса и объекты уже в памяти
+    const uint64_t before_rss = peakRssBytes();
+    thread.start();
+    thread.wait();
+
+    CaptureRunStats stats = thread.runStats();
+    server.stopListening();
+    curl_global_cleanup();
+    flushLogging();
+
+    if (!options.keep_output)
+        run_dir.remove();
+
+    std::sort(stats.tile_latency_ms.begin(), stats.tile_latency_ms.end());
+    const std::vector<int64_t> &latency = stats.tile_latency_ms;
+    const StandInStats served = server.stats();
+    const uint64_t peak_rss = peakRssBytes();
+    const size_t requests = stats.tile_requests_ok + stats.tile_requests_failed;
+    const double seconds = std::max(stats.elapsed_sec, 1e-3);
+
+    char line[320];
+    std::cout << "Итоги нагрузочного прогона:" << std::endl;
+    std::snprintf(line, sizeof(line), "  время цикла: %.1f с, объектов неполных: %zu из %zu",
+                  stats.elapsed_sec, stats.objects_incomplete, stats.objects);
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "  запросов плиток: %zu (ошибок %zu), не получено плиток: %zu",
+                  requests, stats.tile_requests_failed, stats.tiles_missing);
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "  пропускная способность: %.1f плиток/с, %.2f МБ/с",
+                  stats.tile_requests_ok / seconds, stats.bytes / seconds / (1024.0 * 1024.0));
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "  задержка плитки: p50 %lld, p90 %lld, p99 %lld, p99.9 %lld, макс. %lld мс",
+                  static_cast<long long>(percentileOfSorted(latency, 0.50)), static_cast<long long>(percentileOfSorted(latency, 0.90)),
+                  static_cast<long long>(percentileOfSorted(latency, 0.99)), static_cast<long long>(percentileOfSorted(latency, 0.999)),
+                  static_cast<long long>(latency.empty() ? 0 : latency.back()));
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "  сервер: запросов %llu, ответов 503 %llu, обрывов %llu",
+                  static_cast<unsigned long long>(served.requests), static_cast<unsigned long long>(served.errors),
+                  static_cast<unsigned long long>(served.resets));
+    std::cout << line << std::endl;
+    if (options.network.replay)
+    {
+        std::snprintf(line, sizeof(line), "  нет в записи сеанса: %llu запросов", static_cast<unsigned long long>(served.replay_misses));
+        std::cout << line << std::endl;
+    }
+    std::snprintf(line, sizeof(line), "  пиковая память (RSS): %.1f МБ, до прохода (замена сервера, запись сеанса) %.1f МБ, прирост за проход %.1f МБ",
+                  peak_rss / (1024.0 * 1024.0), before_rss / (1024.0 * 1024.0),
+                  (peak_rss > before_rss ? peak_rss - before_rss : 0) / (1024.0 * 1024.0));
+    std::cout << line << std::endl;
+
+    if (!options.json_path.empty() && !writeJson(options, stats, latency, served, peak_rss, before_rss))
+        return 1;
+    return stats.objects_incomplete == 0 ? 0 : 3;
+}
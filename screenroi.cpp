@@ -0,0 +1,139 @@
+// Выгрузка области интереса одного объекта за интервал времени (roiextract.h).
+//   screenroi <каталог объекта> <имя объекта> <с> <по> --px x,y,w,h <выходной каталог> [--raw] [--threads N]
+//   screenroi <каталог объекта> <имя объекта> <с> <по> --geo lat_min,lon_min,lat_max,lon_max <выходной каталог> [--raw] [--threads N]
+// Время — Unix-время в мс или локальная дата ISO (2024-05-01T12:00:00).
+// Кадры пишутся как <имя>_<время мс>.png, с --raw — как .rgb (RGB888 без выравнивания строк).
+
+#include "capturearchive.h"
+#include "roiextract.h"
+
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+#include <iostream>
+
+namespace
+{
+    bool parseNumbers(const char *text, int count, std::vector<double> &out)
+    {
+        const QStringList parts = QString::fromLocal8Bit(text).split(',');
+        if (parts.size() != count)
+            return false;
+        out.clear();
+        for (const QString &part : parts)
+        {
+            bool ok = false;
+            out.push_back(part.trimmed().toDouble(&ok));
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+
+    void printUsage()
+    {
+        std::cerr << "Использование:\n"
+                  << "  screenroi <каталог объекта> <имя объекта> <с> <по> --px x,y,w,h <выходной каталог> [--raw] [--threads N]\n"
+                  << "  screenroi <каталог объекта> <имя объекта> <с> <по> --geo lat_min,lon_min,lat_max,lon_max <выходной каталог> [--raw] [--threads N]\n"
+                  << "Время: Unix-время в мс или дата ISO (2024-05-01T12:00:00)." << std::endl;
+    }
+
+    bool writeRaw(const QString &path, const QImage &image)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        const qint64 row_bytes = static_cast<qint64>(image.width()) * 3;
+        for (int y = 0; y < image.height(); ++y)
+        {
+            if (file.write(reinterpret_cast<const char *>(image.constScanLine(y)), row_bytes) != row_bytes)
+                return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 8)
+    {
+        printUsage();
+        return 2;
+    }
+
+    RoiQuery query;
+    query.save_directory = QString::fromLocal8Bit(argv[1]).toStdString();
+    query.object_name = QString::fromLocal8Bit(argv[2]).toStdString();
+    if (!parseArchiveTime(argv[3], query.from_ms) || !parseArchiveTime(argv[4], query.to_ms))
+    {
+        std::cerr << "Неверное время." << std::endl;
+        return 2;
+    }
+
+    const std::string mode = argv[5];
+    std::vector<double> numbers;
+    if (!parseNumbers(argv[6], 4, numbers) || (mode != "--px" && mode != "--geo"))
+    {
+        printUsage();
+        return 2;
+    }
+    if (mode == "--px")
+    {
+        query.pixel_rect = QRect(static_cast<int>(numbers[0]), static_cast<int>(numbers[1]),
+                                 static_cast<int>(numbers[2]), static_cast<int>(numbers[3]));
+    }
+    else
+    {
+        query.geographic = true;
+        query.lat_min = numbers[0];
+        query.lon_min = numbers[1];
+        query.lat_max = numbers[2];
+        query.lon_max = numbers[3];
+    }
+
+    const QString output_dir = QString::fromLocal8Bit(argv[7]);
+    bool raw = false;
+    for (int i = 8; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        if (option == "--raw")
+        {
+            raw = true;
+        }
+        else if (option == "--threads" && i + 1 < argc)
+        {
+            query.threads = QString::fromLocal8Bit(argv[++i]).toInt();
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+
+    if (!QDir().mkpath(output_dir))
+    {
+        std::cerr << "Ошибка создания выходного каталога: " << output_dir.toStdString() << std::endl;
+        return 1;
+    }
+
+    const QString name_prefix = QString::fromStdString(query.object_name) + "_";
+    size_t failed = 0;
+    const size_t frames = extractRoi(query, [&](RoiFrame &frame)
+                                     {
+        const QString path = QDir(output_dir).filePath(name_prefix + QString::number(static_cast<qint64>(frame.timestamp_ms)) + (raw ? ".rgb" : ".png"));
+        const bool ok = raw ? writeRaw(path, frame.image) : frame.image.save(path, "PNG");
+        if (!ok)
+        {
+            ++failed;
+            std::cerr << "Ошибка записи кадра: " << path.toStdString() << std::endl;
+            return;
+        }
+        std::cout << frame.timestamp_ms << "\t" << frame.rect.x() << "," << frame.rect.y() << "," << frame.rect.width() << "," << frame.rect.height()
+                  << "\t" << path.toStdString() << std::endl; });
+
+    std::cerr << "Кадров: " << frames << ", ошибок записи: " << failed << std::endl;
+    return frames > 0 && failed == 0 ? 0 : 1;
+}
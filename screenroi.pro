@@ -0,0 +1,21 @@
+# Выгрузка области интереса по сохраненным композитам (screenroi)
+TEMPLATE = app
+TARGET = screenroi
+CONFIG += console c++17 warn_on release static
+CONFIG -= app_bundle
+QT += core gui
+QT -= widgets
+DEFINES += CURL_STATICLIB
+# Путь к каталогу библиотек MXE и зависимости libcurl — как в Screen.pro
+LIBS += -L/home/ssv/mxe/usr/x86_64-w64-mingw32.static/lib
+LIBS += -lcurl -lssh2 -lnghttp2 -lidn2 -lpsl -lunistring -lssl -lcrypto -lbcrypt \
+        -lzstd -lbrotlidec -lbrotlicommon -lwldap32 -lz -lws2_32 -lcrypt32 -ladvapi32
+QMAKE_LFLAGS += -static
+QMAKE_LFLAGS += -static-libgcc
+QMAKE_LFLAGS += -static-libstdc++
+SOURCES += \
+    screenroi.cpp \
+    roiextract.cpp
+HEADERS += \
+    roiextract.h
+include(screencapture.pri)
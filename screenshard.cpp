@@ -0,0 +1,811 @@
+// Захват с распределением объектов по нескольким рабочим процессам одной машины.
+//   screenshard [--workers N] [--no-respawn] <конфигурация.json>
+// Координатор запускает N рабочих процессов (этот же файл с --worker) и делит между ними
+// объекты конфигурации screend согласованным хешированием (shardring.h): у каждого
+// рабочего свой CaptureThread только со своими объектами. Первое назначение рассылается,
+// когда на связи все рабочие (или через 15 с после запуска — тем, кто успел), чтобы
+// объекты не переезжали по мере подключения. Объекты, оставшиеся у рабочего при смене
+// назначения, продолжают свое расписание, а не снимаются заново. Связь — локальный сокет
+// (QLocalSocket: Unix-сокет, в Windows именованный канал), сообщения — JSON по строке.
+// Если рабочий завершился, его объекты переходят к остальным, остальные объекты остаются
+// на месте; через 5 с рабочий перезапускается (кроме --no-respawn) и получает их обратно.
+// Объект сначала снимается со старого владельца и только после подтверждения передается
+// новому, так что временный каталог объекта никогда не пишут два процесса. Прерванный
+// при передаче захват новый владелец продолжает по журналу плиток (tilejournal.h).
+// Метрики рабочих собираются координатором и с меткой worker пишутся в "metrics_file".
+// Бюджет загрузки (max_concurrent_fetches, max_bytes_per_sec) действует в каждом рабочем.
+// "log_file" у рабочих получает суффикс .<имя рабочего>; "record_session" не используется.
+//
+//   screenshard --plan N <конфигурация.json>
+// Без запуска захвата: раскладка объектов по N рабочим и сколько объектов переезжает
+// при уходе каждого из них (должны переезжать только его собственные).
+//
+//   screenshard --worker <имя> --server <сокет> <конфигурация.json>
+// Рабочий процесс; запускается координатором.
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QSaveFile>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+
+#include "asynclog.h"
+#include "captureconfig.h"
+#include "capturethread.h"
+#include "metrics.h"
+#include "shardring.h"
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <locale>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+volatile std::sig_atomic_t g_stop_requested = 0;
+
+extern "C" void onStopSignal(int)
+{
+    g_stop_requested = 1;
+}
+
+const int kRespawnDelayMs = 5000;
+const int kConnectTimeoutMs = 10000;
+const int kJoinGraceMs = 15000; // Сколько первое назначение ждет подключения всех рабочих
+const int kWorkerStopTimeoutMs = 120000; // Рабочий дожидается текущих загрузок
+
+std::string workerName(int index)
+{
+    return "worker-" + std::to_string(index);
+}
+
+// Объекты по узлам кольца; имена внутри узла упорядочены
+std::map<std::string, std::vector<std::string>> assignObjects(const ShardRing &ring, const std::vector<MapObject> &objects)
+{
+    std::map<std::string, std::vector<std::string>> out;
+    for (const std::string &node : ring.nodes())
+        out[node];
+    for (const MapObject &object : objects)
+    {
+        const std::string node = ring.nodeFor(object.name);
+        if (!node.empty())
+            out[node].push_back(object.name);
+    }
+    for (auto &item : out)
+        std::sort(item.second.begin(), item.second.end());
+    return out;
+}
+
+// Сообщение — JSON-объект в одну строку
+void sendMessage(QLocalSocket *socket, const QJsonObject &message)
+{
+    if (!socket || socket->state() != QLocalSocket::ConnectedState)
+        return;
+    QByteArray line = QJsonDocument(message).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    socket->write(line);
+    socket->flush();
+}
+
+// Разбирает все полные строки, пришедшие в сокет
+template <class Handler>
+void readMessages(QLocalSocket *socket, Handler handler)
+{
+    while (socket->canReadLine())
+    {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+        QJsonParseError error;
+        const QJsonDocument document = QJsonDocument::fromJson(line, &error);
+        if (error.error != QJsonParseError::NoError || !document.isObject())
+        {
+            logWarning("shard_bad_message", "Некорректное сообщение по локальному сокету: %s", error.errorString().toStdString().c_str());
+            continue;
+        }
+        handler(document.object());
+    }
+}
+
+QJsonArray toJsonArray(const std::vector<std::string> &names)
+{
+    QJsonArray out;
+    for (const std::string &name : names)
+        out.append(QString::fromStdString(name));
+    return out;
+}
+
+// ---------------------------------------------------------------- Рабочий процесс
+
+int runWorker(const std::string &worker_id, const std::string &server_name, const CaptureConfig &loaded)
+{
+    CaptureConfig config = loaded;
+    if (!config.log_file.empty())
+        config.log_file += "." + worker_id;
+    configureLogging(config.log_level, config.log_file);
+    ensureDirectory(config.base_directory);
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    QLocalSocket socket;
+    std::unique_ptr<CaptureThread> capture;
+    std::vector<std::string> assigned;
+
+    // Слоты объектов по имени: при смене назначения оставшиеся объекты не снимаются
+    // заново сразу, а продолжают прежнее расписание. Слот считается использованным,
+    // когда его захват завершен; прерванный захват остается к сроку и продолжится по журналу.
+    std::mutex slots_mutex;
+    std::map<std::string, int64_t> open_slot_ms;      // Слот открыт, захват еще идет
+    std::map<std::string, int64_t> last_capture_ms;   // Слот последнего завершенного захвата
+
+    auto stopCapture = [&]()
+    {
+        if (!capture)
+            return;
+        capture->stop();
+        capture->wait();
+        capture.reset();
+    };
+
+    // Поток захвата перезапускается с новым набором объектов. Незавершенные захваты
+    // оставшихся объектов продолжатся по журналу плиток, а не начнутся заново.
+    // Снятые объекты забываются: вернувшись, объект снимается по своему первому сроку.
+    auto applyAssignment = [&](std::vector<std::string> names)
+    {
+        std::sort(names.begin(), names.end());
+        if (names != assigned)
+        {
+            stopCapture();
+            assigned = names;
+            std::vector<MapObject> objects;
+            std::vector<std::string> object_names; // По индексу объекта в потоке
+            for (const MapObject &object : config.objects)
+            {
+                if (std::binary_search(assigned.begin(), assigned.end(), object.name))
+                {
+                    objects.push_back(object);
+                    object_names.push_back(object.name);
+                }
+            }
+            std::map<std::string, int64_t> kept_slots;
+            {
+                std::lock_guard<std::mutex> lock(slots_mutex);
+                open_slot_ms.clear();
+                for (auto it = last_capture_ms.begin(); it != last_capture_ms.end();)
+                {
+                    if (std::binary_search(assigned.begin(), assigned.end(), it->first))
+                        ++it;
+                    else
+                        it = last_capture_ms.erase(it);
+                }
+                kept_slots = last_capture_ms;
+            }
+            if (!objects.empty())
+            {
+                capture = std::make_unique<CaptureThread>(objects,
+                                                          config.capture_interval_sec,
+                                                          config.start_time,
+                                                          config.end_time,
+                                                          config.fetch_budget);
+                capture->setTileServerUrl(config.tile_server_url);
+                capture->setLastCaptureTimes(std::move(kept_slots));
+                capture->setSlotObserver([&slots_mutex, &open_slot_ms, object_names](size_t index, int64_t slot_unix_ms)
+                                         {
+                                             std::lock_guard<std::mutex> lock(slots_mutex);
+                                             open_slot_ms[object_names[index]] = slot_unix_ms; });
+                capture->setCaptureObserver([&slots_mutex, &open_slot_ms, &last_capture_ms, object_names](size_t index, int64_t, size_t, bool)
+                                            {
+                                                std::lock_guard<std::mutex> lock(slots_mutex);
+                                                auto slot = open_slot_ms.find(object_names[index]);
+                                                if (slot == open_slot_ms.end())
+                                                    return;
+                                                last_capture_ms[slot->first] = slot->second;
+                                                open_slot_ms.erase(slot); });
+                capture->start();
+            }
+            logInfo("shard_assigned", "Назначены объекты worker=%s objects=%zu", worker_id.c_str(), objects.size());
+        }
+        // Подтверждение — после остановки прежнего захвата: снятые объекты больше не пишутся
+        QJsonObject reply;
+        reply["type"] = "assigned";
+        reply["objects"] = static_cast<int>(assigned.size());
+        sendMessage(&socket, reply);
+    };
+
+    QObject::connect(&socket, &QLocalSocket::readyRead, [&]()
+                     { readMessages(&socket, [&](const QJsonObject &message)
+                                    {
+                                        if (message["type"].toString() != "assign")
+                                            return;
+                                        std::vector<std::string> names;
+                                        for (const QJsonValue &name : message["objects"].toArray())
+                                            names.push_back(name.toString().toStdString());
+                                        applyAssignment(std::move(names)); }); });
+    // Без координатора рабочий не работает: иначе после его падения объекты снимались бы дважды
+    QObject::connect(&socket, &QLocalSocket::disconnected, [&]()
+                     {
+                         logWarning("shard_coordinator_lost", "Связь с координатором потеряна, рабочий завершается worker=%s", worker_id.c_str());
+                         QCoreApplication::quit(); });
+
+    socket.connectToServer(QString::fromStdString(server_name));
+    if (!socket.waitForConnected(kConnectTimeoutMs))
+    {
+        std::cerr << "Рабочий " << worker_id << ": нет связи с координатором " << server_name << ": "
+                  << socket.errorString().toStdString() << std::endl;
+        curl_global_cleanup();
+        return 1;
+    }
+    QJsonObject hello;
+    hello["type"] = "hello";
+    hello["worker"] = QString::fromStdString(worker_id);
+    hello["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+    sendMessage(&socket, hello);
+
+    QTimer metrics_timer;
+    QObject::connect(&metrics_timer, &QTimer::timeout, [&]()
+                     {
+                         QJsonObject message;
+                         message["type"] = "metrics";
+                         message["text"] = QString::fromStdString(formatPrometheusMetrics());
+                         sendMessage(&socket, message); });
+    metrics_timer.start(config.metrics_interval_sec * 1000);
+
+    QTimer signal_poll;
+    QObject::connect(&signal_poll, &QTimer::timeout, [&]()
+                     {
+                         if (g_stop_requested)
+                             QCoreApplication::quit(); });
+    signal_poll.start(200);
+
+    const int result = QCoreApplication::exec();
+    stopCapture();
+    curl_global_cleanup();
+    flushLogging();
+    return result;
+}
+
+// ---------------------------------------------------------------- Координатор
+
+// Метрики рабочих в один файл: у каждой строки значения добавляется метка worker,
+// описания семейств (# HELP, # TYPE) остаются по одному
+class MetricsMerger
+{
+public:
+    void add(const std::string &worker, const std::string &text)
+    {
+        std::string family;
+        size_t begin = 0;
+        while (begin < text.size())
+        {
+            size_t end = text.find('\n', begin);
+            if (end == std::string::npos)
+                end = text.size();
+            const std::string line = text.substr(begin, end - begin);
+            begin = end + 1;
+            if (line.empty())
+                continue;
+            if (line.compare(0, 7, "# HELP ") == 0 || line.compare(0, 7, "# TYPE ") == 0)
+            {
+                const size_t name_end = line.find(' ', 7);
+                family = line.substr(7, name_end == std::string::npos ? std::string::npos : name_end - 7);
+                Family &f = familyFor(family);
+                if (std::find(f.header.begin(), f.header.end(), line) == f.header.end())
+                    f.header.push_back(line);
+                continue;
+            }
+            if (line[0] == '#')
+                continue;
+            const std::string label = "worker=\"" + worker + "\"";
+            const size_t brace = line.find('{');
+            const size_t space = line.find(' ');
+            std::string sample;
+            if (brace != std::string::npos && (space == std::string::npos || brace < space))
+                sample = line.substr(0, brace + 1) + label + (line[brace + 1] == '}' ? "" : ",") + line.substr(brace + 1);
+            else if (space != std::string::npos)
+                sample = line.substr(0, space) + "{" + label + "}" + line.substr(space);
+            else
+                continue;
+            familyFor(family).samples.push_back(sample);
+        }
+    }
+
+    void addGauge(const std::string &name, const std::string &help, const std::string &labels, long long value)
+    {
+        Family &f = familyFor(name);
+        if (f.header.empty())
+        {
+            f.header.push_back("# HELP " + name + " " + help);
+            f.header.push_back("# TYPE " + name + " gauge");
+        }
+        f.samples.push_back(name + labels + " " + std::to_string(value));
+    }
+
+    std::string text() const
+    {
+        std::string out;
+        for (const std::string &name : m_order)
+        {
+            const Family &f = m_families.at(name);
+            for (const std::string &line : f.header)
+                out += line + "\n";
+            for (const std::string &line : f.samples)
+                out += line + "\n";
+        }
+        return out;
+    }
+
+private:
+    struct Family
+    {
+        std::vector<std::string> header;
+        std::vector<std::string> samples;
+    };
+
+    Family &familyFor(const std::string &name)
+    {
+        auto it = m_families.find(name);
+        if (it == m_families.end())
+        {
+            m_order.push_back(name);
+            it = m_families.emplace(name, Family()).first;
+        }
+        return it->second;
+    }
+
+    std::vector<std::string> m_order;
+    std::map<std::string, Family> m_families;
+};
+
+class ShardCoordinator
+{
+public:
+    ShardCoordinator(const CaptureConfig &config, std::string config_path, int workers, bool respawn)
+        : m_config(config), m_config_path(std::move(config_path)), m_respawn(respawn)
+    {
+        for (int i = 0; i < workers; ++i)
+            m_workers[workerName(i)].id = workerName(i);
+    }
+
+    bool start()
+    {
+        m_server_name = "screenshard-" + std::to_string(QCoreApplication::applicationPid());
+        QLocalServer::removeServer(QString::fromStdString(m_server_name));
+        if (!m_server.listen(QString::fromStdString(m_server_name)))
+        {
+            std::cerr << "Ошибка открытия локального сокета " << m_server_name << ": " << m_server.errorString().toStdString() << std::endl;
+            return false;
+        }
+        QObject::connect(&m_server, &QLocalServer::newConnection, [this]()
+                         { acceptConnections(); });
+        for (auto &item : m_workers)
+            spawn(item.second);
+        QTimer::singleShot(kJoinGraceMs, [this]()
+                           { openAssignments(); });
+        std::cout << "Координатор: сокет " << m_server_name << ", рабочих " << m_workers.size()
+                  << ", объектов " << m_config.objects.size() << std::endl;
+        return true;
+    }
+
+    // Рабочие завершаются, потеряв связь; координатор дожидается их загрузок
+    void shutdown()
+    {
+        m_stopping = true;
+        for (auto &item : m_workers)
+        {
+            Worker &worker = item.second;
+            if (worker.socket)
+                worker.socket->disconnectFromServer();
+        }
+        for (auto &item : m_workers)
+        {
+            Worker &worker = item.second;
+            if (worker.process && worker.process->state() != QProcess::NotRunning &&
+                !worker.process->waitForFinished(kWorkerStopTimeoutMs))
+            {
+                std::cerr << "Рабочий " << worker.id << " не завершился вовремя и остановлен принудительно." << std::endl;
+                worker.process->kill();
+                worker.process->waitForFinished(5000);
+            }
+        }
+        m_server.close();
+    }
+
+    void writeMetrics() const
+    {
+        if (m_config.metrics_file.empty())
+            return;
+        MetricsMerger merger;
+        size_t alive = 0;
+        for (const auto &item : m_workers)
+        {
+            const Worker &worker = item.second;
+            if (!worker.metrics_text.empty())
+                merger.add(worker.id, worker.metrics_text);
+            if (worker.joined)
+                ++alive;
+        }
+        merger.addGauge("screen_shard_workers", "Рабочие процессы на связи.", "", static_cast<long long>(alive));
+        for (const auto &item : m_workers)
+            merger.addGauge("screen_shard_objects", "Объекты, назначенные рабочему.", "{worker=\"" + item.first + "\"}",
+                            static_cast<long long>(item.second.assigned.size()));
+        merger.addGauge("screen_shard_rebalances", "Перераспределения объектов с запуска.", "", static_cast<long long>(m_rebalances));
+        for (const auto &item : m_workers)
+            merger.addGauge("screen_shard_worker_restarts", "Перезапуски рабочего.", "{worker=\"" + item.first + "\"}",
+                            static_cast<long long>(item.second.restarts));
+
+        const std::string text = merger.text();
+        QSaveFile file(QString::fromStdString(m_config.metrics_file));
+        if (!file.open(QIODevice::WriteOnly) ||
+            file.write(text.data(), static_cast<qint64>(text.size())) != static_cast<qint64>(text.size()) ||
+            !file.commit())
+        {
+            std::cerr << "Ошибка записи файла метрик: " << m_config.metrics_file << std::endl;
+        }
+    }
+
+private:
+    struct Worker
+    {
+        std::string id;
+        QProcess *process = nullptr;
+        QLocalSocket *socket = nullptr;
+        bool joined = false;                 // На кольце: прислал hello и на связи
+        bool awaiting_ack = false;           // Ждет подтверждения снятия объектов
+        std::vector<std::string> assigned;   // Последнее отправленное назначение
+        std::string metrics_text;
+        int restarts = 0;
+    };
+
+    void spawn(Worker &worker)
+    {
+        if (m_stopping)
+            return;
+        QProcess *process = new QProcess();
+        process->setProcessChannelMode(QProcess::ForwardedChannels);
+        process->setProgram(QCoreApplication::applicationFilePath());
+        process->setArguments(QStringList() << "--worker" << QString::fromStdString(worker.id)
+                                            << "--server" << QString::fromStdString(m_server_name)
+                                            << QString::fromStdString(m_config_path));
+        const std::string id = worker.id;
+        QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), [this, id, process](int exit_code, QProcess::ExitStatus status)
+                         {
+                             Worker &w = m_workers[id];
+                             if (w.process == process)
+                                 w.process = nullptr;
+                             process->deleteLater();
+                             workerLost(w, status == QProcess::CrashExit ? "аварийно" : "с кодом " + std::to_string(exit_code));
+                             if (m_respawn && !m_stopping)
+                             {
+                                 QTimer::singleShot(kRespawnDelayMs, [this, id]()
+                                                    {
+                                                        Worker &again = m_workers[id];
+                                                        if (again.process || m_stopping)
+                                                            return;
+                                                        ++again.restarts;
+                                                        spawn(again);
+                                                    });
+                             } });
+        worker.process = process;
+        process->start();
+    }
+
+    void acceptConnections()
+    {
+        while (m_server.hasPendingConnections())
+        {
+            QLocalSocket *socket = m_server.nextPendingConnection();
+            QObject::connect(socket, &QLocalSocket::readyRead, [this, socket]()
+                             { readMessages(socket, [this, socket](const QJsonObject &message)
+                                            { onMessage(socket, message); }); });
+            QObject::connect(socket, &QLocalSocket::disconnected, [this, socket]()
+                             {
+                                 for (auto &item : m_workers)
+                                 {
+                                     if (item.second.socket == socket)
+                                     {
+                                         item.second.socket = nullptr;
+                                         workerLost(item.second, "разрыв связи");
+                                     }
+                                 }
+                                 socket->deleteLater(); });
+        }
+    }
+
+    void onMessage(QLocalSocket *socket, const QJsonObject &message)
+    {
+        const std::string type = message["type"].toString().toStdString();
+        if (type == "hello")
+        {
+            auto it = m_workers.find(message["worker"].toString().toStdString());
+            if (it == m_workers.end())
+            {
+                logWarning("shard_unknown_worker", "Подключился неизвестный рабочий worker=%s", message["worker"].toString().toStdString().c_str());
+                socket->disconnectFromServer();
+                return;
+            }
+            Worker &worker = it->second;
+            worker.socket = socket;
+            worker.joined = true;
+            worker.awaiting_ack = false;
+            worker.assigned.clear();
+            m_ring.addNode(worker.id);
+            std::cout << "Рабочий " << worker.id << " на связи (pid " << message["pid"].toVariant().toLongLong() << ")." << std::endl;
+            const bool all_joined = std::all_of(m_workers.begin(), m_workers.end(), [](const std::pair<const std::string, Worker> &item)
+                                                { return item.second.joined; });
+            if (!m_assignments_open && all_joined)
+                openAssignments();
+            else
+                rebalance();
+            return;
+        }
+
+        Worker *worker = workerFor(socket);
+        if (!worker)
+            return;
+        if (type == "assigned")
+        {
+            worker->awaiting_ack = false;
+            if (m_handoff_pending && !anyAwaitingAck())
+                applyTarget();
+        }
+        else if (type == "metrics")
+        {
+            worker->metrics_text = message["text"].toString().toStdString();
+        }
+    }
+
+    Worker *workerFor(QLocalSocket *socket)
+    {
+        for (auto &item : m_workers)
+        {
+            if (item.second.socket == socket)
+                return &item.second;
+        }
+        return nullptr;
+    }
+
+    bool anyAwaitingAck() const
+    {
+        return std::any_of(m_workers.begin(), m_workers.end(), [](const std::pair<const std::string, Worker> &item)
+                           { return item.second.joined && item.second.awaiting_ack; });
+    }
+
+    void workerLost(Worker &worker, const std::string &reason)
+    {
+        if (!worker.joined)
+            return;
+        worker.joined = false;
+        worker.awaiting_ack = false;
+        worker.assigned.clear();
+        worker.metrics_text.clear(); // Метрики мертвого процесса больше не публикуются
+        m_ring.removeNode(worker.id);
+        if (worker.socket)
+        {
+            worker.socket->abort();
+            worker.socket = nullptr;
+        }
+        if (m_stopping)
+            return;
+        std::cout << "Рабочий " << worker.id << " потерян (" << reason << "), объекты перераспределяются." << std::endl;
+        logWarning("shard_worker_lost", "Рабочий потерян worker=%s: %s", worker.id.c_str(), reason.c_str());
+        rebalance();
+    }
+
+    // Сначала у рабочих снимаются объекты, которые уходят к другим; новые назначения
+    // рассылаются, когда все снятия подтверждены (applyTarget)
+    void rebalance()
+    {
+        if (m_stopping || !m_assignments_open)
+            return;
+        ++m_rebalances;
+        const auto target = assignObjects(m_ring, m_config.objects);
+        for (auto &item : m_workers)
+        {
+            Worker &worker = item.second;
+            if (!worker.joined)
+                continue;
+            auto it = target.find(worker.id);
+            std::vector<std::string> kept;
+            if (it != target.end())
+            {
+                std::set_intersection(worker.assigned.begin(), worker.assigned.end(),
+                                      it->second.begin(), it->second.end(), std::back_inserter(kept));
+            }
+            if (kept.size() < worker.assigned.size())
+            {
+                assign(worker, kept);
+                worker.awaiting_ack = true;
+            }
+        }
+        m_handoff_pending = true;
+        if (!anyAwaitingAck())
+            applyTarget();
+    }
+
+    // Первое назначение: все рабочие на связи или истекло ожидание
+    void openAssignments()
+    {
+        if (m_assignments_open || m_stopping)
+            return;
+        m_assignments_open = true;
+        logInfo("shard_assignments_open", "Первое назначение объектов, рабочих на связи: %zu", m_ring.nodes().size());
+        rebalance();
+    }
+
+    void applyTarget()
+    {
+        m_handoff_pending = false;
+        const auto target = assignObjects(m_ring, m_config.objects);
+        for (auto &item : m_workers)
+        {
+            Worker &worker = item.second;
+            if (!worker.joined)
+                continue;
+            auto it = target.find(worker.id);
+            const std::vector<std::string> want = it != target.end() ? it->second : std::vector<std::string>();
+            if (want != worker.assigned)
+                assign(worker, want);
+        }
+    }
+
+    void assign(Worker &worker, const std::vector<std::string> &names)
+    {
+        worker.assigned = names;
+        QJsonObject message;
+        message["type"] = "assign";
+        message["objects"] = toJsonArray(names);
+        sendMessage(worker.socket, message);
+        std::cout << "  " << worker.id << ": объектов " << names.size() << std::endl;
+    }
+
+    CaptureConfig m_config;
+    std::string m_config_path;
+    bool m_respawn = true;
+    bool m_stopping = false;
+    bool m_handoff_pending = false;
+    bool m_assignments_open = false; // До первого назначения рабочие только подключаются
+    size_t m_rebalances = 0;
+    std::string m_server_name;
+    QLocalServer m_server;
+    ShardRing m_ring;
+    std::map<std::string, Worker> m_workers;
+};
+
+int runCoordinator(const CaptureConfig &config, const std::string &config_path, int workers, bool respawn)
+{
+    configureLogging(config.log_level, config.log_file);
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    ShardCoordinator coordinator(config, config_path, workers, respawn);
+    if (!coordinator.start())
+        return 1;
+
+    QTimer signal_poll;
+    QObject::connect(&signal_poll, &QTimer::timeout, [&]()
+                     {
+                         if (!g_stop_requested)
+                             return;
+                         signal_poll.stop();
+                         std::cout << "Получен сигнал остановки, рабочие завершают загрузки." << std::endl;
+                         coordinator.shutdown();
+                         QCoreApplication::quit(); });
+    signal_poll.start(200);
+
+    QTimer metrics_timer;
+    QObject::connect(&metrics_timer, &QTimer::timeout, [&]()
+                     { coordinator.writeMetrics(); });
+    metrics_timer.start(config.metrics_interval_sec * 1000);
+
+    const int result = QCoreApplication::exec();
+    coordinator.writeMetrics();
+    flushLogging();
+    return result;
+}
+
+// Раскладка по кольцу без запуска: проверка равномерности и того, что при уходе
+// рабочего переезжают только его объекты
+int printPlan(const CaptureConfig &config, int workers)
+{
+    ShardRing ring;
+    for (int i = 0; i < workers; ++i)
+        ring.addNode(workerName(i));
+    const auto full = assignObjects(ring, config.objects);
+    std::cout << "Раскладка " << config.objects.size() << " объектов по " << workers << " рабочим:" << std::endl;
+    for (const auto &item : full)
+        std::cout << "  " << item.first << ": " << item.second.size() << std::endl;
+
+    bool only_own = true;
+    for (int i = 0; i < workers && workers > 1; ++i)
+    {
+        ShardRing reduced = ring;
+        reduced.removeNode(workerName(i));
+        size_t moved = 0;
+        size_t foreign = 0;
+        for (const MapObject &object : config.objects)
+        {
+            const std::string before = ring.nodeFor(object.name);
+            if (before == reduced.nodeFor(object.name))
+                continue;
+            ++moved;
+            if (before != workerName(i))
+                ++foreign;
+        }
+        only_own = only_own && foreign == 0;
+        std::cout << "  без " << workerName(i) << ": переезжает " << moved << " объектов"
+                  << (foreign ? ", из них чужих " + std::to_string(foreign) : std::string()) << std::endl;
+    }
+    return only_own ? 0 : 3;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    std::locale::global(std::locale("C")); // Для корректного преобразования чисел в строки (точка как разделитель)
+
+    int workers = std::max(1, std::min(QThread::idealThreadCount(), 8));
+    bool respawn = true;
+    int plan_workers = 0;
+    std::string worker_id;
+    std::string server_name;
+    std::string config_path;
+    bool args_ok = true;
+    for (int i = 1; i < argc && args_ok; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--workers" && has_value)
+            workers = std::atoi(argv[++i]);
+        else if (arg == "--plan" && has_value)
+            plan_workers = std::atoi(argv[++i]);
+        else if (arg == "--no-respawn")
+            respawn = false;
+        else if (arg == "--worker" && has_value)
+            worker_id = argv[++i];
+        else if (arg == "--server" && has_value)
+            server_name = argv[++i];
+        else if (config_path.empty() && arg.compare(0, 2, "--") != 0)
+            config_path = arg;
+        else
+            args_ok = false;
+    }
+    if (!args_ok || config_path.empty() || workers <= 0 || plan_workers < 0 || worker_id.empty() != server_name.empty())
+    {
+        std::cerr << "Использование: screenshard [--workers N] [--no-respawn] <конфигурация.json>" << std::endl;
+        std::cerr << "               screenshard --plan N <конфигурация.json>" << std::endl;
+        return 2;
+    }
+
+    CaptureConfig config;
+    if (!loadCaptureConfig(config_path, config))
+        return 1;
+
+    if (plan_workers > 0)
+        return printPlan(config, plan_workers);
+    if (!worker_id.empty())
+    {
+        std::signal(SIGINT, onStopSignal);
+        std::signal(SIGTERM, onStopSignal);
+        return runWorker(worker_id, server_name, config);
+    }
+    return runCoordinator(config, config_path, workers, respawn);
+}
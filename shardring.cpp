@@ -0,0 +1,66 @@
+#include "shardring.h"
+
+#include <algorithm>
+
+uint64_t ShardRing::hash(const std::string &text)
+{
+    // FNV-1a с финальным перемешиванием: у соседних имен (worker-1, worker-2)
+    // точки иначе ложатся на кольцо слишком близко
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : text)
+    {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+void ShardRing::addNode(const std::string &node)
+{
+    for (int i = 0; i < kVirtualNodes; ++i)
+        m_points.emplace(hash(node + "#" + std::to_string(i)), node);
+}
+
+void ShardRing::removeNode(const std::string &node)
+{
+    for (auto it = m_points.begin(); it != m_points.end();)
+    {
+        if (it->second == node)
+            it = m_points.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool ShardRing::hasNode(const std::string &node) const
+{
+    return std::any_of(m_points.begin(), m_points.end(), [&node](const std::pair<const uint64_t, std::string> &point)
+                       { return point.second == node; });
+}
+
+std::vector<std::string> ShardRing::nodes() const
+{
+    std::vector<std::string> out;
+    for (const auto &point : m_points)
+    {
+        if (std::find(out.begin(), out.end(), point.second) == out.end())
+            out.push_back(point.second);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::string ShardRing::nodeFor(const std::string &key) const
+{
+    if (m_points.empty())
+        return std::string();
+    auto it = m_points.lower_bound(hash(key));
+    if (it == m_points.end())
+        it = m_points.begin();
+    return it->second;
+}
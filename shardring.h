@@ -0,0 +1,33 @@
+#ifndef SHARDRING_H
+#define SHARDRING_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Кольцо согласованного хеширования для распределения объектов по рабочим процессам.
+// У каждого узла kVirtualNodes точек на кольце; объект принадлежит узлу первой точки
+// по часовой стрелке от хеша его имени. При уходе узла переезжают только его объекты,
+// при возвращении узла с тем же именем — ровно они же обратно.
+class ShardRing
+{
+public:
+    static const int kVirtualNodes = 128;
+
+    void addNode(const std::string &node);
+    void removeNode(const std::string &node);
+    bool hasNode(const std::string &node) const;
+    std::vector<std::string> nodes() const;
+    bool empty() const { return m_points.empty(); }
+
+    // Узел для ключа; пустая строка, если узлов нет
+    std::string nodeFor(const std::string &key) const;
+
+    static uint64_t hash(const std::string &text);
+
+private:
+    std::map<uint64_t, std::string> m_points;
+};
+
+#endif // SHARDRING_H
@@ -1,9 +1,21 @@
 #include "snapshotapp.h"
 #include "MapObject.h"     // Включите, если MapObject вынесен в отдельный файл
 #include "capturethread.h" // Включите заголовочный файл потока
+#include "objectimport.h"
+#include "projectstore.h"
+#include "objectprogressdelegate.h"
+
+#include <QFile>
+#include <QMetaObject>
 
 #include <curl/curl.h> // Включите здесь для curl_global_init/cleanup
 
+// Журнал и разбор событий хода захвата
+const int kMaxLogLines = 2000;
+const int kProgressPollMs = 100;
+const size_t kMaxEventsPerTick = 20000;
+const int kMaxFailuresLoggedPerTick = 5;
+
 SnapshotApp::SnapshotApp(QWidget *parent) : QWidget(parent), captureThread(nullptr)
 {
     setWindowTitle("Снимки карты по объектам");
@@ -36,6 +48,15 @@ SnapshotApp::SnapshotApp(QWidget *parent) : QWidget(parent), captureThread(nullp
     objectGroupLayout->addWidget(new QLabel("Радиус съемки объекта (км):"));
     objectGroupLayout->addWidget(radiusEdit);
 
+    burstCaptureCheck = new QCheckBox("Залповый захват (вся сетка одновременно)");
+    objectGroupLayout->addWidget(burstCaptureCheck);
+
+    archiveCapturesCheck = new QCheckBox("Хранить композиты в архиве объекта (сегменты по суткам)");
+    objectGroupLayout->addWidget(archiveCapturesCheck);
+
+    lazyCompositeCheck = new QCheckBox("Собирать композит только по запросу (хранить пакет плиток)");
+    objectGroupLayout->addWidget(lazyCompositeCheck);
+
     // Поле для указания пути сохранения для ЭТОГО объекта
     objectSaveDirEdit = new QLineEdit("./screenshots_output/Объект1"); // Путь по умолчанию
     objectGroupLayout->addWidget(new QLabel("Путь для сохранения снимков объекта:"));
@@ -55,13 +76,27 @@ SnapshotApp::SnapshotApp(QWidget *parent) : QWidget(parent), captureThread(nullp
     mainLayout->addWidget(addObjectGroup);
 
     // --- Список объектов ---
-    mapObjectsListWidget = new QListWidget();
+    m_mapObjects = new MapObjectListModel(this);
+    mapObjectsListView = new QListView();
+    mapObjectsListView->setModel(m_mapObjects);
+    mapObjectsListView->setUniformItemSizes(true); // Высота строк не измеряется для каждого объекта
+    mapObjectsListView->setItemDelegate(new ObjectProgressDelegate(mapObjectsListView));
     mainLayout->addWidget(new QLabel("Список объектов для съемки:"));
-    mainLayout->addWidget(mapObjectsListWidget);
+    mainLayout->addWidget(mapObjectsListView);
 
+    QHBoxLayout *listButtonsLayout = new QHBoxLayout();
     removeMapObjectButton = new QPushButton("Удалить выбранный объект");
     connect(removeMapObjectButton, &QPushButton::clicked, this, &SnapshotApp::onRemoveMapObject);
-    mainLayout->addWidget(removeMapObjectButton);
+    listButtonsLayout->addWidget(removeMapObjectButton);
+
+    importMapObjectsButton = new QPushButton("Импорт из CSV/JSON...");
+    connect(importMapObjectsButton, &QPushButton::clicked, this, &SnapshotApp::onImportMapObjects);
+    listButtonsLayout->addWidget(importMapObjectsButton);
+
+    exportProjectButton = new QPushButton("Экспорт проекта (JSON)...");
+    connect(exportProjectButton, &QPushButton::clicked, this, &SnapshotApp::onExportProject);
+    listButtonsLayout->addWidget(exportProjectButton);
+    mainLayout->addLayout(listButtonsLayout);
 
     // --- Общие настройки (без пути сохранения) ---
     QGroupBox *settingsGroup = new QGroupBox("Общие настройки съемки");
@@ -82,6 +117,11 @@ SnapshotApp::SnapshotApp(QWidget *parent) : QWidget(parent), captureThread(nullp
     settingsLayout->addWidget(new QLabel("Интервал съемки (м):"));
     settingsLayout->addWidget(intervalEdit);
 
+    concurrencyEdit = new QLineEdit("8");
+    concurrencyEdit->setValidator(new QIntValidator(1, 64, this));
+    settingsLayout->addWidget(new QLabel("Одновременных загрузок плиток (на все объекты):"));
+    settingsLayout->addWidget(concurrencyEdit);
+
     settingsGroup->setLayout(settingsLayout);
     mainLayout->addWidget(settingsGroup);
 
@@ -98,13 +138,37 @@ SnapshotApp::SnapshotApp(QWidget *parent) : QWidget(parent), captureThread(nullp
     mainLayout->addLayout(controlButtonsLayout);
     setLayout(mainLayout);
 
-    statsTextEdit = new QTextEdit();
+    overallProgressBar = new QProgressBar();
+    overallProgressBar->setRange(0, 1);
+    overallProgressBar->setValue(0);
+    mainLayout->addWidget(overallProgressBar);
+
+    statsTextEdit = new QPlainTextEdit();
+    statsTextEdit->setReadOnly(true);
+    statsTextEdit->setMaximumBlockCount(kMaxLogLines);
     mainLayout->addWidget(statsTextEdit);
 
+    progressTimer = new QTimer(this);
+    progressTimer->setInterval(kProgressPollMs);
+    connect(progressTimer, &QTimer::timeout, this, &SnapshotApp::drainProgress);
+
     // Обновление пути сохранения объекта при изменении имени
     connect(objectNameEdit, &QLineEdit::textChanged, this, &SnapshotApp::updateObjectSaveDir);
 
     curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    m_projectPath = kDefaultProjectPath;
+    projectSaveTimer = new QTimer(this);
+    projectSaveTimer->setSingleShot(true);
+    projectSaveTimer->setInterval(1000);
+    connect(projectSaveTimer, &QTimer::timeout, this, &SnapshotApp::saveProjectNow);
+    loadProjectIntoUi();
+
+    // Изменения общих настроек сохраняются в проект
+    connect(startTimeEdit, &QTimeEdit::timeChanged, this, &SnapshotApp::scheduleProjectSave);
+    connect(endTimeEdit, &QTimeEdit::timeChanged, this, &SnapshotApp::scheduleProjectSave);
+    connect(intervalEdit, &QLineEdit::editingFinished, this, &SnapshotApp::scheduleProjectSave);
+    connect(concurrencyEdit, &QLineEdit::editingFinished, this, &SnapshotApp::scheduleProjectSave);
 }
 
 SnapshotApp::~SnapshotApp()
@@ -116,6 +180,8 @@ SnapshotApp::~SnapshotApp()
         delete captureThread;
         captureThread = nullptr;
     }
+    if (projectSaveTimer->isActive())
+        saveProjectNow();
     curl_global_cleanup();
 }
 
@@ -134,13 +200,10 @@ void SnapshotApp::onAddMapObject()
         return;
     }
 
-    for (const auto &item : m_mapObjectList)
+    if (m_mapObjects->containsName(name_str.toStdString()))
     {
-        if (item.name == name_str.toStdString())
-        {
-            QMessageBox::warning(this, "Ошибка", "Объект с таким именем уже существует.");
-            return;
-        }
+        QMessageBox::warning(this, "Ошибка", "Объект с таким именем уже существует.");
+        return;
     }
 
     if (!ok_lat || !ok_lon || !ok_radius || radius_val <= 0)
@@ -156,8 +219,11 @@ void SnapshotApp::onAddMapObject()
     }
 
     MapObject newObj(lat, lon, radius_val, name_str.toStdString(), save_dir_str.toStdString());
-    m_mapObjectList.push_back(newObj);
-    mapObjectsListWidget->addItem(newObj.getDisplayText());
+    newObj.burst_capture = burstCaptureCheck->isChecked();
+    newObj.archive_captures = archiveCapturesCheck->isChecked();
+    newObj.lazy_composite = lazyCompositeCheck->isChecked();
+    m_mapObjects->append(newObj);
+    scheduleProjectSave();
 
     int next_obj_num = 1;
     if (name_str.startsWith("Объект") && name_str.mid(6).toInt() > 0)
@@ -166,7 +232,7 @@ void SnapshotApp::onAddMapObject()
     }
     else
     {
-        next_obj_num = m_mapObjectList.size() + 1;
+        next_obj_num = m_mapObjects->rowCount() + 1;
     }
     objectNameEdit->setText("Объект" + QString::number(next_obj_num));
     updateObjectSaveDir(objectNameEdit->text());
@@ -185,12 +251,13 @@ void SnapshotApp::onAddMapObject()
 
 void SnapshotApp::onRemoveMapObject()
 {
-    int currentRow = mapObjectsListWidget->currentRow();
-    if (currentRow >= 0 && currentRow < static_cast<int>(m_mapObjectList.size()))
+    const QModelIndex current = mapObjectsListView->currentIndex();
+    int currentRow = current.isValid() ? current.row() : -1;
+    if (currentRow >= 0 && currentRow < m_mapObjects->rowCount())
     {
-        std::cout << "Удаление объекта: " << m_mapObjectList[currentRow].name << std::endl;
-        m_mapObjectList.erase(m_mapObjectList.begin() + currentRow);
-        delete mapObjectsListWidget->takeItem(currentRow);
+        std::cout << "Удаление объекта: " << m_mapObjects->objects()[currentRow].name << std::endl;
+        m_mapObjects->removeObject(currentRow);
+        scheduleProjectSave();
         std::cout << "Удален объект с индексом " << currentRow << std::endl;
     }
     else
@@ -199,6 +266,90 @@ void SnapshotApp::onRemoveMapObject()
     }
 }
 
+void SnapshotApp::onImportMapObjects()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Импорт объектов", QString(), "Списки объектов (*.csv *.json);;Все файлы (*)");
+    if (path.isEmpty())
+        return;
+
+    std::vector<MapObject> imported;
+    ObjectImportResult result;
+    if (!importMapObjects(path.toStdString(), base_screenshot_dir, m_mapObjects->names(), imported, result))
+    {
+        QMessageBox::critical(this, "Ошибка", "Не удалось загрузить список объектов (подробности в журнале).");
+        return;
+    }
+    m_mapObjects->appendBatch(std::move(imported));
+    scheduleProjectSave();
+
+    QString info = QString("Импорт из %1: добавлено %2, повторов имен %3, строк с ошибками %4")
+                       .arg(path)
+                       .arg(result.imported)
+                       .arg(result.duplicates)
+                       .arg(result.rejected);
+    updateStatistics(info);
+}
+
+void SnapshotApp::onExportProject()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Экспорт проекта", "./screen_project.json", "JSON (*.json)");
+    if (path.isEmpty())
+        return;
+    if (!exportProjectJson(path.toStdString(), currentProject()))
+    {
+        QMessageBox::critical(this, "Ошибка", "Не удалось выгрузить проект (подробности в журнале).");
+        return;
+    }
+    updateStatistics(QString("Проект выгружен: %1").arg(path));
+}
+
+void SnapshotApp::scheduleProjectSave()
+{
+    projectSaveTimer->start();
+}
+
+void SnapshotApp::saveProjectNow()
+{
+    projectSaveTimer->stop();
+    if (!saveProject(m_projectPath, currentProject()))
+        updateStatistics(QString("Ошибка сохранения проекта: %1").arg(QString::fromStdString(m_projectPath)));
+}
+
+CaptureConfig SnapshotApp::currentProject() const
+{
+    CaptureConfig project;
+    project.start_time = startTimeEdit->time().toString("hh:mm").toStdString();
+    project.end_time = endTimeEdit->time().toString("hh:mm").toStdString();
+    project.capture_interval_sec = intervalEdit->text().toInt() * 60;
+    project.fetch_budget.max_concurrent_fetches = concurrencyEdit->text().toInt();
+    project.base_directory = base_screenshot_dir;
+    project.objects = m_mapObjects->objects();
+    return project;
+}
+
+void SnapshotApp::loadProjectIntoUi()
+{
+    if (!QFile::exists(QString::fromStdString(m_projectPath)))
+        return;
+    CaptureConfig project;
+    if (!loadProject(m_projectPath, project))
+    {
+        updateStatistics(QString("Не удалось загрузить проект %1, начат новый.").arg(QString::fromStdString(m_projectPath)));
+        return;
+    }
+    if (!project.start_time.empty())
+        startTimeEdit->setTime(QTime::fromString(QString::fromStdString(project.start_time), "hh:mm"));
+    if (!project.end_time.empty())
+        endTimeEdit->setTime(QTime::fromString(QString::fromStdString(project.end_time), "hh:mm"));
+    if (project.capture_interval_sec >= 60)
+        intervalEdit->setText(QString::number(project.capture_interval_sec / 60));
+    if (project.fetch_budget.max_concurrent_fetches >= 1)
+        concurrencyEdit->setText(QString::number(project.fetch_budget.max_concurrent_fetches));
+    const size_t count = project.objects.size();
+    m_mapObjects->appendBatch(std::move(project.objects));
+    updateStatistics(QString("Загружен проект %1: объектов %2").arg(QString::fromStdString(m_projectPath)).arg(count));
+}
+
 void SnapshotApp::startCapture()
 {
     if (captureThread && captureThread->isRunning())
@@ -207,7 +358,7 @@ void SnapshotApp::startCapture()
         return;
     }
 
-    if (m_mapObjectList.empty())
+    if (m_mapObjects->rowCount() == 0)
     {
         QMessageBox::warning(this, "Предупреждение", "Список объектов для съемки пуст. Добавьте хотя бы один объект.");
         return;
@@ -224,7 +375,16 @@ void SnapshotApp::startCapture()
         return;
     }
 
-    for (const auto &obj : m_mapObjectList)
+    FetchBudget fetch_budget;
+    bool ok_concurrency;
+    fetch_budget.max_concurrent_fetches = concurrencyEdit->text().toInt(&ok_concurrency);
+    if (!ok_concurrency || fetch_budget.max_concurrent_fetches < 1)
+    {
+        QMessageBox::critical(this, "Ошибка", "Неверное число одновременных загрузок (минимум 1).");
+        return;
+    }
+
+    for (const auto &obj : m_mapObjects->objects())
     {
         if (obj.save_directory.empty())
         {
@@ -240,12 +400,37 @@ void SnapshotApp::startCapture()
         captureThread = nullptr;
     }
 
-    captureThread = new CaptureThread(m_mapObjectList,
+    captureThread = new CaptureThread(m_mapObjects->objects(),
                                       current_capture_interval,
                                       current_start_time,
                                       current_end_time,
+                                      fetch_budget,
                                       this);
 
+    // Время прежних захватов из проекта: после перезапуска объекты продолжают свое
+    // расписание, а не снимаются все сразу на первом слоте
+    std::map<std::string, int64_t> last_captures;
+    for (const MapObject &obj : m_mapObjects->objects())
+    {
+        if (obj.last_capture_ms > 0)
+            last_captures[obj.name] = obj.last_capture_ms;
+    }
+    captureThread->setLastCaptureTimes(std::move(last_captures));
+
+    // Состояние захвата объекта попадает в список и в проект; строки не меняются,
+    // пока идет съемка (добавление и удаление объектов заблокированы)
+    captureThread->setCaptureObserver([this](size_t object_index, int64_t capture_ms, size_t missing_tiles, bool)
+                                      { QMetaObject::invokeMethod(this, [this, object_index, capture_ms, missing_tiles]()
+                                                                  {
+                                                                      m_mapObjects->setCaptureState(static_cast<int>(object_index), capture_ms, static_cast<uint32_t>(missing_tiles));
+                                                                      scheduleProjectSave(); }, Qt::QueuedConnection); });
+
+    m_progress = std::make_shared<ProgressChannel>();
+    captureThread->setProgressChannel(m_progress);
+    m_objectsInFlight = 0;
+    m_reportedDropped = 0;
+    progressTimer->start();
+
     connect(captureThread, &QThread::finished, captureThread, &QObject::deleteLater);
     connect(captureThread, &QThread::finished, this, [this]()
             {
@@ -253,6 +438,12 @@ void SnapshotApp::startCapture()
                 this->stopButton->setEnabled(false);
                 this->addMapObjectButton->setEnabled(true);
                 this->removeMapObjectButton->setEnabled(true);
+                this->importMapObjectsButton->setEnabled(true);
+                this->drainProgress(); // Последние события
+                this->progressTimer->stop();
+                for (int row = 0; row < m_mapObjects->rowCount(); ++row)
+                    m_mapObjects->endObjectProgress(row);
+                m_mapObjects->publishProgress();
                 QMessageBox::information(this, "Статус", "Процесс съемки завершен."); });
 
     captureThread->start();
@@ -261,6 +452,7 @@ void SnapshotApp::startCapture()
     stopButton->setEnabled(true);
     addMapObjectButton->setEnabled(false);
     removeMapObjectButton->setEnabled(false);
+    importMapObjectsButton->setEnabled(false);
 
     QMessageBox::information(this, "Статус", "Съемка начата.");
 }
@@ -282,6 +474,7 @@ void SnapshotApp::stopCapture()
             stopButton->setEnabled(false);
             addMapObjectButton->setEnabled(true);
             removeMapObjectButton->setEnabled(true);
+            importMapObjectsButton->setEnabled(true);
         }
         QMessageBox::information(this, "Информация", "Съемка не запущена.");
     }
@@ -321,8 +514,105 @@ void SnapshotApp::updateObjectSaveDir(const QString &name)
     objectSaveDirEdit->setText(base_dir + safe_name);
 }
 
+void SnapshotApp::drainProgress()
+{
+    if (!m_progress)
+        return;
+    // Разбирается не больше kMaxEventsPerTick событий за раз: остаток — на следующем тике,
+    // окно не замирает даже при всплеске событий
+    m_progressEvents.clear();
+    m_progress->drain(m_progressEvents, kMaxEventsPerTick);
+
+    int failures_logged = 0;
+    for (const ProgressEvent &event : m_progressEvents)
+    {
+        const int row = static_cast<int>(event.object_index);
+        const bool known_row = row < m_mapObjects->rowCount();
+        switch (event.kind)
+        {
+        case ProgressEvent::ObjectStarted:
+            m_mapObjects->beginObjectProgress(row, event.value);
+            if (m_objectsInFlight == 0)
+            {
+                // Новая волна захватов — общая полоса считается заново
+                m_cycleTotalTiles = 0;
+                m_cycleDoneTiles = 0;
+            }
+            ++m_objectsInFlight;
+            m_cycleTotalTiles += event.value;
+            break;
+        case ProgressEvent::TileDone:
+            m_mapObjects->addTileProgress(row, event.ok);
+            if (event.ok)
+            {
+                ++m_cycleDoneTiles;
+                ++m_tilesSinceReport;
+                m_bytesSinceReport += event.bytes;
+                m_latencySumSinceReport += event.latency_ms;
+            }
+            else
+            {
+                ++m_failedSinceReport;
+                if (failures_logged < kMaxFailuresLoggedPerTick && known_row)
+                {
+                    ++failures_logged;
+                    updateStatistics(QString("Объект %1: плитка %2 не получена")
+                                         .arg(QString::fromStdString(m_mapObjects->objects()[row].name))
+                                         .arg(event.tile));
+                }
+            }
+            break;
+        case ProgressEvent::ObjectDone:
+            m_mapObjects->endObjectProgress(row);
+            if (m_objectsInFlight > 0)
+                --m_objectsInFlight;
+            if (known_row)
+            {
+                QString info = QString("Объект %1: захват завершен").arg(QString::fromStdString(m_mapObjects->objects()[row].name));
+                if (!event.ok)
+                    info += ", результат не сохранен";
+                else if (event.value > 0)
+                    info += QString(", не получено плиток: %1").arg(event.value);
+                updateStatistics(info);
+            }
+            break;
+        }
+    }
+    m_mapObjects->publishProgress();
+
+    overallProgressBar->setRange(0, static_cast<int>(std::max<uint64_t>(1, m_cycleTotalTiles)));
+    overallProgressBar->setValue(static_cast<int>(std::min(m_cycleDoneTiles, m_cycleTotalTiles)));
+
+    // Сводка раз в секунду вместо строки на каждую плитку
+    if (++m_ticksSinceReport * kProgressPollMs >= 1000)
+    {
+        const double seconds = m_ticksSinceReport * kProgressPollMs / 1000.0;
+        if (m_tilesSinceReport > 0 || m_failedSinceReport > 0)
+        {
+            const int64_t average_latency = m_tilesSinceReport > 0 ? m_latencySumSinceReport / static_cast<int64_t>(m_tilesSinceReport) : 0;
+            updateStatistics(QString("Плиток: %1 (%2/с), ошибок: %3, %4 МБ/с, средняя задержка %5 мс")
+                                 .arg(static_cast<qulonglong>(m_tilesSinceReport))
+                                 .arg(m_tilesSinceReport / seconds, 0, 'f', 1)
+                                 .arg(static_cast<qulonglong>(m_failedSinceReport))
+                                 .arg(m_bytesSinceReport / seconds / (1024.0 * 1024.0), 0, 'f', 2)
+                                 .arg(static_cast<qlonglong>(average_latency)));
+        }
+        const uint64_t dropped = m_progress->dropped();
+        if (dropped != m_reportedDropped)
+        {
+            updateStatistics(QString("Окно не успевает за событиями захвата, пропущено: %1").arg(static_cast<qulonglong>(dropped - m_reportedDropped)));
+            m_reportedDropped = dropped;
+        }
+        m_ticksSinceReport = 0;
+        m_tilesSinceReport = 0;
+        m_failedSinceReport = 0;
+        m_bytesSinceReport = 0;
+        m_latencySumSinceReport = 0;
+    }
+}
+
 void SnapshotApp::updateStatistics(const QString &stats)
 // void SnapshotApp::updateStatistics(const QString &stats)
 {
-    statsTextEdit->append(stats);
+    statsTextEdit->appendPlainText(stats);
 }
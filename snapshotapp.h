@@ -10,12 +10,15 @@
 #include <QPushButton>
 #include <QMessageBox>
 #include <QFileDialog>
-#include <QListWidget>
+#include <QListView>
 #include <QThread>
 #include <QIntValidator>
 #include <QDoubleValidator>
 #include <QGroupBox>
-#include <QTextEdit>
+#include <QPlainTextEdit>
+#include <QProgressBar>
+#include <QCheckBox>
+#include <QTimer>
 
 #include <string>
 #include <vector>
@@ -23,6 +26,9 @@
 #include <iostream>
 
 #include "MapObject.h" 
+#include "mapobjectmodel.h"
+#include "captureconfig.h"
+#include "progresschannel.h"
 #include "capturethread.h" //заголовочный файл потока
 
 // Forward declaration для CURL, если curl_global_init/cleanup используются здесь
@@ -30,6 +36,8 @@
 
 class CaptureThread; // Forward declaration для потока
 
+extern std::string base_screenshot_dir; // Базовый каталог снимков (main.cpp)
+
 class SnapshotApp : public QWidget
 {
     Q_OBJECT // Макрос Q_OBJECT для поддержки сигналов и слотов
@@ -41,6 +49,11 @@ public:
 private slots:
     void onAddMapObject();
     void onRemoveMapObject();
+    void onImportMapObjects();
+    void onExportProject();
+    void scheduleProjectSave();
+    void saveProjectNow();
+    void drainProgress();
     void startCapture();
     void stopCapture();
     void browseObjectDirectory();
@@ -53,19 +66,24 @@ private:
     QLineEdit *latEdit;
     QLineEdit *lonEdit;
     QLineEdit *radiusEdit;
+    QCheckBox *burstCaptureCheck;
+    QCheckBox *archiveCapturesCheck;
+    QCheckBox *lazyCompositeCheck;
     QLineEdit *objectSaveDirEdit; // Поле для пути сохранения объекта
     QPushButton *addMapObjectButton;
 
     // Список объектов
-    QListWidget *mapObjectsListWidget;
+    QListView *mapObjectsListView;
     QPushButton *removeMapObjectButton;
+    QPushButton *importMapObjectsButton;
 
-    std::vector<MapObject> m_mapObjectList; // Хранилище объектов
+    MapObjectListModel *m_mapObjects; // Хранилище объектов
 
     // Общие настройки
     QTimeEdit *startTimeEdit;
     QTimeEdit *endTimeEdit;
     QLineEdit *intervalEdit;
+    QLineEdit *concurrencyEdit;
 
     // Кнопки управления
     QPushButton *startButton;
@@ -73,7 +91,30 @@ private:
 
     CaptureThread *captureThread; // Указатель на поток захвата
 
-    QTextEdit *statsTextEdit;
+    QPlainTextEdit *statsTextEdit; // Журнал ограничен по числу строк
+    QProgressBar *overallProgressBar;
+
+    // Ход захвата: поток захвата пишет события в канал, окно разбирает их по таймеру
+    std::shared_ptr<ProgressChannel> m_progress;
+    QTimer *progressTimer;
+    std::vector<ProgressEvent> m_progressEvents;
+    int m_objectsInFlight = 0;
+    uint64_t m_cycleTotalTiles = 0;
+    uint64_t m_cycleDoneTiles = 0;
+    int m_ticksSinceReport = 0;
+    uint64_t m_tilesSinceReport = 0;
+    uint64_t m_failedSinceReport = 0;
+    uint64_t m_bytesSinceReport = 0;
+    int64_t m_latencySumSinceReport = 0;
+    uint64_t m_reportedDropped = 0;
+
+    // Проект сохраняется с задержкой после изменений: серия правок — одна запись
+    QPushButton *exportProjectButton;
+    QTimer *projectSaveTimer;
+    std::string m_projectPath;
+
+    void loadProjectIntoUi();
+    CaptureConfig currentProject() const;
 };
 
 #endif // SNAPSHOTAPP_H
@@ -0,0 +1,185 @@
+#include "tilebundle.h"
+#include "asynclog.h"
+#include "compositewriter.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const char kBundleMagic[8] = {'S', 'C', 'R', 'T', 'I', 'L', 'E', 'S'};
+    const uint32_t kBundleVersion = 1;
+
+    struct BundleHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t grid_dim;
+        uint32_t tile_width;
+        uint32_t tile_height;
+        uint32_t cell_count;
+        uint32_t reserved;
+    };
+
+    struct BundleCell
+    {
+        uint64_t offset; // От начала файла
+        uint64_t size;   // 0 — плитки нет
+    };
+
+    static_assert(sizeof(BundleHeader) == 32, "Неожиданный размер заголовка пакета");
+    static_assert(sizeof(BundleCell) == 16, "Неожиданный размер записи ячейки пакета");
+}
+
+bool writeTileBundle(const std::string &path,
+                     int grid_dim,
+                     QSize tile_size,
+                     const std::vector<QString> &cell_files,
+                     std::vector<int> *missing_cells)
+{
+    if (missing_cells)
+        missing_cells->clear();
+    const int total_cells = grid_dim * grid_dim;
+    if (grid_dim <= 0 || static_cast<int>(cell_files.size()) != total_cells)
+        return false;
+
+    // Индекс идет перед данными, поэтому смещения считаются по размерам файлов заранее
+    std::vector<BundleCell> cells(static_cast<size_t>(total_cells));
+    uint64_t offset = sizeof(BundleHeader) + cells.size() * sizeof(BundleCell);
+    for (int i = 0; i < total_cells; ++i)
+    {
+        const qint64 size = cell_files[i].isEmpty() ? 0 : QFileInfo(cell_files[i]).size();
+        cells[i].offset = size > 0 ? offset : 0;
+        cells[i].size = static_cast<uint64_t>(std::max<qint64>(0, size));
+        offset += cells[i].size;
+        if (size <= 0 && missing_cells)
+            missing_cells->push_back(i);
+    }
+
+    BundleHeader header;
+    std::memcpy(header.magic, kBundleMagic, sizeof(kBundleMagic));
+    header.version = kBundleVersion;
+    header.grid_dim = static_cast<uint32_t>(grid_dim);
+    header.tile_width = static_cast<uint32_t>(tile_size.width());
+    header.tile_height = static_cast<uint32_t>(tile_size.height());
+    header.cell_count = static_cast<uint32_t>(total_cells);
+    header.reserved = 0;
+
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        logError("bundle_open_failed", "Ошибка открытия пакета плиток для записи file=%s", path.c_str());
+        return false;
+    }
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == static_cast<qint64>(sizeof(header)) &&
+              file.write(reinterpret_cast<const char *>(cells.data()), static_cast<qint64>(cells.size() * sizeof(BundleCell))) ==
+                  static_cast<qint64>(cells.size() * sizeof(BundleCell));
+    for (int i = 0; ok && i < total_cells; ++i)
+    {
+        if (cells[i].size == 0)
+            continue;
+        QFile tile(cell_files[i]);
+        if (!tile.open(QIODevice::ReadOnly))
+        {
+            ok = false;
+            break;
+        }
+        const QByteArray data = tile.readAll();
+        ok = static_cast<uint64_t>(data.size()) == cells[i].size && file.write(data) == data.size();
+    }
+    if (!ok)
+    {
+        logError("bundle_write_failed", "Ошибка записи пакета плиток file=%s", path.c_str());
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool TileBundle::open(const std::string &path)
+{
+    close();
+    m_file.setFileName(QString::fromStdString(path));
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        logError("bundle_open_failed", "Ошибка открытия пакета плиток file=%s", path.c_str());
+        return false;
+    }
+    m_size = m_file.size();
+    m_map = m_size >= static_cast<qint64>(sizeof(BundleHeader)) ? m_file.map(0, m_size) : nullptr;
+    if (!m_map)
+    {
+        logError("bundle_map_failed", "Ошибка отображения пакета плиток file=%s", path.c_str());
+        close();
+        return false;
+    }
+
+    BundleHeader header;
+    std::memcpy(&header, m_map, sizeof(header));
+    const qint64 index_end = static_cast<qint64>(sizeof(BundleHeader) + static_cast<uint64_t>(header.cell_count) * sizeof(BundleCell));
+    if (std::memcmp(header.magic, kBundleMagic, sizeof(kBundleMagic)) != 0 || header.version != kBundleVersion ||
+        header.cell_count != header.grid_dim * header.grid_dim || index_end > m_size)
+    {
+        logError("bundle_bad_format", "Неверный формат пакета плиток file=%s", path.c_str());
+        close();
+        return false;
+    }
+    m_grid_dim = static_cast<int>(header.grid_dim);
+    m_tile_size = QSize(static_cast<int>(header.tile_width), static_cast<int>(header.tile_height));
+    return true;
+}
+
+void TileBundle::close()
+{
+    if (m_file.isOpen())
+        m_file.close(); // Отображение снимается вместе с закрытием
+    m_map = nullptr;
+    m_size = 0;
+    m_grid_dim = 0;
+    m_tile_size = QSize();
+}
+
+bool TileBundle::tile(int index, const uchar *&data, qint64 &size) const
+{
+    if (!m_map || index < 0 || index >= cellCount())
+        return false;
+    BundleCell cell;
+    std::memcpy(&cell, m_map + sizeof(BundleHeader) + static_cast<size_t>(index) * sizeof(BundleCell), sizeof(cell));
+    if (cell.size == 0 || cell.offset + cell.size > static_cast<uint64_t>(m_size))
+        return false;
+    data = m_map + cell.offset;
+    size = static_cast<qint64>(cell.size);
+    return true;
+}
+
+bool renderBundleComposite(const TileBundle &bundle, const std::string &output_bmp_path, StageMetrics *metrics)
+{
+    const int n = bundle.gridDim();
+    const QSize tile_size = bundle.tileSize();
+    if (n <= 0 || !tile_size.isValid())
+        return false;
+
+    MappedBmpWriter writer;
+    writer.setMetrics(metrics);
+    if (!writer.open(output_bmp_path, n * tile_size.width(), n * tile_size.height()))
+        return false;
+    for (int i = 0; i < bundle.cellCount(); ++i)
+    {
+        // Нулевая строка сетки — нижняя строка композита
+        const int x = (i % n) * tile_size.width();
+        const int y = ((n - 1) - i / n) * tile_size.height();
+        const uchar *data = nullptr;
+        qint64 size = 0;
+        if (!bundle.tile(i, data, size) || !writer.decodeTileDataInto(data, size, x, y))
+            writer.fillRect(x, y, tile_size.width(), tile_size.height(), kUnfilledCellColor);
+    }
+    if (!writer.close())
+    {
+        writer.discard();
+        return false;
+    }
+    return true;
+}
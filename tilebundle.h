@@ -0,0 +1,50 @@
+#ifndef TILEBUNDLE_H
+#define TILEBUNDLE_H
+
+#include <QFile>
+#include <QSize>
+#include <QString>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct StageMetrics;
+
+// Пакет плиток одного захвата: PNG-файлы плиток без перекодирования в одном файле
+// с индексом по ячейкам сетки. Композит из пакета строится только по запросу.
+// Формат: заголовок (сигнатура, версия, grid_dim, размер плитки, число ячеек),
+// затем для каждой ячейки смещение и размер (0 — плитки нет), затем данные.
+bool writeTileBundle(const std::string &path,
+                     int grid_dim,
+                     QSize tile_size,
+                     const std::vector<QString> &cell_files,
+                     std::vector<int> *missing_cells = nullptr);
+
+// Пакет плиток, отображенный в память только для чтения
+class TileBundle
+{
+public:
+    bool open(const std::string &path);
+    void close();
+
+    int gridDim() const { return m_grid_dim; }
+    QSize tileSize() const { return m_tile_size; }
+    int cellCount() const { return m_grid_dim * m_grid_dim; }
+
+    // Данные PNG плитки ячейки index; false — плитки нет
+    bool tile(int index, const uchar *&data, qint64 &size) const;
+
+private:
+    QFile m_file;
+    const uchar *m_map = nullptr;
+    qint64 m_size = 0;
+    int m_grid_dim = 0;
+    QSize m_tile_size;
+};
+
+// Собирает композит из пакета в BMP (тем же способом, что и combineAndCleanupScreenshots);
+// metrics — куда учитывать время декодирования и копирования плиток
+bool renderBundleComposite(const TileBundle &bundle, const std::string &output_bmp_path, StageMetrics *metrics = nullptr);
+
+#endif // TILEBUNDLE_H
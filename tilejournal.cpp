@@ -0,0 +1,246 @@
+#include "tilejournal.h"
+
+#include "asynclog.h"
+
+#include <QFile>
+#include <QString>
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char kJournalMagic[8] = {'S', 'C', 'R', 'J', 'R', 'N', 'L', '1'};
+    const uint32_t kJournalVersion = 1;
+
+    struct JournalHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t tile_count;
+        uint64_t fingerprint;
+        int64_t started_unix_ms;
+        int64_t valid_until_unix_ms;
+    };
+
+    struct JournalRecord
+    {
+        uint32_t index;
+        uint32_t size;
+        uint32_t name_size;
+        uint32_t checksum; // По полям записи и имени: оборванная запись не примется за целую
+    };
+
+    static_assert(sizeof(JournalHeader) == 40, "Неожиданный размер заголовка журнала");
+    static_assert(sizeof(JournalRecord) == 16, "Неожиданный размер записи журнала");
+
+    const uint32_t kMaxNameSize = 4096;
+
+    // FNV-1a
+    uint64_t hashBytes(uint64_t hash, const void *data, size_t size)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    const uint64_t kHashSeed = 14695981039346656037ull;
+
+    uint32_t recordChecksum(const JournalRecord &record, const char *name)
+    {
+        uint64_t hash = hashBytes(kHashSeed, &record, offsetof(JournalRecord, checksum));
+        hash = hashBytes(hash, name, record.name_size);
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    bool syncFile(std::FILE *file)
+    {
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+}
+
+TileJournal::~TileJournal()
+{
+    close();
+}
+
+std::string TileJournal::pathFor(const std::string &temp_dir)
+{
+    return temp_dir + ".journal";
+}
+
+uint64_t TileJournal::fingerprint(const std::string &object_name, int tile_px,
+                                  const std::vector<std::pair<double, double>> &coords)
+{
+    uint64_t hash = hashBytes(kHashSeed, object_name.data(), object_name.size());
+    const int32_t px = tile_px;
+    hash = hashBytes(hash, &px, sizeof(px));
+    for (const auto &coord : coords)
+    {
+        hash = hashBytes(hash, &coord.first, sizeof(coord.first));
+        hash = hashBytes(hash, &coord.second, sizeof(coord.second));
+    }
+    return hash;
+}
+
+bool TileJournal::load(const std::string &path, TileJournalInfo &out)
+{
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = file.readAll();
+    const char *p = data.constData();
+    const size_t size = static_cast<size_t>(data.size());
+
+    JournalHeader header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, p, sizeof(header));
+    if (std::memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) != 0 || header.version != kJournalVersion)
+        return false;
+
+    TileJournalInfo info;
+    info.fingerprint = header.fingerprint;
+    info.tile_count = header.tile_count;
+    info.started_unix_ms = header.started_unix_ms;
+    info.valid_until_unix_ms = header.valid_until_unix_ms;
+    size_t offset = sizeof(header);
+    while (size - offset >= sizeof(JournalRecord))
+    {
+        JournalRecord record;
+        std::memcpy(&record, p + offset, sizeof(record));
+        if (record.name_size == 0 || record.name_size > kMaxNameSize || record.index >= header.tile_count ||
+            size - offset - sizeof(record) < record.name_size ||
+            recordChecksum(record, p + offset + sizeof(record)) != record.checksum)
+            break;
+        JournaledTile tile;
+        tile.index = static_cast<int>(record.index);
+        tile.size = record.size;
+        tile.file_name.assign(p + offset + sizeof(record), record.name_size);
+        info.tiles.push_back(std::move(tile));
+        offset += sizeof(record) + record.name_size;
+    }
+    info.valid_bytes = offset;
+    if (offset < size)
+        logWarning("journal_truncated", "Журнал захвата оборван, прочитано плиток: %zu file=%s", info.tiles.size(), path.c_str());
+
+    out = std::move(info);
+    return true;
+}
+
+bool TileJournal::create(const std::string &path, uint64_t fingerprint, uint32_t tile_count,
+                         int64_t started_unix_ms, int64_t valid_until_unix_ms)
+{
+    close();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        logWarning("journal_create_failed", "Журнал захвата не создан, после сбоя захват начнется заново file=%s", path.c_str());
+        return false;
+    }
+    m_path = path;
+    m_failed = false;
+
+    JournalHeader header;
+    std::memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+    header.version = kJournalVersion;
+    header.tile_count = tile_count;
+    header.fingerprint = fingerprint;
+    header.started_unix_ms = started_unix_ms;
+    header.valid_until_unix_ms = valid_until_unix_ms;
+    // Заголовок синхронизируется с диском один раз на захват: после отключения питания
+    // журнал либо целиком отсутствует, либо читается. Записи плиток — только fflush
+    if (std::fwrite(&header, sizeof(header), 1, m_file) != 1 || std::fflush(m_file) != 0 || !syncFile(m_file))
+    {
+        logWarning("journal_write_failed", "Ошибка записи журнала захвата file=%s", path.c_str());
+        std::fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool TileJournal::reopen(const std::string &path, const TileJournalInfo &info)
+{
+    close();
+    std::error_code ec;
+    // Оборванная запись отрезается, иначе новые записи встанут после мусора
+    if (std::filesystem::file_size(path, ec) != info.valid_bytes && !ec)
+        std::filesystem::resize_file(path, info.valid_bytes, ec);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (ec)
+    {
+        logWarning("journal_reopen_failed", "Журнал захвата не удалось продолжить file=%s: %s", path.c_str(), ec.message().c_str());
+        return false;
+    }
+    m_file = std::fopen(path.c_str(), "ab");
+    if (!m_file)
+    {
+        logWarning("journal_reopen_failed", "Журнал захвата не удалось продолжить file=%s", path.c_str());
+        return false;
+    }
+    m_path = path;
+    m_failed = false;
+    return true;
+}
+
+void TileJournal::append(int index, const std::string &file_name, uint32_t size)
+{
+    if (index < 0 || file_name.empty() || file_name.size() > kMaxNameSize)
+        return;
+    JournalRecord record;
+    record.index = static_cast<uint32_t>(index);
+    record.size = size;
+    record.name_size = static_cast<uint32_t>(file_name.size());
+    record.checksum = recordChecksum(record, file_name.data());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file || m_failed)
+        return;
+    // Запись сбрасывается в ОС сразу: после падения процесса она остается в файле
+    const bool ok = std::fwrite(&record, sizeof(record), 1, m_file) == 1 &&
+                    std::fwrite(file_name.data(), 1, file_name.size(), m_file) == file_name.size() &&
+                    std::fflush(m_file) == 0;
+    if (!ok)
+    {
+        m_failed = true;
+        logWarning("journal_write_failed", "Ошибка записи журнала захвата, журнал остановлен file=%s", m_path.c_str());
+    }
+}
+
+void TileJournal::discard()
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        path = m_path;
+    }
+    close();
+    if (!path.empty())
+        std::remove(path.c_str());
+}
+
+void TileJournal::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file)
+        return;
+    std::fclose(m_file);
+    m_file = nullptr;
+}
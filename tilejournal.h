@@ -0,0 +1,82 @@
+#ifndef TILEJOURNAL_H
+#define TILEJOURNAL_H
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Журнал незавершенного захвата объекта: какие плитки уже лежат во временном каталоге
+// и в каких файлах. Ведется рядом с каталогом (<временный каталог>.journal) только
+// дописыванием: запись о плитке добавляется, когда файл плитки уже записан.
+// После сбоя или перезапуска захват того же объекта с той же сеткой продолжается
+// с недостающих плиток, если срок годности захвата (срок слота) еще не истек.
+// Формат: заголовок (сигнатура, версия, отпечаток сетки, сроки), затем записи
+// (индекс, размер файла, длина имени, контрольная сумма) с именем файла.
+// Оборванная или поврежденная запись и все после нее при чтении отбрасываются.
+//
+// Гарантия — на случай падения процесса: запись сбрасывается в ОС (fflush) сразу после
+// записи плитки. fsync выполняется только для заголовка; после сбоя ОС или отключения
+// питания хвост журнала может пропасть (такие плитки запрашиваются заново), а файл плитки,
+// записанный без fsync, может оказаться поврежденным при верном размере.
+// Журналы с истекшим сроком и их каталоги удаляются при запуске захвата
+// (CaptureThread::expireStaleCaptures) в каталогах сохранения объектов потока.
+
+struct JournaledTile
+{
+    int index = 0;
+    uint32_t size = 0;     // Размер файла плитки на момент записи
+    std::string file_name; // Имя файла во временном каталоге
+};
+
+struct TileJournalInfo
+{
+    uint64_t fingerprint = 0;
+    uint32_t tile_count = 0;
+    int64_t started_unix_ms = 0;
+    int64_t valid_until_unix_ms = 0; // Позже захват не продолжается
+    std::vector<JournaledTile> tiles;
+    uint64_t valid_bytes = 0; // Длина файла до конца последней целой записи
+};
+
+class TileJournal
+{
+public:
+    TileJournal() = default;
+    ~TileJournal();
+
+    TileJournal(const TileJournal &) = delete;
+    TileJournal &operator=(const TileJournal &) = delete;
+
+    static std::string pathFor(const std::string &temp_dir);
+
+    // Отпечаток сетки: продолжать можно только захват с тем же объектом, разрешением и плитками
+    static uint64_t fingerprint(const std::string &object_name, int tile_px,
+                                const std::vector<std::pair<double, double>> &coords);
+
+    // false, если журнала нет или заголовок поврежден
+    static bool load(const std::string &path, TileJournalInfo &out);
+
+    // Новый журнал (прежний перезаписывается)
+    bool create(const std::string &path, uint64_t fingerprint, uint32_t tile_count,
+                int64_t started_unix_ms, int64_t valid_until_unix_ms);
+    // Продолжение загруженного журнала; хвост после последней целой записи отрезается
+    bool reopen(const std::string &path, const TileJournalInfo &info);
+
+    // Вызывается из потоков записи одновременно
+    void append(int index, const std::string &file_name, uint32_t size);
+
+    // Захват завершен: журнал закрывается и удаляется, продолжать больше нечего
+    void discard();
+    void close();
+
+private:
+    std::mutex m_mutex;
+    std::FILE *m_file = nullptr;
+    std::string m_path;
+    bool m_failed = false;
+};
+
+#endif // TILEJOURNAL_H
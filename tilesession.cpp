@@ -0,0 +1,198 @@
+#include "tilesession.h"
+
+#include <QFile>
+#include <QString>
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    const char kSessionMagic[8] = {'S', 'C', 'R', 'S', 'E', 'S', 'S', 'N'};
+    const uint32_t kSessionVersion = 1;
+
+    struct SessionHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        int64_t started_unix_ms;
+    };
+
+    struct SessionRecord
+    {
+        int64_t start_offset_ms;
+        int32_t http_code;
+        uint32_t url_size;
+        uint32_t body_size;
+        int32_t dns_us;
+        int32_t connect_us;
+        int32_t tls_us;
+        int32_t first_byte_us;
+        int32_t transfer_us;
+        int32_t duration_ms; // Полное время запроса по часам загрузки
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(SessionHeader) == 24, "Неожиданный размер заголовка сеанса");
+    static_assert(sizeof(SessionRecord) == 48, "Неожиданный размер заголовка записи сеанса");
+
+    // Защита от мусора вместо размеров в поврежденном файле
+    const uint32_t kMaxUrlSize = 64 * 1024;
+    const uint32_t kMaxBodySize = 64 * 1024 * 1024;
+}
+
+std::string tileRequestKey(const std::string &url)
+{
+    const size_t query = url.find('?');
+    return query == std::string::npos ? url : url.substr(query + 1);
+}
+
+bool loadTileSession(const std::string &path, TileSession &out)
+{
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        std::cerr << "Ошибка открытия записи сеанса: " << path << std::endl;
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    const char *p = data.constData();
+    const size_t size = static_cast<size_t>(data.size());
+
+    SessionHeader header;
+    if (size < sizeof(header))
+    {
+        std::cerr << "Файл не является записью сеанса: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(&header, p, sizeof(header));
+    if (std::memcmp(header.magic, kSessionMagic, sizeof(kSessionMagic)) != 0 || header.version != kSessionVersion)
+    {
+        std::cerr << "Файл не является записью сеанса или версия не поддерживается: " << path << std::endl;
+        return false;
+    }
+
+    TileSession session;
+    session.started_unix_ms = header.started_unix_ms;
+    size_t offset = sizeof(header);
+    while (offset < size)
+    {
+        SessionRecord record;
+        if (size - offset < sizeof(record))
+            break;
+        std::memcpy(&record, p + offset, sizeof(record));
+        if (record.url_size > kMaxUrlSize || record.body_size > kMaxBodySize ||
+            size - offset - sizeof(record) < static_cast<size_t>(record.url_size) + record.body_size)
+            break;
+        offset += sizeof(record);
+
+        TileSessionEntry entry;
+        entry.url.assign(p + offset, record.url_size);
+        offset += record.url_size;
+        entry.body.assign(p + offset, record.body_size);
+        offset += record.body_size;
+        entry.start_offset_ms = record.start_offset_ms;
+        entry.timing.http_code = record.http_code;
+        entry.timing.ok = record.http_code >= 200 && record.http_code < 300 && record.body_size > 0;
+        entry.timing.bytes = record.body_size;
+        entry.timing.start_unix_ms = session.started_unix_ms + record.start_offset_ms;
+        entry.timing.end_unix_ms = entry.timing.start_unix_ms + record.duration_ms;
+        entry.timing.dns_us = record.dns_us;
+        entry.timing.connect_us = record.connect_us;
+        entry.timing.tls_us = record.tls_us;
+        entry.timing.first_byte_us = record.first_byte_us;
+        entry.timing.transfer_us = record.transfer_us;
+        session.entries.push_back(std::move(entry));
+    }
+    if (offset < size)
+        std::cerr << "Запись сеанса " << path << " оборвана, прочитано записей: " << session.entries.size() << std::endl;
+
+    out = std::move(session);
+    return true;
+}
+
+TileSessionRecorder::~TileSessionRecorder()
+{
+    close();
+}
+
+bool TileSessionRecorder::open(const std::string &path)
+{
+    close();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        std::cerr << "Ошибка создания записи сеанса: " << path << std::endl;
+        return false;
+    }
+    m_path = path;
+    m_started_unix_ms = unixTimeMs();
+    m_count = 0;
+    m_failed = false;
+
+    SessionHeader header;
+    std::memcpy(header.magic, kSessionMagic, sizeof(kSessionMagic));
+    header.version = kSessionVersion;
+    header.reserved = 0;
+    header.started_unix_ms = m_started_unix_ms;
+    if (std::fwrite(&header, sizeof(header), 1, m_file) != 1)
+    {
+        std::cerr << "Ошибка записи сеанса: " << path << std::endl;
+        std::fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void TileSessionRecorder::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file)
+        return;
+    if (std::fclose(m_file) != 0 && !m_failed)
+        std::cerr << "Ошибка записи сеанса: " << m_path << std::endl;
+    m_file = nullptr;
+}
+
+void TileSessionRecorder::record(const std::string &url, const TileTiming &timing, const std::string &body)
+{
+    if (url.size() > kMaxUrlSize || body.size() > kMaxBodySize)
+        return;
+
+    SessionRecord record;
+    record.http_code = static_cast<int32_t>(timing.http_code);
+    record.url_size = static_cast<uint32_t>(url.size());
+    record.body_size = static_cast<uint32_t>(body.size());
+    record.dns_us = timing.dns_us;
+    record.connect_us = timing.connect_us;
+    record.tls_us = timing.tls_us;
+    record.first_byte_us = timing.first_byte_us;
+    record.transfer_us = timing.transfer_us;
+    record.duration_ms = timing.end_unix_ms > timing.start_unix_ms ? static_cast<int32_t>(timing.end_unix_ms - timing.start_unix_ms) : 0;
+    record.reserved = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file || m_failed)
+        return;
+    record.start_offset_ms = timing.start_unix_ms > 0 ? timing.start_unix_ms - m_started_unix_ms : 0;
+    // Запись целиком или никак: при ошибке диска запись сеанса прекращается
+    const bool ok = std::fwrite(&record, sizeof(record), 1, m_file) == 1 &&
+                    std::fwrite(url.data(), 1, url.size(), m_file) == url.size() &&
+                    std::fwrite(body.data(), 1, body.size(), m_file) == body.size();
+    if (!ok)
+    {
+        m_failed = true;
+        std::cerr << "Ошибка записи сеанса, запись остановлена: " << m_path << std::endl;
+        return;
+    }
+    ++m_count;
+}
+
+uint64_t TileSessionRecorder::recordedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
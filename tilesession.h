@@ -0,0 +1,70 @@
+#ifndef TILESESSION_H
+#define TILESESSION_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "burstfetch.h"
+
+// Запись сеанса загрузки плиток: пары запрос/ответ с временем этапов для
+// воспроизведения настоящих плиток без сети (TileStandInServer, Screen_bench).
+// Формат: заголовок (сигнатура, версия, время начала записи), затем записи подряд:
+// заголовок записи (смещение начала от начала сеанса, код HTTP, этапы запроса, размеры),
+// URL и тело ответа как есть. Файл дописывается по мере загрузки; оборванная
+// последняя запись при чтении отбрасывается.
+
+// Одна записанная загрузка
+struct TileSessionEntry
+{
+    std::string url;
+    int64_t start_offset_ms = 0; // От начала записи сеанса
+    TileTiming timing;           // http_code, bytes и этапы (мкс) по данным CURL
+    std::string body;            // Пусто для неудачных запросов
+};
+
+struct TileSession
+{
+    int64_t started_unix_ms = 0;
+    std::vector<TileSessionEntry> entries;
+};
+
+// Ключ для сопоставления запросов при воспроизведении: строка параметров после '?'.
+// Не зависит от адреса сервиса, поэтому запись с настоящего сервиса подходит для замены.
+std::string tileRequestKey(const std::string &url);
+
+// Читает весь сеанс в память. При ошибке пишет причину в std::cerr и возвращает false.
+bool loadTileSession(const std::string &path, TileSession &out);
+
+// Запись сеанса; record вызывается из потоков загрузки одновременно
+class TileSessionRecorder
+{
+public:
+    TileSessionRecorder() = default;
+    ~TileSessionRecorder();
+
+    TileSessionRecorder(const TileSessionRecorder &) = delete;
+    TileSessionRecorder &operator=(const TileSessionRecorder &) = delete;
+
+    // Создает (перезаписывает) файл сеанса
+    bool open(const std::string &path);
+    void close();
+
+    // body — пустой для неудачного запроса
+    void record(const std::string &url, const TileTiming &timing, const std::string &body);
+
+    uint64_t recordedCount() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::FILE *m_file = nullptr;
+    std::string m_path;
+    int64_t m_started_unix_ms = 0;
+    uint64_t m_count = 0;
+    bool m_failed = false;
+};
+
+#endif // TILESESSION_H
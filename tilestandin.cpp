@@ -0,0 +1,385 @@
+#include "tilestandin.h"
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QImage>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    const int kDefaultTilePx = 450;
+    const int kMaxTilePx = 2048;
+    const int kChunkBytes = 16 * 1024; // Порция отправки при ограниченной полосе
+
+    // Состояние потока сервера; доступно только из его цикла событий
+    struct StandInState
+    {
+        std::mt19937_64 random;
+        std::map<std::pair<int, int>, QByteArray> tiles; // PNG по размеру
+        QElapsedTimer clock;
+        double link_free_ms = 0.0; // Когда общая полоса освободится для следующей порции
+
+        // Воспроизведение записи сеанса
+        std::map<std::string, std::vector<size_t>> replay_index; // Ключ запроса -> записи
+        std::map<std::string, size_t> replay_cursor;             // Следующая запись для повтора ключа
+        std::vector<size_t> replay_ok;                           // Успешные записи для незнакомых запросов
+        size_t replay_fallback = 0;
+    };
+
+    // Плитка, похожая на карту: фон, сетка «улиц» и пятна застройки.
+    // Сжимается PNG примерно как настоящие плитки, а не до пары сотен байт.
+    QByteArray syntheticTilePng(int width, int height)
+    {
+        QImage tile(width, height, QImage::Format_RGB32);
+        uint32_t noise = 2166136261u;
+        for (int y = 0; y < height; ++y)
+        {
+            QRgb *line = reinterpret_cast<QRgb *>(tile.scanLine(y));
+            for (int x = 0; x < width; ++x)
+            {
+                if ((x % 8) == 0)
+                    noise = (noise ^ static_cast<uint32_t>((x / 8) * 31 + (y / 8))) * 16777619u;
+                if (x % 37 < 3 || y % 41 < 3)
+                    line[x] = qRgb(255, 214, 90);
+                else
+                    line[x] = qRgb(236 - (noise & 15), 233 - ((noise >> 4) & 15), 226 - ((noise >> 8) & 15));
+            }
+        }
+        QByteArray png;
+        QBuffer buffer(&png);
+        buffer.open(QIODevice::WriteOnly);
+        tile.save(&buffer, "PNG");
+        return png;
+    }
+
+    // size=W,H из строки запроса; без параметра — размер плитки по умолчанию
+    std::pair<int, int> requestedTileSize(const QByteArray &target)
+    {
+        int width = kDefaultTilePx;
+        int height = kDefaultTilePx;
+        const int at = target.indexOf("size=");
+        if (at >= 0)
+        {
+            int end = target.indexOf('&', at);
+            if (end < 0)
+                end = target.size();
+            const QList<QByteArray> parts = target.mid(at + 5, end - at - 5).split(',');
+            if (parts.size() == 2)
+            {
+                width = parts[0].toInt();
+                height = parts[1].toInt();
+            }
+        }
+        width = std::min(std::max(width, 1), kMaxTilePx);
+        height = std::min(std::max(height, 1), kMaxTilePx);
+        return {width, height};
+    }
+}
+
+bool LatencyModel::parse(const std::string &text, LatencyModel &out)
+{
+    std::istringstream in(text);
+    std::string kind;
+    std::getline(in, kind, ':');
+    std::vector<double> values;
+    std::string field;
+    while (std::getline(in, field, ':'))
+    {
+        char *end = nullptr;
+        const double value = std::strtod(field.c_str(), &end);
+        if (field.empty() || *end != '\0' || value < 0)
+            return false;
+        values.push_back(value);
+    }
+
+    LatencyModel model;
+    if (kind == "fixed" && values.size() == 1)
+        model.kind = Kind::Fixed;
+    else if (kind == "uniform" && values.size() == 2 && values[0] <= values[1])
+        model.kind = Kind::Uniform;
+    else if (kind == "exp" && values.size() == 1)
+        model.kind = Kind::Exponential;
+    else if (kind == "lognormal" && values.size() == 2 && values[0] > 0)
+        model.kind = Kind::LogNormal;
+    else
+        return false;
+    model.a = values[0];
+    model.b = values.size() > 1 ? values[1] : 0.0;
+    out = model;
+    return true;
+}
+
+int64_t LatencyModel::sampleMs(std::mt19937_64 &random) const
+{
+    double value = a;
+    switch (kind)
+    {
+    case Kind::Fixed:
+        break;
+    case Kind::Uniform:
+        value = std::uniform_real_distribution<double>(a, b)(random);
+        break;
+    case Kind::Exponential:
+        value = a > 0 ? std::exponential_distribution<double>(1.0 / a)(random) : 0.0;
+        break;
+    case Kind::LogNormal:
+        value = std::lognormal_distribution<double>(std::log(a), b)(random);
+        break;
+    }
+    // Сутки — заведомо больше любого таймаута захвата
+    return static_cast<int64_t>(std::min(std::max(value, 0.0), 86400000.0) + 0.5);
+}
+
+std::string LatencyModel::describe() const
+{
+    std::ostringstream out;
+    switch (kind)
+    {
+    case Kind::Fixed:
+        out << "fixed:" << a;
+        break;
+    case Kind::Uniform:
+        out << "uniform:" << a << ":" << b;
+        break;
+    case Kind::Exponential:
+        out << "exp:" << a;
+        break;
+    case Kind::LogNormal:
+        out << "lognormal:" << a << ":" << b;
+        break;
+    }
+    return out.str();
+}
+
+TileStandInServer::TileStandInServer(const StandInOptions &options)
+    : m_options(options)
+{
+}
+
+TileStandInServer::~TileStandInServer()
+{
+    stopListening();
+}
+
+bool TileStandInServer::startListening()
+{
+    start();
+    std::unique_lock<std::mutex> lock(m_start_mutex);
+    m_start_cv.wait(lock, [this]()
+                    { return m_start_done; });
+    return m_port != 0;
+}
+
+void TileStandInServer::stopListening()
+{
+    if (!isRunning())
+        return;
+    quit();
+    wait();
+}
+
+std::string TileStandInServer::baseUrl() const
+{
+    return "http://127.0.0.1:" + std::to_string(m_port) + "/1.x/";
+}
+
+StandInStats TileStandInServer::stats() const
+{
+    StandInStats stats;
+    stats.requests = m_requests.load();
+    stats.errors = m_errors.load();
+    stats.resets = m_resets.load();
+    stats.bytes = m_bytes.load();
+    stats.replay_misses = m_replay_misses.load();
+    return stats;
+}
+
+void TileStandInServer::run()
+{
+    // Состояние объявлено раньше сервера: сокеты (дети сервера) разрушаются первыми
+    StandInState state;
+    state.random.seed(m_options.seed);
+    state.clock.start();
+    if (m_options.replay)
+    {
+        const std::vector<TileSessionEntry> &entries = m_options.replay->entries;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            state.replay_index[tileRequestKey(entries[i].url)].push_back(i);
+            if (entries[i].timing.ok)
+                state.replay_ok.push_back(i);
+        }
+    }
+
+    QTcpServer server;
+    const bool listening = server.listen(QHostAddress::LocalHost, 0);
+    if (!listening)
+        std::cerr << "Замена сервера плиток: ошибка открытия порта - " << server.errorString().toStdString() << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(m_start_mutex);
+        m_port = listening ? server.serverPort() : 0;
+        m_start_done = true;
+    }
+    m_start_cv.notify_all();
+    if (!listening)
+        return;
+
+    // Отправка ответа после задержки latency_ms. Тело растягивается на transfer_ms (время приема
+    // из записи сеанса), а при ограниченной полосе порции еще и встают в очередь общего канала.
+    auto send = [this, &state](QTcpSocket *socket, const QByteArray &response, int64_t latency_ms, double transfer_ms)
+    {
+        m_bytes += static_cast<uint64_t>(response.size());
+        if (m_options.bandwidth_bytes_per_sec <= 0 && transfer_ms <= 0)
+        {
+            QTimer::singleShot(static_cast<int>(latency_ms), Qt::PreciseTimer, socket, [socket, response]()
+                               { socket->write(response); });
+            return;
+        }
+        const double now_ms = static_cast<double>(state.clock.elapsed());
+        const double start_ms = now_ms + static_cast<double>(latency_ms);
+        const double ms_per_byte = m_options.bandwidth_bytes_per_sec > 0 ? 1000.0 / static_cast<double>(m_options.bandwidth_bytes_per_sec) : 0.0;
+        const int chunks = std::max(1, (response.size() + kChunkBytes - 1) / kChunkBytes);
+        double ready_ms = start_ms;
+        for (int i = 0; i < chunks; ++i)
+        {
+            const QByteArray chunk = response.mid(i * kChunkBytes, kChunkBytes);
+            const double paced_ms = start_ms + (chunks == 1 ? transfer_ms : transfer_ms * i / (chunks - 1));
+            double at_ms = std::max(ready_ms, paced_ms);
+            if (ms_per_byte > 0)
+            {
+                state.link_free_ms = std::max(state.link_free_ms, at_ms) + chunk.size() * ms_per_byte;
+                at_ms = state.link_free_ms;
+            }
+            ready_ms = at_ms;
+            const int delay_ms = static_cast<int>(std::max(0.0, at_ms - now_ms));
+            QTimer::singleShot(delay_ms, Qt::PreciseTimer, socket, [socket, chunk]()
+                               { socket->write(chunk); });
+        }
+    };
+
+    // Ответ из записи сеанса: повторы одного запроса получают записи по очереди,
+    // незнакомый запрос — очередную успешную запись (байты настоящие, хоть и не той плитки)
+    auto replayEntry = [this, &state](const std::string &key) -> const TileSessionEntry *
+    {
+        const std::vector<TileSessionEntry> &entries = m_options.replay->entries;
+        auto found = state.replay_index.find(key);
+        if (found != state.replay_index.end())
+        {
+            size_t &cursor = state.replay_cursor[key];
+            const size_t index = found->second[cursor % found->second.size()];
+            ++cursor;
+            return &entries[index];
+        }
+        ++m_replay_misses;
+        if (state.replay_ok.empty())
+            return nullptr;
+        return &entries[state.replay_ok[state.replay_fallback++ % state.replay_ok.size()]];
+    };
+
+    // Разбирает все полностью принятые запросы соединения (тела у GET нет)
+    auto handle = [this, &state, send, replayEntry](QTcpSocket *socket, QByteArray &pending)
+    {
+        std::uniform_real_distribution<double> roll(0.0, 1.0);
+        int header_end = 0;
+        while ((header_end = pending.indexOf("\r\n\r\n")) >= 0)
+        {
+            const QByteArray request_line = pending.left(pending.indexOf("\r\n"));
+            pending.remove(0, header_end + 4);
+            const QList<QByteArray> parts = request_line.split(' ');
+            ++m_requests;
+            const bool is_get = parts.size() >= 2 && parts[0] == "GET";
+
+            const TileSessionEntry *entry = nullptr;
+            int64_t latency_ms = 0;
+            double transfer_ms = 0.0;
+            if (m_options.replay && is_get)
+            {
+                entry = replayEntry(tileRequestKey(parts[1].toStdString()));
+                if (entry)
+                {
+                    const TileTiming &timing = entry->timing;
+                    const double first_byte_us = static_cast<double>(timing.dns_us) + timing.connect_us + timing.tls_us + timing.first_byte_us;
+                    latency_ms = static_cast<int64_t>(first_byte_us / 1000.0 * m_options.replay_time_scale + 0.5);
+                    transfer_ms = timing.transfer_us / 1000.0 * m_options.replay_time_scale;
+                }
+            }
+            else
+            {
+                latency_ms = m_options.latency.sampleMs(state.random);
+            }
+            const double outcome = roll(state.random);
+
+            // Обрыв: внесенный или записанный (запрос не дошел до ответа HTTP)
+            if (outcome < m_options.reset_rate || (entry && entry->timing.http_code == 0))
+            {
+                ++m_resets;
+                pending.clear();
+                QTimer::singleShot(static_cast<int>(latency_ms), Qt::PreciseTimer, socket, [socket]()
+                                   { socket->abort(); });
+                return;
+            }
+            if (!is_get || outcome < m_options.reset_rate + m_options.error_rate)
+            {
+                if (is_get)
+                    ++m_errors;
+                send(socket, "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n", latency_ms, 0.0);
+                continue;
+            }
+            if (m_options.replay && (!entry || !entry->timing.ok))
+            {
+                // Записанная ошибка сервиса воспроизводится ее кодом
+                const long code = entry ? entry->timing.http_code : 404;
+                QByteArray response = "HTTP/1.1 " + QByteArray::number(static_cast<int>(code)) + " Replay\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
+                send(socket, response, latency_ms, 0.0);
+                continue;
+            }
+
+            QByteArray body;
+            if (entry)
+            {
+                body = QByteArray(entry->body.data(), static_cast<int>(entry->body.size()));
+            }
+            else
+            {
+                const std::pair<int, int> size = requestedTileSize(parts[1]);
+                QByteArray &png = state.tiles[size];
+                if (png.isEmpty())
+                    png = syntheticTilePng(size.first, size.second);
+                body = png;
+            }
+            QByteArray response = "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\nConnection: keep-alive\r\nContent-Length: ";
+            response += QByteArray::number(body.size());
+            response += "\r\n\r\n";
+            response += body;
+            send(socket, response, latency_ms, transfer_ms);
+        }
+    };
+
+    QObject::connect(&server, &QTcpServer::newConnection, &server, [&server, handle]()
+                     {
+        while (QTcpSocket *socket = server.nextPendingConnection())
+        {
+            auto pending = std::make_shared<QByteArray>();
+            QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket, pending, handle]()
+                             {
+                pending->append(socket->readAll());
+                handle(socket, *pending); });
+        } });
+
+    exec();
+}
@@ -0,0 +1,103 @@
+#ifndef TILESTANDIN_H
+#define TILESTANDIN_H
+
+#include <QThread>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include "tilesession.h"
+
+// Распределение задержки ответа, мс. Задается строкой:
+//   fixed:300            — всегда 300
+//   uniform:100:500      — равномерно от 100 до 500
+//   exp:300              — экспоненциально со средним 300
+//   lognormal:300:0.5    — логнормально с медианой 300 и сигмой 0,5 (длинный хвост)
+struct LatencyModel
+{
+    enum class Kind
+    {
+        Fixed,
+        Uniform,
+        Exponential,
+        LogNormal
+    };
+    Kind kind = Kind::Fixed;
+    double a = 0.0;
+    double b = 0.0;
+
+    static bool parse(const std::string &text, LatencyModel &out);
+    int64_t sampleMs(std::mt19937_64 &random) const;
+    std::string describe() const;
+};
+
+// Условия сети, которые изображает замена сервера плиток
+struct StandInOptions
+{
+    LatencyModel latency;
+    double error_rate = 0.0;          // Доля ответов 503
+    double reset_rate = 0.0;          // Доля запросов, на которые соединение обрывается без ответа
+    long long bandwidth_bytes_per_sec = 0; // Общая полоса на все соединения, 0 — без ограничения
+    uint64_t seed = 1;
+
+    // Воспроизведение записи сеанса вместо синтетических плиток: ответы и время этапов
+    // берутся из записи (latency не используется), время умножается на replay_time_scale
+    // (0 — без задержек). Внесенные ошибки, обрывы и полоса действуют и здесь.
+    std::shared_ptr<const TileSession> replay;
+    double replay_time_scale = 1.0;
+};
+
+// Итоги работы замены сервера
+struct StandInStats
+{
+    uint64_t requests = 0;
+    uint64_t errors = 0;  // Отвечено 503
+    uint64_t resets = 0;  // Оборвано без ответа
+    uint64_t bytes = 0;   // Отправлено байт (заголовки и тела)
+    uint64_t replay_misses = 0; // Запросы, которых нет в записи сеанса
+};
+
+// Локальная замена сервиса плиток для нагрузочного прогона: HTTP/1.1 на 127.0.0.1,
+// отвечает на любой GET синтетической PNG-плиткой размера из параметра size=W,H
+// или ответом из записи сеанса (StandInOptions::replay).
+// Задержка, ошибки и общая полоса — по StandInOptions. Работает в своем потоке
+// с собственным циклом событий и не мешает потокам захвата.
+class TileStandInServer : public QThread
+{
+public:
+    explicit TileStandInServer(const StandInOptions &options);
+    ~TileStandInServer() override;
+
+    // Запускает поток и ждет, пока сервер начнет слушать свободный порт
+    bool startListening();
+    // Останавливает цикл событий и ждет завершения потока
+    void stopListening();
+
+    // Адрес для CaptureThread::setTileServerUrl: http://127.0.0.1:<порт>/1.x/
+    std::string baseUrl() const;
+    StandInStats stats() const;
+
+protected:
+    void run() override;
+
+private:
+    StandInOptions m_options;
+
+    std::mutex m_start_mutex;
+    std::condition_variable m_start_cv;
+    bool m_start_done = false;
+    quint16 m_port = 0;
+
+    std::atomic<uint64_t> m_requests{0};
+    std::atomic<uint64_t> m_errors{0};
+    std::atomic<uint64_t> m_resets{0};
+    std::atomic<uint64_t> m_bytes{0};
+    std::atomic<uint64_t> m_replay_misses{0};
+};
+
+#endif // TILESTANDIN_H
@@ -0,0 +1,244 @@
+#include "tracing.h"
+
+#ifdef SCREEN_TRACING
+
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QString>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Событий в буфере одного потока за цикл; сверх — отбрасываются и учитываются
+    const size_t kMaxEventsPerThread = 1 << 18;
+
+    struct TraceEvent
+    {
+        const char *name;
+        int64_t start_us;
+        int64_t duration_us;
+        char detail[48];
+    };
+
+    // Буфер потока. Мьютекс нужен только на время сброса цикла: в остальное время
+    // его берет лишь поток-владелец, без соперничества.
+    struct ThreadTraceBuffer
+    {
+        std::mutex mutex;
+        std::vector<TraceEvent> events;
+        std::string thread_name;
+        uint32_t tid = 0;
+        uint64_t dropped = 0;
+    };
+
+    struct TraceRegistry
+    {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+        uint32_t next_tid = 1;
+        uint64_t cycle = 0;
+    };
+
+    TraceRegistry &registry()
+    {
+        static TraceRegistry instance;
+        return instance;
+    }
+
+    ThreadTraceBuffer &threadBuffer()
+    {
+        // Реестр держит буфер и после завершения потока, пока его события не сброшены
+        thread_local std::shared_ptr<ThreadTraceBuffer> buffer;
+        if (!buffer)
+        {
+            buffer = std::make_shared<ThreadTraceBuffer>();
+            buffer->events.reserve(4096);
+            TraceRegistry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            buffer->tid = r.next_tid++;
+            r.buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    int64_t traceNowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void appendJsonString(std::string &out, const char *text)
+    {
+        out += '"';
+        for (const char *p = text; *p; ++p)
+        {
+            const unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += static_cast<char>(c);
+            }
+            else if (c < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            }
+            else
+            {
+                out += static_cast<char>(c);
+            }
+        }
+        out += '"';
+    }
+}
+
+TraceSpan::TraceSpan(const char *name, const char *detail)
+    : m_name(name), m_start_us(traceNowUs())
+{
+    m_detail[0] = '\0';
+    if (detail)
+    {
+        std::strncpy(m_detail, detail, sizeof(m_detail) - 1);
+        m_detail[sizeof(m_detail) - 1] = '\0';
+        // Обрезанный посреди символа UTF-8 хвост сделал бы JSON нечитаемым
+        size_t length = std::strlen(m_detail);
+        if (length == sizeof(m_detail) - 1)
+        {
+            size_t start = length;
+            while (start > 0 && (static_cast<unsigned char>(m_detail[start - 1]) & 0xC0) == 0x80)
+                --start;
+            if (start > 0 && (static_cast<unsigned char>(m_detail[start - 1]) & 0x80))
+                m_detail[start - 1] = '\0';
+        }
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    const int64_t end_us = traceNowUs();
+    ThreadTraceBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() >= kMaxEventsPerThread)
+    {
+        ++buffer.dropped;
+        return;
+    }
+    buffer.events.emplace_back();
+    TraceEvent &event = buffer.events.back();
+    event.name = m_name;
+    event.start_us = m_start_us;
+    event.duration_us = end_us - m_start_us;
+    std::memcpy(event.detail, m_detail, sizeof(m_detail));
+}
+
+void traceThreadName(const char *name)
+{
+    ThreadTraceBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.thread_name = name;
+}
+
+void traceWriteCycle(const char *label)
+{
+    TraceRegistry &r = registry();
+    std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+    uint64_t cycle = 0;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        buffers = r.buffers;
+        cycle = ++r.cycle;
+        // Буферы завершившихся потоков (держит только реестр) сбрасываются последний раз
+        std::vector<std::shared_ptr<ThreadTraceBuffer>> alive;
+        for (auto &buffer : r.buffers)
+        {
+            if (buffer.use_count() > 2)
+                alive.push_back(buffer);
+        }
+        r.buffers.swap(alive);
+    }
+
+    // Буферы забираются целиком и сразу освобождаются: потоки продолжают писать в новые
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    size_t total = 0;
+    uint64_t dropped = 0;
+    char number[96];
+    for (const auto &buffer : buffers)
+    {
+        std::vector<TraceEvent> events;
+        std::string thread_name;
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            events.swap(buffer->events);
+            buffer->events.reserve(4096);
+            thread_name = buffer->thread_name;
+            dropped += buffer->dropped;
+            buffer->dropped = 0;
+        }
+        if (events.empty())
+            continue;
+        total += events.size();
+
+        if (!first)
+            json += ",\n";
+        first = false;
+        std::snprintf(number, sizeof(number), "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", buffer->tid);
+        json += number;
+        appendJsonString(json, thread_name.empty() ? "thread" : thread_name.c_str());
+        json += "}}";
+
+        for (const TraceEvent &event : events)
+        {
+            json += ",\n{\"ph\":\"X\",\"pid\":1,";
+            std::snprintf(number, sizeof(number), "\"tid\":%u,\"ts\":%lld,\"dur\":%lld,\"name\":", buffer->tid,
+                          static_cast<long long>(event.start_us), static_cast<long long>(event.duration_us));
+            json += number;
+            appendJsonString(json, event.name);
+            if (event.detail[0])
+            {
+                json += ",\"args\":{\"detail\":";
+                appendJsonString(json, event.detail);
+                json += '}';
+            }
+            json += '}';
+        }
+    }
+    json += "\n]}\n";
+    if (total == 0)
+        return;
+
+    const char *env_dir = std::getenv("SCREEN_TRACE_DIR");
+    const QString directory = QString::fromLocal8Bit(env_dir && *env_dir ? env_dir : "./screen_traces");
+    if (!QDir().mkpath(directory))
+    {
+        std::cerr << "Ошибка создания каталога трассировки: " << directory.toStdString() << std::endl;
+        return;
+    }
+    const QString file_name = QString("trace_%1_%2_%3.json")
+                                  .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"))
+                                  .arg(cycle)
+                                  .arg(QString::fromLocal8Bit(label));
+    QSaveFile file(QDir(directory).absoluteFilePath(file_name));
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(json.data(), static_cast<qint64>(json.size())) != static_cast<qint64>(json.size()) ||
+        !file.commit())
+    {
+        std::cerr << "Ошибка записи трассировки: " << file_name.toStdString() << std::endl;
+        return;
+    }
+    if (dropped > 0)
+        std::cerr << "Трассировка " << file_name.toStdString() << ": буферы потоков переполнены, отброшено событий: " << dropped << std::endl;
+}
+
+#endif // SCREEN_TRACING
@@ -0,0 +1,54 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+// Трассировка циклов захвата в формате Chrome trace-event (chrome://tracing, ui.perfetto.dev).
+// Включается при сборке определением SCREEN_TRACING (CMake: -DSCREEN_TRACING=ON,
+// qmake: CONFIG+=screen_tracing); без него макросы ниже пусты и их аргументы не вычисляются.
+//
+// Отрезки пишутся в буфер своего потока; TRACE_CYCLE_END сбрасывает события всех потоков
+// в отдельный файл <каталог>/trace_<дата>_<номер>_<метка>.json. Каталог — переменная окружения
+// SCREEN_TRACE_DIR, по умолчанию ./screen_traces.
+
+#ifdef SCREEN_TRACING
+
+#include <cstdint>
+
+class TraceSpan
+{
+public:
+    // name — строковая константа; detail (имя объекта и т.п.) копируется, длинное обрезается
+    explicit TraceSpan(const char *name, const char *detail = nullptr);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *m_name;
+    int64_t m_start_us;
+    char m_detail[48];
+};
+
+// Имя текущего потока на временной шкале
+void traceThreadName(const char *name);
+
+// Записывает события, накопленные с прошлого вызова, в файл цикла; label попадает в имя файла
+void traceWriteCycle(const char *label);
+
+#define SCREEN_TRACE_CONCAT_(a, b) a##b
+#define SCREEN_TRACE_CONCAT(a, b) SCREEN_TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) TraceSpan SCREEN_TRACE_CONCAT(trace_span_, __LINE__)(name)
+#define TRACE_SPAN_DETAIL(name, detail) TraceSpan SCREEN_TRACE_CONCAT(trace_span_, __LINE__)(name, detail)
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+#define TRACE_CYCLE_END(label) traceWriteCycle(label)
+
+#else
+
+#define TRACE_SPAN(name) ((void)0)
+#define TRACE_SPAN_DETAIL(name, detail) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_CYCLE_END(label) ((void)0)
+
+#endif // SCREEN_TRACING
+
+#endif // TRACING_H